@@ -1,6 +1,8 @@
 #include "adore/hyperdeck.h"
 
 #include "adore/core.h"
+#include "adore/metrics.h"
+#include "adore/scheduler.h"
 #include "lute/runtime.h"
 #include <iostream>
 
@@ -10,6 +12,7 @@
 #include <string>
 #include <variant>
 #include <queue>
+#include <chrono>
 
 #include <uv.h>
 #include "BMDSwitcherAPI.tlh"
@@ -117,9 +120,30 @@ struct ProtocolReader;
 // define response callback for queue, takes an int code and string message
 using ResponseCallback = std::function<void(int, const std::string&)>;
 
+struct HyperdeckMetrics {
+    metrics::Gauge& state;
+    metrics::Counter& bytesIn;
+    metrics::Counter& bytesOut;
+    metrics::Histogram& roundTrip;
+
+    static HyperdeckMetrics* forAddress(const std::string& address);
+};
+
+HyperdeckMetrics* HyperdeckMetrics::forAddress(const std::string& address) {
+    std::string labels = metrics::label("device", address);
+    // series live for the whole process, so reconnecting to the same address reuses them
+    return new HyperdeckMetrics{
+        metrics::gauge("adore_hyperdeck_state", "Hyperdeck connection state (0 disconnected, 1 connecting, 2 connected, 3 error)", labels),
+        metrics::counter("adore_hyperdeck_bytes_in_total", "Bytes received from the Hyperdeck", labels),
+        metrics::counter("adore_hyperdeck_bytes_out_total", "Bytes sent to the Hyperdeck", labels),
+        metrics::histogram("adore_hyperdeck_command_seconds", "Round trip time of Hyperdeck commands", metrics::kLatencyBounds, labels),
+    };
+}
+
 struct HyperdeckDevice {
     lua_State* L;
-    ResumeToken token;
+    scheduler::Token token;
+    std::string address = "";
     std::string buffer = "";
     HyperdeckState state = HYPERDECK_STATE_DISCONNECTED;
     HyperdeckReadState readState = NONE;
@@ -134,12 +158,16 @@ struct HyperdeckDevice {
     std::string lastError = "";
     std::recursive_mutex mutex;
     std::queue<ResponseCallback> callbackQueue;
+    std::queue<std::chrono::steady_clock::time_point> sentQueue;
+
+    HyperdeckMetrics* metrics = nullptr;
 
     uv_loop_t* loop = nullptr;
     uv_tcp_t* tcp = nullptr;
     uv_connect_t* connect_req = nullptr;
 
     void processBuffer();
+    void setState(HyperdeckState newState);
 
     static std::variant<HyperdeckDevice*, std::string> create(Runtime* runtime, const char* address);
 
@@ -148,11 +176,23 @@ struct HyperdeckDevice {
     void sendWithCallback(const std::string& command, ResponseCallback callback);
 };
 
+void HyperdeckDevice::setState(HyperdeckState newState) {
+    state = newState;
+    if (metrics) {
+        metrics->state.set(newState);
+    }
+}
+
 void HyperdeckDevice::close() {
     uv_read_stop((uv_stream_t*)tcp);
     if (state == HYPERDECK_STATE_CONNECTED) {
         send("quit\r\n");
     }
+    if (state != HYPERDECK_STATE_ERROR) {
+        setState(HYPERDECK_STATE_DISCONNECTED);
+    }
+    delete metrics;
+    metrics = nullptr;
     uv_close((uv_handle_t*)tcp, [](uv_handle_t* handle) {
         delete reinterpret_cast<uv_tcp_t*>(handle);
     });
@@ -177,6 +217,11 @@ void HyperdeckDevice::sendWithCallback(const std::string& command, ResponseCallb
 
     write_req->mutex->lock();
     callbackQueue.push(callback);
+    sentQueue.push(std::chrono::steady_clock::now());
+
+    if (metrics) {
+        metrics->bytesOut.add(command.size());
+    }
 
     uv_buf_t buf;
     buf.base = write_req->buffer.data();
@@ -438,6 +483,14 @@ void HyperdeckDevice::processBuffer() {
                 if (!this->callbackQueue.empty()) {
                     ResponseCallback callback = this->callbackQueue.front();
                     this->callbackQueue.pop();
+
+                    if (!this->sentQueue.empty()) {
+                        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - this->sentQueue.front();
+                        this->sentQueue.pop();
+                        if (this->metrics) {
+                            this->metrics->roundTrip.observe(elapsed.count());
+                        }
+                    }
                     callback(code, key);
                 }
             }
@@ -499,11 +552,14 @@ static void on_alloc(uv_handle_t* handle, size_t suggested_size, uv_buf_t* buf)
 static void on_read(uv_stream_t* stream, ssize_t nread, const uv_buf_t* buf) {
     HyperdeckDevice* device = static_cast<HyperdeckDevice*>(stream->data);
     if (nread > 0) {
+        if (device->metrics) {
+            device->metrics->bytesIn.add(nread);
+        }
         device->buffer.append(buf->base, nread);
         device->processBuffer();
     } else if (nread < 0) {
         // disconnect or error
-        device->state = HYPERDECK_STATE_DISCONNECTED;
+        device->setState(HYPERDECK_STATE_DISCONNECTED);
         device->ready = false;
     }
     delete[] buf->base;
@@ -576,8 +632,11 @@ int connect(lua_State* L) {
 
     HyperdeckDevice* device = new HyperdeckDevice();
     device->L = L;
-    device->token = getResumeToken(L);
+    device->token = scheduler::park(L);
     device->loop = uv_default_loop();
+    device->address = address;
+    device->metrics = HyperdeckMetrics::forAddress(device->address);
+    device->setState(HYPERDECK_STATE_CONNECTING);
 
     device->tcp = new uv_tcp_t();
     uv_tcp_init(uv_default_loop(), device->tcp);
@@ -594,11 +653,11 @@ int connect(lua_State* L) {
         [](uv_connect_t* req, int status) {
             HyperdeckDevice* device = static_cast<HyperdeckDevice*>(req->data);
             if (status < 0) {
-                device->state = HYPERDECK_STATE_ERROR;
+                device->setState(HYPERDECK_STATE_ERROR);
                 device->token->fail(std::string("Failed to connect: ") + uv_strerror(status));
                 device->close();
             } else {
-                device->state = HYPERDECK_STATE_CONNECTED;
+                device->setState(HYPERDECK_STATE_CONNECTED);
 
                 device->send("notify:\r\ntransport: true\r\nslot: false\r\nremote: true\r\nconfiguration: true\r\ndropped frames: true\r\ndisplay timecode: true\r\ntimeline position: true\r\nplayrange: true\r\ncache: true\r\ndynamic range: true\r\nslate: false\r\nclips: true\r\ndisk: true\r\ndevice info: true\r\nnas: false\r\n\r\n");
                 device->send("device info\r\n");
@@ -642,7 +701,7 @@ int send(lua_State* L) {
 int clear(lua_State* L) {
     HyperdeckDevice* device = luaL_checkhyperdeck(L, 1);
     
-    auto token = getResumeToken(L);
+    auto token = scheduler::park(L);
     device->sendWithCallback("clips clear\r\n",
         [token](int code, const std::string& message) {
             if (code >= 200 && code < 300) {
@@ -678,7 +737,7 @@ int addclip(lua_State* L) {
         luaL_error(L, "Expected string or integer for clip name or ID");
     }
 
-    auto token = getResumeToken(L);
+    auto token = scheduler::park(L);
     device->sendWithCallback(command,
         [token](int code, const std::string& message) {
             if (code >= 200 && code < 300) {
@@ -1,5 +1,8 @@
 #include <iostream>
+#include <algorithm>
 #include <condition_variable>
+#include <cmath>
+#include <uv.h>
 #include "raylib.h"
 #include "lua.h"
 #include "lualib.h"
@@ -14,9 +17,14 @@
 #include "Luau/Compiler.h"
 #include "adore/window.h"
 #include "adore/graphics.h"
+#include "adore/recorder.h"
+#include "adore/software.h"
 #include "adore/colors.h"
 #include "adore/input.h"
 #include "adore/gui.h"
+#include "adore/metrics.h"
+#include "adore/scheduler.h"
+#include "adore/timer.h"
 #ifdef ADORE_BLACKMAGIC
 #include "adore/blackmagic.h"
 #include "adore/hyperdeck.h"
@@ -26,6 +34,14 @@
 
 namespace adore {
 
+struct FrameMetrics {
+    metrics::Histogram& frameTime = metrics::histogram("adore_frame_seconds", "Time between presented frames", metrics::kFrameBounds);
+    metrics::Histogram& frameWork = metrics::histogram("adore_frame_work_seconds", "Time spent in update and draw per frame", metrics::kFrameBounds);
+    metrics::Gauge& heapBytes = metrics::gauge("adore_luau_heap_bytes", "Bytes allocated by the Luau heap");
+    metrics::Gauge& runQueue = metrics::gauge("adore_run_queue_length", "Luau threads waiting to be resumed by the runtime");
+    metrics::Counter& idleFrames = metrics::counter("adore_idle_frames_total", "Frames skipped because nothing asked for a redraw");
+};
+
 
 Luau::CompileOptions copts()
 {
@@ -38,6 +54,87 @@ Luau::CompileOptions copts()
     return result;
 }
 
+// Background work runs in whatever is left of the frame, but always gets its minimum slice
+static scheduler::Clock::time_point backgroundDeadline(scheduler::Clock::time_point frameStart)
+{
+    auto deadline = scheduler::Clock::now() + scheduler::background_slice();
+
+    int fps = window::get_target_fps();
+    if (fps > 0) {
+        // leave a millisecond for presenting the frame
+        auto frameEnd = frameStart + std::chrono::duration_cast<scheduler::Clock::duration>(std::chrono::duration<double>(1.0 / fps - 0.001));
+        if (frameEnd > deadline) {
+            deadline = frameEnd;
+        }
+    }
+
+    return deadline;
+}
+
+// One frame at the target rate, or at 60 fps when uncapped
+static double frameInterval()
+{
+    int fps = window::get_target_fps();
+    return 1.0 / (fps > 0 ? fps : 60);
+}
+
+// Block in the libuv loop until its next event, but no longer than `wait`. Sockets,
+// lute's timers and ours wake it early, window input is polled by the next frame.
+static void waitForEvents(std::chrono::duration<double> wait)
+{
+    static uv_timer_t* wakeup = nullptr;
+    uv_loop_t* loop = uv_default_loop();
+    if (!wakeup) {
+        wakeup = new uv_timer_t();
+        uv_timer_init(loop, wakeup);
+    }
+
+    // an active timer also keeps UV_RUN_ONCE from returning right away on an empty loop
+    uv_update_time(loop);
+    uv_timer_start(wakeup, [](uv_timer_t*) {}, static_cast<uint64_t>(std::ceil(wait.count() * 1000.0)), 0);
+    uv_run(loop, UV_RUN_ONCE);
+    uv_timer_stop(wakeup);
+}
+
+// When redrawing on demand, skip the frame unless something asked for one. The
+// last frame stays on screen while background work and asynchronous loads still
+// progress. Returns false when the frame should be drawn.
+static bool idleFrame(Runtime& runtime, FrameMetrics& frameMetrics, const scheduler::ErrorHandler& reportError)
+{
+    if (!window::is_on_demand()) {
+        return false;
+    }
+
+    // a resumed thread is an event reaching a script, which may change what is shown
+    if (!runtime.runningThreads.empty() || scheduler::take_woken()) {
+        window::request_redraw();
+    }
+
+    if (window::take_redraw_request() || window::poll_input()) {
+        return false;
+    }
+
+    auto sliceStart = scheduler::Clock::now();
+    scheduler::run(scheduler::Priority::FRAME, reportError);
+    scheduler::run(scheduler::Priority::BACKGROUND, backgroundDeadline(sliceStart), reportError);
+    graphics::end_frame();
+    frameMetrics.idleFrames.add();
+
+    if (scheduler::has_work() || !runtime.runningThreads.empty()) {
+        return true;
+    }
+
+    // wait as long as EndDrawing would have, but no longer than the next timer
+    auto wait = std::chrono::duration<double>(frameInterval());
+    uint64_t dueMicros;
+    if (timer::next_due(dueMicros)) {
+        wait = std::min(wait, std::chrono::duration<double>(dueMicros / 1e6));
+    }
+    waitForEvents(wait);
+
+    return true;
+}
+
 static bool setupArguments(lua_State* L, int argc, char** argv)
 {
     if (!lua_checkstack(L, argc))
@@ -107,15 +204,37 @@ static bool runFile(Runtime& runtime, const char* name, lua_State* GL, int progr
     bool result = true;
     bool windowCreated = false;
 
+    FrameMetrics frameMetrics;
+    // frames drawn since the last idle one, raylib's frame time spans the idle
+    // period until the second frame after it
+    int framesSinceIdle = 2;
+    scheduler::ErrorHandler reportError = [&runtime](lua_State* L) {
+        runtime.reportError(L);
+    };
+    timer::set_error_handler(reportError);
+
     while (!quit) {
+        // critical continuations never wait for the next frame
+        scheduler::run(scheduler::Priority::CRITICAL, reportError);
+        timer::poll();
+
         windowCreated = windowCreated || IsWindowReady();
         if (windowCreated) {
             if (WindowShouldClose()) {
                 break;
             }
 
-            runtime.schedule([&runtime]() {
+            runtime.schedule([&runtime, &frameMetrics, &reportError, &framesSinceIdle]() {
                 lua_State* L = runtime.globalState.get();
+                auto frameStart = std::chrono::steady_clock::now();
+
+                timer::poll();
+                scheduler::run(scheduler::Priority::CRITICAL, reportError);
+
+                if (idleFrame(runtime, frameMetrics, reportError)) {
+                    framesSinceIdle = 0;
+                    return;
+                }
 
                 // remember and reserve stack space so we don't violate call frame limits
                 int base = lua_gettop(L);
@@ -126,7 +245,8 @@ static bool runFile(Runtime& runtime, const char* name, lua_State* GL, int progr
                     lua_getfield(L, -1, "update");
                     if (lua_isfunction(L, -1)) {
                         // push delta time
-                        float dt = GetFrameTime();
+                        float dt = framesSinceIdle < 2 ? static_cast<float>(frameInterval()) : GetFrameTime();
+                        frameMetrics.frameTime.observe(dt);
                         lua_pushnumber(L, dt);
                         if (lua_pcall(L, 1, 0, 0) != LUA_OK) {
                             runtime.reportError(L);
@@ -136,6 +256,8 @@ static bool runFile(Runtime& runtime, const char* name, lua_State* GL, int progr
                         lua_pop(L, 1);
                     }
 
+                    scheduler::run(scheduler::Priority::FRAME, reportError);
+
                     lua_getfield(L, -1, "draw");
                     if (lua_isfunction(L, -1)) {
                         BeginDrawing();
@@ -143,18 +265,40 @@ static bool runFile(Runtime& runtime, const char* name, lua_State* GL, int progr
                             runtime.reportError(L);
                             lua_pop(L, 1);
                         }
+                        // before EndDrawing, which sleeps away the rest of the frame
+                        scheduler::run(scheduler::Priority::BACKGROUND, backgroundDeadline(frameStart), reportError);
+                        graphics::before_present();
                         EndDrawing();
+                        graphics::end_frame();
                     } else {
                         lua_pop(L, 1);
+                        scheduler::run(scheduler::Priority::BACKGROUND, backgroundDeadline(frameStart), reportError);
+                        graphics::end_frame();
                     }
                 }
 
                 // restore stack to its original state to avoid leaving extra items on the stack
                 lua_settop(L, base);
+
+                std::chrono::duration<double> frameWork = std::chrono::steady_clock::now() - frameStart;
+                frameMetrics.frameWork.observe(frameWork.count());
+
+                frameMetrics.heapBytes.set(static_cast<int64_t>(lua_gc(L, LUA_GCCOUNT, 0)) * 1024 + lua_gc(L, LUA_GCCOUNTB, 0));
+                frameMetrics.runQueue.set(static_cast<int64_t>(runtime.runningThreads.size()));
+                framesSinceIdle = std::min(framesSinceIdle + 1, 2);
             });
-        } else if (!runtime.hasWork()) {
+        } else if (!runtime.hasWork() && !scheduler::has_work() && !scheduler::has_parked() && !timer::has_pending()) {
             quit = true;
             continue;
+        } else {
+            auto sliceStart = scheduler::Clock::now();
+            scheduler::run(scheduler::Priority::FRAME, reportError);
+            scheduler::run(scheduler::Priority::BACKGROUND, backgroundDeadline(sliceStart), reportError);
+
+            if (!runtime.hasWork() && !scheduler::has_work()) {
+                // only timers and parked calls left, wait in the loop their sockets complete on
+                waitForEvents(std::chrono::milliseconds(1));
+            }
         }
 
         if (runtime.hasWork()) {
@@ -171,21 +315,25 @@ static bool runFile(Runtime& runtime, const char* name, lua_State* GL, int progr
                 runtime.reportError(err->L);
 
                 // ensure we exit the process with error code properly
-                if (!runtime.hasWork()) {
+                if (!runtime.hasWork() && !scheduler::has_work() && !scheduler::has_parked() && !timer::has_pending()) {
                     quit = true;
                     result = false;
                     continue;
                 }
             }
 
-            if (!windowCreated) {
+            if (!windowCreated && !scheduler::has_work()) {
                 // yield to avoid busy loop
                 std::this_thread::sleep_for(std::chrono::milliseconds(10));
             }
         }
     }
 
+    // the handler refers to this runtime
+    timer::set_error_handler(nullptr);
+
     if (windowCreated) {
+        graphics::shutdown();
         CloseWindow();
     }
 
@@ -248,6 +396,10 @@ void displayRunHelp()
 	printf("\n");
 	printf("Options:\n");
 	printf("  -h, --help          Display this help message\n");
+	printf("  --metrics <port>    Serve Prometheus metrics on the given port\n");
+	printf("  --metrics-host <ip> Address to bind the metrics server to (default 127.0.0.1)\n");
+	printf("  --on-demand         Only draw when the script calls window.invalidate() or input arrives\n");
+	printf("  --software          Rasterize on the CPU, for machines without a usable GPU\n");
 	printf("\n");
 }
 
@@ -259,6 +411,8 @@ void setupLuaState(lua_State* L) {
         {"@adore/colors", adoreopen_colors},
         {"@adore/gui", adoreopen_gui},
         {"@adore/input", adoreopen_input},
+        {"@adore/scheduler", adoreopen_scheduler},
+        {"@adore/timer", adoreopen_timer},
 #ifdef ADORE_BLACKMAGIC
         {"@adore/blackmagic", adoreopen_blackmagic},
         {"@adore/hyperdeck", adoreopen_hyperdeck},
@@ -281,6 +435,8 @@ int handleRunCommand(int argc, char** argv, int argOffset)
     std::string filePath;
     int program_argc = 0;
     char** program_argv = nullptr;
+    int metricsPort = 0;
+    std::string metricsHost = "127.0.0.1";
 
     for (int i = argOffset; i < argc; ++i)
     {
@@ -291,6 +447,22 @@ int handleRunCommand(int argc, char** argv, int argOffset)
             displayRunHelp();
             return 0;
         }
+        else if (strcmp(currentArg, "--metrics") == 0 && i + 1 < argc)
+        {
+            metricsPort = atoi(argv[++i]);
+        }
+        else if (strcmp(currentArg, "--metrics-host") == 0 && i + 1 < argc)
+        {
+            metricsHost = argv[++i];
+        }
+        else if (strcmp(currentArg, "--on-demand") == 0)
+        {
+            window::set_on_demand(true);
+        }
+        else if (strcmp(currentArg, "--software") == 0)
+        {
+            software::enable();
+        }
         else if (currentArg[0] == '-')
         {
             fprintf(stderr, "Error: Unrecognized option '%s'\n\n", currentArg);
@@ -313,6 +485,19 @@ int handleRunCommand(int argc, char** argv, int argOffset)
         return 1;
     }
 
+    if (metricsPort > 0)
+    {
+        std::string error;
+        if (!metrics::serve(metricsHost.c_str(), metricsPort, error))
+        {
+            fprintf(stderr, "Error: %s\n", error.c_str());
+            return 1;
+        }
+    }
+
+    // recording lives in graphics but belongs on the window table
+    window::extend(recorder::lib);
+
     Runtime runtime;
     lua_State* L = setupCliState(runtime, setupLuaState);
 
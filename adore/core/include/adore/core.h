@@ -6,6 +6,14 @@ constexpr int kTextureUserdataTag = 100;
 constexpr int kImageUserdataTag = 99;
 constexpr int kFontUserdataTag = 98;
 constexpr int kRenderTextureUserdataTag = 97;
+constexpr int kDrawListUserdataTag = 96;
+constexpr int kAtlasUserdataTag = 95;
+constexpr int kTextUserdataTag = 94;
+constexpr int kDynamicFontUserdataTag = 93;
+constexpr int kEmitterUserdataTag = 92;
+constexpr int kShaderUserdataTag = 91;
+// 90 to 88 are taken by blackmagic
+constexpr int kLayerUserdataTag = 87;
 
 // Blackmagic userdata tags
 constexpr int kHyperdeckDeviceUserdataTag = 90;
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "lua.h"
+#include "lualib.h"
+
+#include "raylib.h"
+
+#include "adore/resources.h"
+
+#include <cstdint>
+#include <string>
+
+int adoreregister_assets(lua_State* L);
+
+// Loads of the same file get handles of their own on one reference counted
+// texture or font, which is only unloaded when the last handle is released or
+// collected. Handles that are about to change it take a private copy first.
+// Collected assets can be kept around in a byte-bounded LRU and revived
+// without decoding or uploading again. Files are checked for modification
+// on every lookup.
+// Images are changed in place, so they are never shared. Every load gets its
+// own copy, and the LRU only keeps the pixels as they were decoded.
+namespace assets
+{
+
+struct Key {
+    resources::Kind kind;
+    // normalized path plus load parameters
+    std::string id;
+    std::string path;
+};
+
+// `variant` tells apart loads of the same file with different options
+Key key(resources::Kind kind, const char* path, int size = 0, const char* variant = nullptr);
+
+// Push a new handle on the cached resource for `key`, reviving a retained one if needed. Returns false on a miss.
+bool push(lua_State* L, const Key& key);
+
+// Remember the userdata at `index`, freshly loaded for `key`, as the first handle on the resource
+void store(lua_State* L, int index, const Key& key, uintptr_t handle);
+
+// Called from finalizers, drops the handle and takes over the resource if it was the last one and
+// retention is enabled. Returns false if the caller must unload it.
+bool retain(resources::Kind kind, uintptr_t handle, const Texture2D& texture);
+bool retain(resources::Kind kind, uintptr_t handle, const Font& font);
+
+// Copy the retained pixels of an image into `image`. Returns false on a miss.
+bool copy(const Key& key, Image& image);
+
+// Keep a copy of freshly decoded pixels for `key` if retention is enabled
+void keep(const Key& key, const Image& image);
+
+// Drop a handle that is released explicitly. Returns true while other handles still use the
+// resource, the caller must then leave it loaded.
+bool drop(resources::Kind kind, uintptr_t handle);
+
+// Whether more than one handle uses the resource
+bool shared(resources::Kind kind, uintptr_t handle);
+
+// Stop handing out a resource whose contents are about to change, its one handle keeps it
+void forget(resources::Kind kind, uintptr_t handle);
+
+int stats(lua_State* L);
+int setretention(lua_State* L);
+int flush(lua_State* L);
+
+static const luaL_Reg lib[] = {
+    { "stats", stats },
+    { "setretention", setretention },
+    { "flush", flush },
+    {nullptr, nullptr},
+};
+
+} // namespace assets
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "lua.h"
+#include "lualib.h"
+
+#include "raylib.h"
+
+#include <vector>
+
+int adoreregister_atlas(lua_State* L);
+
+namespace atlas
+{
+
+struct Entry {
+    int page;
+    Rectangle region;
+};
+
+struct Atlas {
+    std::vector<Texture2D> pages;
+    std::vector<Entry> entries;
+};
+
+int pack(lua_State* L);
+Atlas* check_atlas(lua_State* L, int index);
+int index(lua_State* L);
+int get(lua_State* L);
+int page(lua_State* L);
+int release(lua_State* L);
+
+static const luaL_Reg udata[] = {
+    { "get", get },
+    { "page", page },
+    { "release", release },
+    {nullptr, nullptr},
+};
+
+static const luaL_Reg lib[] = {
+    { "pack", pack },
+    { "get", get },
+    { "page", page },
+    { "release", release },
+    {nullptr, nullptr},
+};
+
+} // namespace atlas
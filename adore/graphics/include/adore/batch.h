@@ -0,0 +1,29 @@
+#pragma once
+
+#include "lua.h"
+#include "lualib.h"
+
+// Sprites drawn from a packed buffer with one texture bind, see graphics.batch.
+namespace batch
+{
+
+// Instance layout, all little endian f32 except the tint:
+//   0  x, y                    destination position
+//   8  sx, sy, sw, sh          source rectangle in texels, negative size flips
+//  24  scalex, scaley
+//  32  originx, originy        rotation origin in destination pixels
+//  40  rotation                degrees
+//  44  r, g, b, a              u8 tint
+constexpr size_t kInstanceSize = 48;
+
+int draw(lua_State* L);
+
+// Send the quads drawn through rlgl until end() to the sprite batch with
+// `texture` bound. Whatever was drawn before is flushed first to keep ordering.
+void begin(unsigned int texture);
+void end();
+
+// Free the GPU buffers of the sprite batch, call before the window is closed
+void shutdown();
+
+} // namespace batch
@@ -0,0 +1,27 @@
+#pragma once
+
+// Separable filters over R8G8B8A8 or R32G32B32A32 pixels, in place. Rows are
+// filtered in bands and columns in narrow strips, both spread across the job
+// workers, working in float with one SSE register per pixel. Edges repeat the
+// outermost pixel.
+namespace convolve
+{
+
+struct Surface {
+    void* data;
+    int width;
+    int height;
+    // R32G32B32A32 when true, R8G8B8A8 otherwise
+    bool isFloat;
+};
+
+// Gaussian blur with standard deviation `sigma`, approximated by three box
+// passes per axis so the cost does not depend on the radius
+void blur(const Surface& surface, float sigma);
+
+// Convolve rows with `horizontal` and then columns with `vertical`. Both
+// kernels have an odd length and are centered on the pixel. 8-bit pixels are
+// rounded and clamped between the two passes.
+void separable(const Surface& surface, const float* horizontal, int horizontalSize, const float* vertical, int verticalSize);
+
+} // namespace convolve
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "lua.h"
+#include "lualib.h"
+
+#include "raylib.h"
+
+#include <vector>
+
+int adoreregister_drawlist(lua_State* L);
+
+// Draw calls captured by graphics.record and replayed by list:draw. Geometry is
+// built once while recording, replay only pushes the stored vertices to rlgl.
+namespace drawlist
+{
+
+struct Vertex {
+    float x, y;
+    float u, v;
+    Color color;
+};
+
+struct Span {
+    unsigned int texture;
+    // RL_LINES, RL_TRIANGLES, RL_QUADS or kClear
+    int mode;
+    size_t first;
+    size_t count;
+    // id field of the handle the texture was drawn through, nullptr for textures that
+    // live as long as the window. Replay binds whatever the handle holds by then and
+    // skips the span once it holds nothing, after the handle was released or its
+    // render target went back to the pool.
+    const unsigned int* owner;
+};
+
+constexpr int kClear = -1;
+
+struct DrawList {
+    std::vector<Vertex> vertices;
+    std::vector<Span> spans;
+    // registry ref of the table keeping recorded resources alive, only set while recording
+    int anchorsRef;
+
+    void clear(Color color);
+    void rectangle(Rectangle rect, Color color);
+    void rectangle_lines(Rectangle rect, Color color);
+    void circle(Vector2 center, float radius, Color color);
+    void circle_lines(Vector2 center, float radius, Color color);
+    void texture(const Texture2D& texture, Rectangle source, Rectangle dest, Vector2 origin, float rotation, Color tint, const unsigned int* owner = nullptr);
+    // `font` must be the font's own storage, its texture id is checked on replay
+    void text(const Font& font, const char* text, Vector2 position, float fontSize, float spacing, Color tint);
+
+private:
+    void begin(unsigned int texture, int mode, const unsigned int* owner = nullptr);
+    void vertex(float x, float y, float u, float v, Color color);
+};
+
+// The list being recorded into, nullptr when draw calls should go straight to the screen
+DrawList* recording();
+
+// Where draw calls go instead of rlgl: the list being recorded, or the software
+// renderer's commands for the current target. nullptr when drawing with the GPU.
+DrawList* capture();
+
+// Keep the value at `index` alive for as long as the list being recorded
+void anchor(lua_State* L, int index);
+
+int record(lua_State* L);
+DrawList* check_drawlist(lua_State* L, int index);
+int index(lua_State* L);
+int draw(lua_State* L);
+int stats(lua_State* L);
+
+static const luaL_Reg udata[] = {
+    { "draw", draw },
+    { "stats", stats },
+    {nullptr, nullptr},
+};
+
+static const luaL_Reg lib[] = {
+    { "record", record },
+    { "draw", draw },
+    { "stats", stats },
+    {nullptr, nullptr},
+};
+
+} // namespace drawlist
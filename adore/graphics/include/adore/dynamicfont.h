@@ -0,0 +1,96 @@
+#pragma once
+
+#include "lua.h"
+#include "lualib.h"
+
+#include "raylib.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+int adoreregister_dynamicfont(lua_State* L);
+
+// Fonts whose glyphs are rasterized the first time they are drawn or measured.
+// Glyphs live on a few atlas pages, the least recently drawn page is cleared
+// when they are all full.
+namespace dynamicfont
+{
+
+struct Glyph {
+    // -1 for glyphs without pixels, such as spaces
+    int page;
+    Rectangle rec;
+    float offsetX;
+    float offsetY;
+    float advanceX;
+};
+
+struct Shelf {
+    int y;
+    int height;
+    int x;
+};
+
+struct Page {
+    Texture2D texture;
+    // GRAY_ALPHA copy of the texture, rows [dirtyTop, dirtyBottom) are not uploaded yet
+    std::vector<unsigned char> pixels;
+    std::vector<Shelf> shelves;
+    std::vector<int> codepoints;
+    int dirtyTop;
+    int dirtyBottom;
+    uint64_t lastUsed;
+};
+
+struct DynamicFont {
+    std::vector<unsigned char> fileData;
+    int baseSize;
+    int pageSize;
+    size_t maxPages;
+
+    std::unordered_map<int, Glyph> glyphs;
+    std::vector<Page> pages;
+    // bumped by every draw and measure, pages used by the current call are never evicted
+    uint64_t stamp;
+
+    uint64_t rasterized;
+    uint64_t evicted;
+    uint64_t uploads;
+
+    const Glyph& glyph(int codepoint);
+    // Upload the rows changed since the last flush
+    void flush();
+    void release();
+
+private:
+    bool place(int width, int height, int& page, int& x, int& y);
+    int evict();
+};
+
+int load(lua_State* L);
+DynamicFont* check_dynamicfont(lua_State* L, int index);
+int index(lua_State* L);
+int draw(lua_State* L);
+int measure(lua_State* L);
+int stats(lua_State* L);
+int release(lua_State* L);
+
+static const luaL_Reg udata[] = {
+    { "draw", draw },
+    { "measure", measure },
+    { "stats", stats },
+    { "release", release },
+    {nullptr, nullptr},
+};
+
+static const luaL_Reg lib[] = {
+    { "load", load },
+    { "draw", draw },
+    { "measure", measure },
+    { "stats", stats },
+    { "release", release },
+    {nullptr, nullptr},
+};
+
+} // namespace dynamicfont
@@ -17,8 +17,17 @@ int index(lua_State* L);
 int draw_font(lua_State* L);
 int measure_text(lua_State* L);
 int get_default_font(lua_State* L);
+int release(lua_State* L);
+
+// Fonts loaded with { sdf = true } keep a distance field atlas and must be
+// drawn with sdf_shader() active
+bool is_sdf(const Font& font);
+const Shader& sdf_shader();
+// Unload the shader, call before the window is closed
+void shutdown();
 
 static const luaL_Reg udata[] = {
+    { "release", release },
     {nullptr, nullptr},
 };
 
@@ -27,6 +36,7 @@ static const luaL_Reg lib[] = {
     { "draw", draw_font },
     { "measure", measure_text }, 
     { "getdefault", get_default_font },
+    { "release", release },
     {nullptr, nullptr},
 };
 
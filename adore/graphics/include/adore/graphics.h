@@ -7,6 +7,16 @@
 #include "adore/rendertexture.h"
 #include "adore/image.h"
 #include "adore/font.h"
+#include "adore/batch.h"
+#include "adore/drawlist.h"
+#include "adore/atlas.h"
+#include "adore/loader.h"
+#include "adore/assets.h"
+#include "adore/text.h"
+#include "adore/dynamicfont.h"
+#include "adore/particles.h"
+#include "adore/shader.h"
+#include "adore/layers.h"
 
 
 // open the library as a table on top of the stack
@@ -15,16 +25,33 @@ int adoreopen_graphics(lua_State* L);
 namespace graphics
 {
 
+// Call after EndDrawing(), finishes asynchronous loads and unloads the GPU
+// resources released during the frame, both within their per-frame budgets.
+void end_frame();
+// Call after the draw callback and before EndDrawing(), while the frame is
+// still in the back buffer.
+void before_present();
+// Unload everything still queued, call before the window is closed.
+void shutdown();
+
 int rectangle(lua_State* L);
 int circle(lua_State* L);
 int print(lua_State* L);
 int clear(lua_State* L);
+int setreleasebudget(lua_State* L);
+// Draw calls submitted to the GPU during the last finished frame
+int drawcalls(lua_State* L);
 
 static const luaL_Reg lib[] = {
     {"rectangle", rectangle},
     {"circle", circle},
     {"print", print},
     {"clear", clear},
+    {"setreleasebudget", setreleasebudget},
+    {"drawcalls", drawcalls},
+    {"batch", batch::draw},
+    {"record", drawlist::record},
+    {"setuploadbudget", loader::setuploadbudget},
 
     {nullptr, nullptr},
 };
@@ -34,6 +61,14 @@ static const luaL_Reg modules[] = {
     { "image", adoreregister_image },
     { "font", adoreregister_font },
     { "rendertexture", adoreregister_rendertexture },
+    { "drawlist", adoreregister_drawlist },
+    { "atlas", adoreregister_atlas },
+    { "assets", adoreregister_assets },
+    { "text", adoreregister_text },
+    { "dynamicfont", adoreregister_dynamicfont },
+    { "particles", adoreregister_particles },
+    { "shader", adoreregister_shader },
+    { "layers", adoreregister_layers },
 
     { nullptr, nullptr }
 };
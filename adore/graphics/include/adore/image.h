@@ -11,21 +11,53 @@ namespace image
 {
 
 int load_image(lua_State* L);
+int load_image_async(lua_State* L);
 Image* check_image(lua_State* L, int index);
 int create_image_userdata(lua_State* L, const Image& image);
 int index(lua_State* L);
+// Pixel format by name, as used by image.format
+int check_format(lua_State* L, int index);
 
 int format_image(lua_State* L);
+int swizzle_image(lua_State* L);
+int premultiply_image(lua_State* L);
+int unpremultiply_image(lua_State* L);
+int resize_image(lua_State* L);
+int genmipmaps(lua_State* L);
+int blur_image(lua_State* L);
+int convolve_image(lua_State* L);
+// Cap the conversion kernels at "reference" (raylib), "scalar", "sse2" or "avx2"
+int setkernels(lua_State* L);
+// Move the pixels into a buffer the image keeps using, so scripts can read and
+// write them directly. Later calls return the same buffer.
+int lock(lua_State* L);
+// Image over the memory of a buffer, which stays alive as long as the image does
+int from_buffer(lua_State* L);
 int export_image(lua_State* L);
+int release(lua_State* L);
 
 static const luaL_Reg udata[] = {
+    {"lock", lock},
+    {"release", release},
     {nullptr, nullptr},
 };
 
 static const luaL_Reg lib[] = {
     {"load", load_image},
+    {"loadasync", load_image_async},
+    {"frombuffer", from_buffer},
+    {"lock", lock},
     {"format", format_image},
+    {"swizzle", swizzle_image},
+    {"premultiply", premultiply_image},
+    {"unpremultiply", unpremultiply_image},
+    {"resize", resize_image},
+    {"genmipmaps", genmipmaps},
+    {"blur", blur_image},
+    {"convolve", convolve_image},
+    {"setkernels", setkernels},
     {"export", export_image},
+    {"release", release},
     {nullptr, nullptr},
 };
 
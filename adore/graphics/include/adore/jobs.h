@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+// Small pool of worker threads for CPU work that must stay off the render thread.
+// Jobs must not touch Luau or the GL context, hand results back to the main thread.
+namespace jobs
+{
+
+void submit(std::function<void()> job);
+
+// Split [0, count) into bands of at least `grain` items, run them on the workers
+// and the calling thread, and return once all are done. Bands go ahead of submitted
+// jobs, and the caller runs whatever no worker picked up. Only call from the main
+// thread, a worker waiting on other workers could wait forever.
+void parallel_for(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& body);
+
+// Drop queued jobs, wait for the running ones and join the workers
+void shutdown();
+
+} // namespace jobs
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "lua.h"
+#include "lualib.h"
+
+#include "raylib.h"
+
+#include <cstdint>
+
+int adoreregister_layers(lua_State* L);
+
+// Layers keep what their draw function produced in a render texture of their
+// own and only call it again once invalidated, or every frame while animating.
+// Compositing a layer that has not changed is a single textured quad. Layers
+// switch render targets, draw them outside of a RenderTexture's start() and stop().
+namespace layers
+{
+
+struct Layer {
+    // premultiplied contents of the last render
+    RenderTexture target;
+    // raylib blend mode used to composite the layer
+    int blend;
+    float opacity;
+    bool visible;
+    bool dirty;
+    // re-render every frame, for layers that always move
+    bool animated;
+    // GetTime() until which the layer re-renders every frame
+    double animateUntil;
+    // registry reference to the draw function, dropped by release(). It is a root,
+    // so a function that captures its own layer keeps both alive until then.
+    int drawRef;
+
+    uint64_t renders;
+    uint64_t composites;
+
+    bool stale() const;
+};
+
+int create(lua_State* L);
+Layer* check_layer(lua_State* L, int index);
+int index(lua_State* L);
+// Change the blend mode, opacity or visibility, none of which re-render the layer
+int set(lua_State* L);
+int invalidate(lua_State* L);
+// Re-render every frame for the given number of seconds
+int animate(lua_State* L);
+int draw(lua_State* L);
+// Draw an array of layers in order, rendering only those that changed
+int composite(lua_State* L);
+int stats(lua_State* L);
+int release(lua_State* L);
+
+static const luaL_Reg udata[] = {
+    { "set", set },
+    { "invalidate", invalidate },
+    { "animate", animate },
+    { "draw", draw },
+    { "stats", stats },
+    { "release", release },
+    {nullptr, nullptr},
+};
+
+static const luaL_Reg lib[] = {
+    { "create", create },
+    { "set", set },
+    { "invalidate", invalidate },
+    { "animate", animate },
+    { "draw", draw },
+    { "composite", composite },
+    { "stats", stats },
+    { "release", release },
+    {nullptr, nullptr},
+};
+
+} // namespace layers
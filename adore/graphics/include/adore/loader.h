@@ -0,0 +1,27 @@
+#pragma once
+
+#include "lua.h"
+#include "lualib.h"
+
+#include <cstddef>
+
+// Images and textures decoded on worker threads. Decoded textures are uploaded
+// on the main thread after each frame, a few rows at a time within a byte budget.
+namespace loader
+{
+
+enum class Target {
+    IMAGE,
+    TEXTURE,
+};
+
+// Decode `path` on a worker and yield the calling thread until the result is ready
+int load_async(lua_State* L, const char* path, Target target);
+
+// Call after the frame is presented, resumes finished loads and continues uploads
+void update();
+void shutdown();
+
+int setuploadbudget(lua_State* L);
+
+} // namespace loader
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "lua.h"
+#include "lualib.h"
+
+#include "raylib.h"
+
+#include <cstdint>
+#include <vector>
+
+int adoreregister_particles(lua_State* L);
+
+// Emitters whose particles live in native arrays, one per attribute, so the
+// update runs as SSE2 or AVX2 kernels and drawing is one pass into the sprite
+// batch. Scripts set the emitter's parameters, they never see single particles.
+namespace particles
+{
+
+// entries in the size and color over life tables
+constexpr int kCurveSteps = 64;
+
+struct Emitter {
+    // structure of arrays, sized to the capacity rounded up to a whole vector
+    std::vector<float> x, y;
+    std::vector<float> vx, vy;
+    // age over lifetime, the particle dies at 1
+    std::vector<float> age;
+    // 1 / lifetime
+    std::vector<float> aging;
+    size_t count;
+    size_t capacity;
+
+    float originX, originY;
+    // spawn area centered on the origin
+    float width, height;
+    // particles per second, and the fraction of one carried to the next update
+    float rate;
+    float pending;
+    float lifetimeMin, lifetimeMax;
+    float speedMin, speedMax;
+    // degrees, the cone is spread wide around direction
+    float direction, spread;
+    float gravityX, gravityY;
+    // fraction of velocity lost per second
+    float drag;
+    bool additive;
+
+    float sizes[kCurveSteps];
+    Color colors[kCurveSteps];
+
+    uint32_t random;
+
+    void spawn(size_t amount);
+    void update(float dt);
+    void draw(const Texture2D* texture, Rectangle region);
+    void release();
+};
+
+int create(lua_State* L);
+Emitter* check_emitter(lua_State* L, int index);
+int index(lua_State* L);
+// Change any option but the capacity, the particles already alive keep going
+int set(lua_State* L);
+int update(lua_State* L);
+// Spawn a burst of particles now, on top of the rate
+int emit(lua_State* L);
+int draw(lua_State* L);
+int clear(lua_State* L);
+int release(lua_State* L);
+
+static const luaL_Reg udata[] = {
+    { "set", set },
+    { "update", update },
+    { "emit", emit },
+    { "draw", draw },
+    { "clear", clear },
+    { "release", release },
+    {nullptr, nullptr},
+};
+
+static const luaL_Reg lib[] = {
+    { "create", create },
+    { "set", set },
+    { "update", update },
+    { "emit", emit },
+    { "draw", draw },
+    { "clear", clear },
+    { "release", release },
+    {nullptr, nullptr},
+};
+
+} // namespace particles
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+
+// For kernel files: whether SSE2 and AVX2 paths exist, and how to mark a
+// function as AVX2 without building the whole file for it
+#if defined(__x86_64__) || defined(_M_X64)
+#define ADORE_PIXELS_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#define ADORE_TARGET_AVX2
+#else
+#define ADORE_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// Pixel conversion and alpha kernels, vectorized with SSE2 or AVX2 when the CPU
+// has them. Every level produces exactly the same bytes as the scalar code.
+namespace pixels
+{
+
+enum class Level {
+    // no kernels at all, callers fall back to raylib's ImageFormat
+    REFERENCE,
+    SCALAR,
+    SSE2,
+    AVX2,
+};
+
+// Best level this CPU supports, capped by limit()
+Level level();
+const char* level_name(Level level);
+// Cap the level used from now on, for benchmarks and for checking the fallbacks
+void limit(Level level);
+
+// Whether convert() has a kernel between these two raylib pixel formats
+bool can_convert(int from, int to);
+
+// Convert `count` pixels between formats accepted by can_convert(). Source and
+// destination may be the same memory when the destination pixel is not larger.
+void convert(const void* source, int from, void* destination, int to, size_t count);
+
+// Reorder the channels of R8G8B8A8 pixels, channel i of the result is channel
+// order[i] of the source. All three work in place.
+void swizzle(const unsigned char* source, unsigned char* destination, size_t count, const unsigned char order[4]);
+void premultiply(const unsigned char* source, unsigned char* destination, size_t count);
+void unpremultiply(const unsigned char* source, unsigned char* destination, size_t count);
+
+} // namespace pixels
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <functional>
+
+// Asynchronous copies of framebuffer pixels back to system memory. Each copy
+// goes into one of a small ring of pixel buffer objects and is only mapped once
+// its fence has signalled, usually a frame or two later, so the CPU never waits
+// for the GPU to catch up.
+namespace readback
+{
+
+// Receives RGBA8 rows bottom to top as OpenGL stores them, or nullptr when the
+// readback was cancelled. The pixels are only valid during the call.
+using Callback = std::function<void(const unsigned char* pixels, int width, int height)>;
+
+// Whether the driver can read back asynchronously, OpenGL 3.3 or newer
+bool supported();
+
+// Queue a copy of the color attachment of `framebuffer`, 0 for the screen.
+// Returns false when the readback is not supported.
+bool request(unsigned int framebuffer, int width, int height, Callback done);
+
+// Copy bottom-up rows into `destination` top to bottom, as images are stored
+void copy_flipped(const unsigned char* pixels, int width, int height, unsigned char* destination);
+
+// Hand finished readbacks to their callbacks, call once per frame
+void update();
+
+// Cancel everything in flight and delete the buffers
+void shutdown();
+
+} // namespace readback
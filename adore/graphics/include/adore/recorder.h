@@ -0,0 +1,34 @@
+#pragma once
+
+#include "lua.h"
+#include "lualib.h"
+
+// Records presented frames, or a render texture, to disk. Frames are read back
+// asynchronously and handed to writer threads through a bounded queue, so the
+// render thread only pays for a copy out of the mapped buffer.
+namespace recorder
+{
+
+int start(lua_State* L);
+int stop(lua_State* L);
+int stats(lua_State* L);
+
+// Queue the readback of this frame, call after drawing and before EndDrawing()
+void capture();
+
+// Resume stop() callers once their writers have finished, call once per frame
+void update();
+
+// Stop recording and wait for everything queued to be written
+void shutdown();
+
+// Installed into the window table by the host, window cannot depend on graphics
+static const luaL_Reg lib[] = {
+    { "startrecording", start },
+    { "stoprecording", stop },
+    { "recordingstats", stats },
+
+    {nullptr, nullptr},
+};
+
+} // namespace recorder
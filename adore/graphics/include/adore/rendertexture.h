@@ -10,14 +10,38 @@ int adoreregister_rendertexture(lua_State* L);
 namespace rendertexture
 {
 
+RenderTexture* check_rendertexture(lua_State* L, int index);
+
+// The target between start() and stop(), nullptr when drawing to the screen
+const RenderTexture* active();
+
 int create(lua_State* L);
+int acquire(lua_State* L);
+int temporary(lua_State* L);
+int poolstats(lua_State* L);
 int start(lua_State* L);
 int stop(lua_State* L);
+int release(lua_State* L);
+int readasync(lua_State* L);
+
+// Return this frame's temporaries to the pool, call after EndDrawing()
+void end_frame();
+
+static const luaL_Reg udata[] = {
+    { "readasync", readasync },
+    { "release", release },
+    {nullptr, nullptr},
+};
 
 static const luaL_Reg lib[] = {
     { "create", create },
+    { "acquire", acquire },
+    { "temporary", temporary },
+    { "poolstats", poolstats },
     { "start", start },
     { "stop", stop },
+    { "readasync", readasync },
+    { "release", release },
 
     {nullptr, nullptr},
 };
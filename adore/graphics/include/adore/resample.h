@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+
+// Separable resampling of R8G8B8A8 pixels. Weights are 14-bit fixed point and
+// each pass is split across the job workers by row bands, with SSE2 or AVX2
+// inner loops when pixels::level() allows them.
+namespace resample
+{
+
+enum class Filter {
+    BOX,
+    BILINEAR,
+    LANCZOS,
+};
+
+// Resample `source` into `destination`, which must hold width * height * 4 bytes
+void resize(const unsigned char* source, int sourceWidth, int sourceHeight, unsigned char* destination, int width, int height, Filter filter);
+
+// Bytes needed for an R8G8B8A8 mip chain down to 1x1, and how many levels it has
+size_t mipmap_size(int width, int height, int* levels);
+
+// Fill the levels after the first in a chain laid out like raylib's ImageMipmaps,
+// each one box filtered from the one before
+void mipmaps(unsigned char* chain, int width, int height, int levels);
+
+} // namespace resample
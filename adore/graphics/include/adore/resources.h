@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "raylib.h"
+
+// Bookkeeping for the native resources held by graphics userdata.
+namespace resources
+{
+
+enum class Kind {
+    TEXTURE,
+    IMAGE,
+    FONT,
+    RENDERTEXTURE,
+    SHADER,
+};
+
+void track(Kind kind, int64_t bytes);
+void untrack(Kind kind, int64_t bytes);
+
+// GPU resources are never unloaded from inside the garbage collector or mid
+// frame. They are queued here and unloaded by drain() once the frame has been
+// presented. Bookkeeping is updated when the resource is actually unloaded.
+void defer(const Texture2D& texture);
+void defer(const Font& font);
+void defer(const RenderTexture& rendertexture);
+void defer(const Shader& shader);
+
+// Unload up to `budget` queued resources, or everything when budget is 0.
+// Returns how many were unloaded.
+size_t drain(size_t budget = 0);
+size_t pending();
+
+int64_t texture_bytes(const Texture2D& texture);
+int64_t image_bytes(const Image& image);
+int64_t font_bytes(const Font& font);
+int64_t rendertexture_bytes(const RenderTexture& rendertexture);
+
+} // namespace resources
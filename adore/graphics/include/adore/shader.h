@@ -0,0 +1,98 @@
+#pragma once
+
+#include "lua.h"
+#include "lualib.h"
+
+#include "raylib.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+int adoreregister_shader(lua_State* L);
+
+// GLSL programs compiled once at load. Their uniforms are looked up when the
+// program is linked and keep their last value, a send() that changes nothing
+// does not reach the driver and changed values wait until the shader is used.
+namespace shader
+{
+
+enum class UniformType {
+    FLOAT,
+    VEC2,
+    VEC3,
+    VEC4,
+    INT,
+    IVEC2,
+    IVEC3,
+    IVEC4,
+    MAT4,
+    SAMPLER2D,
+    UNSUPPORTED,
+};
+
+struct Uniform {
+    int location;
+    UniformType type;
+    // array length, 1 for plain uniforms
+    int count;
+    // components of every element, ints are stored as floats too
+    std::vector<float> value;
+    // id of the Texture userdata last sent to a sampler, which the shader keeps
+    // alive, read when binding so a released texture unbinds instead
+    const unsigned int* texture;
+    bool dirty;
+};
+
+struct ShaderRef {
+    Shader shader;
+    std::unordered_map<std::string, Uniform> uniforms;
+
+    uint64_t uploads;
+    uint64_t skipped;
+
+    // Send every uniform changed since the last flush, and bind the textures
+    void flush();
+    void upload(Uniform& uniform);
+};
+
+// The shader between begin() and finish(), nullptr when drawing with the default one
+const Shader* active();
+// End a pass the script left open, call before the frame is presented
+void reset();
+
+int load(lua_State* L);
+int from_string(lua_State* L);
+ShaderRef* check_shader(lua_State* L, int index);
+int index(lua_State* L);
+int send(lua_State* L);
+int begin(lua_State* L);
+int finish(lua_State* L);
+int uniforms(lua_State* L);
+int stats(lua_State* L);
+int release(lua_State* L);
+
+static const luaL_Reg udata[] = {
+    { "send", send },
+    { "begin", begin },
+    { "finish", finish },
+    { "uniforms", uniforms },
+    { "stats", stats },
+    { "release", release },
+    {nullptr, nullptr},
+};
+
+static const luaL_Reg lib[] = {
+    { "load", load },
+    { "fromstring", from_string },
+    { "send", send },
+    { "begin", begin },
+    { "finish", finish },
+    { "uniforms", uniforms },
+    { "stats", stats },
+    { "release", release },
+    {nullptr, nullptr},
+};
+
+} // namespace shader
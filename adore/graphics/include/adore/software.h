@@ -0,0 +1,44 @@
+#pragma once
+
+#include "lua.h"
+#include "lualib.h"
+
+#include "raylib.h"
+
+#include "adore/drawlist.h"
+
+// Features that only exist on the GPU refuse to draw instead of leaving nothing behind
+#define SOFTWARE_UNSUPPORTED_CHECK(what) \
+    if (software::enabled()) { \
+        luaL_errorL(L, what " cannot be drawn by the software renderer"); \
+    }
+
+// CPU rasterizer for machines without a usable GPU. Draw calls are captured as
+// DrawList geometry, the same vertices rlgl would get, binned into screen tiles
+// and rasterized by the job workers. The finished frame is uploaded to one
+// texture and drawn with a single quad, which any OpenGL driver manages.
+namespace software
+{
+
+// Pick the software renderer, call before the script opens the window
+void enable();
+bool enabled();
+
+// The list draw calls of the current target go into, nullptr when not enabled
+drawlist::DrawList* commands();
+
+// Draw into a render texture instead of the screen until end_target()
+void begin_target(const RenderTexture& rendertexture);
+void end_target();
+
+// Rasterize what is left of the frame and draw it to the back buffer, call
+// before anything reads the back buffer back
+void present();
+
+// Drop the CPU copy of a texture whose pixels changed or that was unloaded,
+// after rasterizing what was drawn with the old pixels
+void forget(unsigned int textureId);
+
+void shutdown();
+
+} // namespace software
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "raylib.h"
+
+#include <cstdint>
+
+// Render textures recycled by size and format, so effects that need offscreen
+// targets every cue do not create and destroy framebuffers each time.
+namespace targetpool
+{
+
+// A new target outside the pool, id is 0 if the format cannot be rendered to
+RenderTexture load(int width, int height, int format);
+
+// A free target of this size and format, or a new one when there is none
+RenderTexture acquire(int width, int height, int format);
+
+// Put a target handed out by acquire() back, returns false for targets the pool does not own
+bool release(const RenderTexture& rendertexture);
+
+// Unload free targets that have not been acquired for a while, call once per frame
+void end_frame();
+
+// Unload every free target and every target still handed out. Releasing one of
+// those afterwards does nothing.
+void shutdown();
+
+struct Stats {
+    size_t free;
+    size_t inuse;
+    uint64_t created;
+    uint64_t reused;
+};
+
+Stats stats();
+
+} // namespace targetpool
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "lua.h"
+#include "lualib.h"
+
+#include "raylib.h"
+
+#include <string>
+#include <vector>
+
+int adoreregister_text(lua_State* L);
+
+// Text laid out once for a font, size and spacing. The glyph quads and bounds are
+// kept between frames, drawing submits them in one batch without touching the string.
+namespace text
+{
+
+enum class Align {
+    LEFT,
+    CENTER,
+    RIGHT,
+};
+
+struct Glyph {
+    int line;
+    // padded rectangle in the font atlas
+    Rectangle source;
+    // x relative to the start of the line, y relative to the top of the text
+    Rectangle dest;
+};
+
+struct Line {
+    size_t firstGlyph;
+    // byte offset of the line in the string
+    size_t start;
+    float width;
+};
+
+struct Text {
+    std::string string;
+    // nullptr for the default font, kept alive through the registry while the text is
+    Font* font;
+    float size;
+    float spacing;
+    // wrap lines longer than this, 0 to only break at newlines
+    float wrap;
+    Align align;
+
+    std::vector<Glyph> glyphs;
+    std::vector<Line> lines;
+    float width;
+    float height;
+
+    const Font& source() const;
+    // Lay the string out again starting at line `from`, earlier lines are kept
+    void layout(size_t from);
+    // Replace the string, only the lines from the first change on are laid out again
+    void set(const char* value, size_t length);
+};
+
+int create(lua_State* L);
+Text* check_text(lua_State* L, int index);
+int index(lua_State* L);
+int draw(lua_State* L);
+int set(lua_State* L);
+int setwrap(lua_State* L);
+int setalign(lua_State* L);
+
+static const luaL_Reg udata[] = {
+    { "draw", draw },
+    { "set", set },
+    { "setwrap", setwrap },
+    { "setalign", setalign },
+    {nullptr, nullptr},
+};
+
+static const luaL_Reg lib[] = {
+    { "create", create },
+    { "draw", draw },
+    { "set", set },
+    { "setwrap", setwrap },
+    { "setalign", setalign },
+    {nullptr, nullptr},
+};
+
+} // namespace text
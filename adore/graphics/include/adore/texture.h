@@ -13,28 +13,45 @@ namespace texture
 struct TextureRef {
     Texture2D texture;
     bool owned;
+    // part of the texture this handle draws, the whole texture unless it is an atlas entry
+    Rectangle region;
 };
 
 int load_texture_from_path(lua_State* L);
+int load_texture_async(lua_State* L);
 int load_texture_from_image(lua_State* L);
 int load_texture_from_render(lua_State* L);
 TextureRef* check_texture(lua_State* L, int index);
 int create_texture_userdata(lua_State* L, const Texture2D& texture, bool owned = true);
+// Non-owning handle drawing only `region` of the texture
+int create_texture_region_userdata(lua_State* L, const Texture2D& texture, const Rectangle& region);
+// Push the cached non-owning view of a texture held by the userdata at ownerIndex
+int push_texture_view(lua_State* L, int ownerIndex, const Texture2D& texture);
+// Mark the cached view of a texture as released, if there is one
+void invalidate_texture_view(lua_State* L, const Texture2D& texture);
 int index(lua_State* L);
 int draw_texture(lua_State* L);
 int draw_texture_flipped(lua_State* L);
 int set_filter(lua_State* L);
+// Upload tightly packed pixels of the texture's format into part of it
+int update(lua_State* L);
+int release(lua_State* L);
 
 static const luaL_Reg udata[] = {
+    { "update", update },
+    { "release", release },
     {nullptr, nullptr},
 };
 
 static const luaL_Reg lib[] = {
     { "load", load_texture_from_path },
+    { "loadasync", load_texture_async },
     { "fromimage", load_texture_from_image },
     { "draw", draw_texture },
     { "drawflipped", draw_texture_flipped },
     { "setfilter", set_filter },
+    { "update", update },
+    { "release", release },
 
     {nullptr, nullptr},
 };
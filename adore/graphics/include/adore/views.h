@@ -0,0 +1,19 @@
+#pragma once
+
+#include "lua.h"
+#include "lualib.h"
+
+// Userdata handed out for a field of another userdata (rendertexture.texture,
+// font.texture) are created once and cached, keyed by the address of the field.
+// A view keeps its owner alive for as long as the view is reachable.
+namespace views
+{
+
+// Push the cached view for `field`, returns false and pushes nothing if there is none
+bool push(lua_State* L, const void* field);
+
+// Cache the value on top of the stack as the view for `field` of the owner at `ownerIndex`.
+// The view is left on the stack.
+void cache(lua_State* L, int ownerIndex, const void* field);
+
+} // namespace views
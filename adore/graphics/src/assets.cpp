@@ -0,0 +1,425 @@
+#include "adore/assets.h"
+
+#include "adore/font.h"
+#include "adore/metrics.h"
+#include "adore/texture.h"
+#include <filesystem>
+#include <list>
+#include <map>
+#include <unordered_map>
+#include <variant>
+
+namespace assets {
+
+namespace fs = std::filesystem;
+
+using Handle = std::pair<int, uintptr_t>;
+using Resource = std::variant<Texture2D, Font, Image>;
+
+struct Record {
+    std::string id;
+    fs::file_time_type modified;
+    int64_t bytes;
+    Resource resource;
+    // userdata handles on the resource, it is unloaded or retained when the last one goes
+    int refs;
+};
+
+struct Retained {
+    std::string id;
+    resources::Kind kind;
+    fs::file_time_type modified;
+    int64_t bytes;
+    Resource resource;
+};
+
+struct Cache {
+    std::map<Handle, Record> live;
+    std::unordered_map<std::string, Handle> liveById;
+
+    // most recently released first
+    std::list<Retained> retained;
+    std::unordered_map<std::string, std::list<Retained>::iterator> retainedById;
+
+    int64_t retentionBytes = 0;
+    int64_t retainedBytes = 0;
+    int64_t liveBytes = 0;
+
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t revived = 0;
+
+    metrics::Counter& hitCounter = metrics::counter("adore_assets_lookups_total", "Asset cache lookups", metrics::label("result", "hit"));
+    metrics::Counter& revivedCounter = metrics::counter("adore_assets_lookups_total", "Asset cache lookups", metrics::label("result", "revived"));
+    metrics::Counter& missCounter = metrics::counter("adore_assets_lookups_total", "Asset cache lookups", metrics::label("result", "miss"));
+    metrics::Gauge& residentGauge = metrics::gauge("adore_assets_resident_bytes", "Approximate memory held by cached assets, live and retained");
+    metrics::Gauge& retainedGauge = metrics::gauge("adore_assets_retained_bytes", "Approximate memory held by released assets kept for reuse");
+};
+
+static Cache& cache() {
+    static Cache instance;
+    return instance;
+}
+
+static const char* kind_name(resources::Kind kind) {
+    switch (kind) {
+    case resources::Kind::TEXTURE:
+        return "texture";
+    case resources::Kind::IMAGE:
+        return "image";
+    case resources::Kind::FONT:
+        return "font";
+    case resources::Kind::SHADER:
+        return "shader";
+    default:
+        return "rendertexture";
+    }
+}
+
+static fs::file_time_type modified_time(const std::string& path) {
+    std::error_code error;
+    fs::file_time_type time = fs::last_write_time(path, error);
+    return error ? fs::file_time_type::min() : time;
+}
+
+static void update_gauges(Cache& c) {
+    c.residentGauge.set(c.liveBytes + c.retainedBytes);
+    c.retainedGauge.set(c.retainedBytes);
+}
+
+static void unload(const Retained& entry) {
+    if (auto* texture = std::get_if<Texture2D>(&entry.resource)) {
+        resources::defer(*texture);
+    } else if (auto* font = std::get_if<Font>(&entry.resource)) {
+        resources::defer(*font);
+    } else if (auto* image = std::get_if<Image>(&entry.resource)) {
+        resources::untrack(resources::Kind::IMAGE, entry.bytes);
+        UnloadImage(*image);
+    }
+}
+
+static void evict(Cache& c, std::list<Retained>::iterator it) {
+    c.retainedBytes -= it->bytes;
+    c.retainedById.erase(it->id);
+    unload(*it);
+    c.retained.erase(it);
+}
+
+static void trim(Cache& c) {
+    while (!c.retained.empty() && c.retainedBytes > c.retentionBytes) {
+        evict(c, std::prev(c.retained.end()));
+    }
+    update_gauges(c);
+}
+
+static void erase_live(Cache& c, std::map<Handle, Record>::iterator it) {
+    auto byId = c.liveById.find(it->second.id);
+    if (byId != c.liveById.end() && byId->second == it->first) {
+        c.liveById.erase(byId);
+    }
+
+    c.liveBytes -= it->second.bytes;
+    c.live.erase(it);
+}
+
+// Another userdata on a loaded resource, the resource itself is only tracked once
+static void push_handle(lua_State* L, resources::Kind kind, const Resource& resource, int64_t bytes) {
+    if (auto* texture = std::get_if<Texture2D>(&resource)) {
+        texture::create_texture_userdata(L, *texture, true);
+    } else if (auto* font = std::get_if<Font>(&resource)) {
+        font::create_font_userdata(L, *font);
+    }
+    resources::untrack(kind, bytes);
+}
+
+Key key(resources::Kind kind, const char* path, int size, const char* variant) {
+    std::error_code error;
+    fs::path normalized = fs::weakly_canonical(fs::path(path), error);
+    if (error) {
+        normalized = fs::absolute(fs::path(path), error).lexically_normal();
+    }
+
+    std::string id = std::string(kind_name(kind)) + ":" + normalized.string();
+    if (size > 0) {
+        id += "@" + std::to_string(size);
+    }
+    if (variant) {
+        id += "#" + std::string(variant);
+    }
+
+    return Key{kind, id, path};
+}
+
+static Handle handle_of(const Resource& resource) {
+    if (auto* texture = std::get_if<Texture2D>(&resource)) {
+        return { static_cast<int>(resources::Kind::TEXTURE), texture->id };
+    } else if (auto* font = std::get_if<Font>(&resource)) {
+        return { static_cast<int>(resources::Kind::FONT), font->texture.id };
+    }
+    const Image& image = std::get<Image>(resource);
+    return { static_cast<int>(resources::Kind::IMAGE), reinterpret_cast<uintptr_t>(image.data) };
+}
+
+bool push(lua_State* L, const Key& key) {
+    Cache& c = cache();
+    fs::file_time_type modified = modified_time(key.path);
+
+    auto liveIt = c.liveById.find(key.id);
+    if (liveIt != c.liveById.end()) {
+        auto record = c.live.find(liveIt->second);
+        if (record != c.live.end() && record->second.modified == modified) {
+            push_handle(L, key.kind, record->second.resource, record->second.bytes);
+            record->second.refs++;
+            c.hits++;
+            c.hitCounter.add();
+            return true;
+        } else if (record != c.live.end()) {
+            // changed on disk, whoever holds the old one keeps it but new loads get the new file
+            c.liveById.erase(liveIt);
+        }
+    }
+
+    auto retainedIt = c.retainedById.find(key.id);
+    if (retainedIt != c.retainedById.end()) {
+        auto entry = retainedIt->second;
+        if (entry->modified != modified) {
+            evict(c, entry);
+            update_gauges(c);
+        } else {
+            Resource resource = entry->resource;
+            int64_t bytes = entry->bytes;
+            c.retainedBytes -= bytes;
+            c.retainedById.erase(retainedIt);
+            c.retained.erase(entry);
+
+            // the userdata tracks the resource again
+            resources::untrack(key.kind, bytes);
+            if (auto* texture = std::get_if<Texture2D>(&resource)) {
+                texture::create_texture_userdata(L, *texture, true);
+            } else if (auto* font = std::get_if<Font>(&resource)) {
+                font::create_font_userdata(L, *font);
+            }
+
+            store(L, -1, key, handle_of(resource).second);
+
+            c.hits++;
+            c.revived++;
+            c.revivedCounter.add();
+            return true;
+        }
+    }
+
+    c.misses++;
+    c.missCounter.add();
+    return false;
+}
+
+void store(lua_State* L, int index, const Key& key, uintptr_t handle) {
+    Cache& c = cache();
+    index = lua_absindex(L, index);
+
+    // only textures and fonts are shared, images are copied
+    Resource resource;
+    int64_t bytes;
+    if (key.kind == resources::Kind::TEXTURE) {
+        resource = texture::check_texture(L, index)->texture;
+        bytes = resources::texture_bytes(std::get<Texture2D>(resource));
+    } else {
+        resource = *font::check_font(L, index);
+        bytes = resources::font_bytes(std::get<Font>(resource));
+    }
+
+    Handle id = { static_cast<int>(key.kind), handle };
+    auto existing = c.live.find(id);
+    if (existing != c.live.end()) {
+        erase_live(c, existing);
+    }
+
+    c.live[id] = Record{key.id, modified_time(key.path), bytes, resource, 1};
+    c.liveById[key.id] = id;
+    c.liveBytes += bytes;
+    update_gauges(c);
+}
+
+static bool retain_resource(resources::Kind kind, uintptr_t handle, const Resource& resource) {
+    Cache& c = cache();
+
+    auto it = c.live.find({ static_cast<int>(kind), handle });
+    if (it == c.live.end()) {
+        return false;
+    }
+
+    // other handles still draw it
+    if (--it->second.refs > 0) {
+        return true;
+    }
+
+    Record record = it->second;
+    auto byId = c.liveById.find(record.id);
+    bool current = byId != c.liveById.end() && byId->second == it->first;
+    erase_live(c, it);
+
+    // superseded by a newer load of the same file, or retention is off
+    if (!current || c.retentionBytes <= 0 || record.bytes > c.retentionBytes) {
+        update_gauges(c);
+        return false;
+    }
+
+    c.retained.push_front(Retained{record.id, kind, record.modified, record.bytes, resource});
+    c.retainedById[record.id] = c.retained.begin();
+    c.retainedBytes += record.bytes;
+    trim(c);
+
+    return true;
+}
+
+bool retain(resources::Kind kind, uintptr_t handle, const Texture2D& texture) {
+    return retain_resource(kind, handle, texture);
+}
+
+bool retain(resources::Kind kind, uintptr_t handle, const Font& font) {
+    return retain_resource(kind, handle, font);
+}
+
+bool copy(const Key& key, Image& image) {
+    Cache& c = cache();
+
+    auto it = c.retainedById.find(key.id);
+    if (it == c.retainedById.end() || it->second->modified != modified_time(key.path)) {
+        if (it != c.retainedById.end()) {
+            evict(c, it->second);
+            update_gauges(c);
+        }
+        c.misses++;
+        c.missCounter.add();
+        return false;
+    }
+
+    // the entry stays retained, only its copy is handed out
+    c.retained.splice(c.retained.begin(), c.retained, it->second);
+    image = ImageCopy(std::get<Image>(it->second->resource));
+    if (image.data == nullptr) {
+        return false;
+    }
+
+    c.hits++;
+    c.hitCounter.add();
+    return true;
+}
+
+void keep(const Key& key, const Image& image) {
+    Cache& c = cache();
+
+    int64_t bytes = resources::image_bytes(image);
+    if (c.retentionBytes <= 0 || bytes > c.retentionBytes) {
+        return;
+    }
+
+    auto existing = c.retainedById.find(key.id);
+    if (existing != c.retainedById.end()) {
+        evict(c, existing->second);
+    }
+
+    Image pixels = ImageCopy(image);
+    if (pixels.data == nullptr) {
+        update_gauges(c);
+        return;
+    }
+
+    resources::track(resources::Kind::IMAGE, bytes);
+    c.retained.push_front(Retained{key.id, key.kind, modified_time(key.path), bytes, pixels});
+    c.retainedById[key.id] = c.retained.begin();
+    c.retainedBytes += bytes;
+    trim(c);
+}
+
+bool drop(resources::Kind kind, uintptr_t handle) {
+    Cache& c = cache();
+
+    auto it = c.live.find({ static_cast<int>(kind), handle });
+    if (it == c.live.end()) {
+        return false;
+    }
+
+    if (--it->second.refs > 0) {
+        return true;
+    }
+
+    erase_live(c, it);
+    update_gauges(c);
+    return false;
+}
+
+bool shared(resources::Kind kind, uintptr_t handle) {
+    Cache& c = cache();
+
+    auto it = c.live.find({ static_cast<int>(kind), handle });
+    return it != c.live.end() && it->second.refs > 1;
+}
+
+void forget(resources::Kind kind, uintptr_t handle) {
+    Cache& c = cache();
+
+    auto it = c.live.find({ static_cast<int>(kind), handle });
+    if (it != c.live.end()) {
+        erase_live(c, it);
+        update_gauges(c);
+    }
+}
+
+int stats(lua_State* L) {
+    Cache& c = cache();
+
+    lua_createtable(L, 0, 7);
+    lua_pushnumber(L, static_cast<double>(c.hits));
+    lua_setfield(L, -2, "hits");
+    lua_pushnumber(L, static_cast<double>(c.misses));
+    lua_setfield(L, -2, "misses");
+    lua_pushnumber(L, static_cast<double>(c.revived));
+    lua_setfield(L, -2, "revived");
+    lua_pushinteger(L, static_cast<int>(c.live.size()));
+    lua_setfield(L, -2, "live");
+    lua_pushinteger(L, static_cast<int>(c.retained.size()));
+    lua_setfield(L, -2, "retained");
+    lua_pushnumber(L, static_cast<double>(c.liveBytes + c.retainedBytes));
+    lua_setfield(L, -2, "residentbytes");
+    lua_pushnumber(L, static_cast<double>(c.retainedBytes));
+    lua_setfield(L, -2, "retainedbytes");
+
+    return 1;
+}
+
+int setretention(lua_State* L) {
+    double bytes = luaL_checknumber(L, 1);
+    if (bytes < 0) {
+        luaL_error(L, "Retention must not be negative");
+    }
+
+    Cache& c = cache();
+    c.retentionBytes = static_cast<int64_t>(bytes);
+    trim(c);
+
+    return 0;
+}
+
+int flush(lua_State* L) {
+    Cache& c = cache();
+    while (!c.retained.empty()) {
+        evict(c, c.retained.begin());
+    }
+    update_gauges(c);
+
+    return 0;
+}
+
+} // namespace assets
+
+
+int adoreregister_assets(lua_State* L)
+{
+    lua_createtable(L, 0, std::size(assets::lib));
+    luaL_register(L, nullptr, assets::lib); //
+    lua_setreadonly(L, -1, true);
+
+    return 1;
+}
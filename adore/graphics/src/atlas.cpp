@@ -0,0 +1,399 @@
+#include "adore/atlas.h"
+
+#include "adore/core.h"
+#include "adore/window.h"
+#include "adore/image.h"
+#include "adore/texture.h"
+#include "adore/resources.h"
+#include "adore/views.h"
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <numeric>
+#include "raylib.h"
+
+namespace atlas {
+
+constexpr int kDefaultPageSize = 2048;
+constexpr int kDefaultPadding = 2;
+
+// Bottom-left skyline packer, the top edge of the packed area is kept as a list of segments
+class Skyline {
+public:
+    Skyline(int width, int height)
+        : width(width), height(height), nodes{{0, 0, width}}
+    {
+    }
+
+    bool insert(int w, int h, int& outX, int& outY) {
+        int bestIndex = -1;
+        int bestTop = 0;
+        int bestWidth = 0;
+
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            int y;
+            if (!fits(i, w, h, y)) {
+                continue;
+            }
+
+            int top = y + h;
+            if (bestIndex < 0 || top < bestTop || (top == bestTop && nodes[i].width < bestWidth)) {
+                bestIndex = static_cast<int>(i);
+                bestTop = top;
+                bestWidth = nodes[i].width;
+                outX = nodes[i].x;
+                outY = y;
+            }
+        }
+
+        if (bestIndex < 0) {
+            return false;
+        }
+
+        add(bestIndex, outX, outY + h, w);
+        return true;
+    }
+
+private:
+    struct Node {
+        int x;
+        int y;
+        int width;
+    };
+
+    int width;
+    int height;
+    std::vector<Node> nodes;
+
+    bool fits(size_t index, int w, int h, int& y) const {
+        int x = nodes[index].x;
+        if (x + w > width) {
+            return false;
+        }
+
+        y = 0;
+        int remaining = w;
+        for (size_t i = index; remaining > 0; ++i) {
+            if (i >= nodes.size()) {
+                return false;
+            }
+            y = std::max(y, nodes[i].y);
+            if (y + h > height) {
+                return false;
+            }
+            remaining -= nodes[i].width;
+        }
+
+        return true;
+    }
+
+    void add(int index, int x, int y, int w) {
+        nodes.insert(nodes.begin() + index, Node{x, y, w});
+
+        // shrink or drop the segments now covered by the new one
+        for (size_t i = index + 1; i < nodes.size();) {
+            Node& previous = nodes[i - 1];
+            Node& node = nodes[i];
+            int overlap = previous.x + previous.width - node.x;
+            if (overlap <= 0) {
+                break;
+            }
+
+            node.x += overlap;
+            node.width -= overlap;
+            if (node.width > 0) {
+                break;
+            }
+            nodes.erase(nodes.begin() + i);
+        }
+
+        for (size_t i = 0; i + 1 < nodes.size();) {
+            if (nodes[i].y == nodes[i + 1].y) {
+                nodes[i].width += nodes[i + 1].width;
+                nodes.erase(nodes.begin() + i + 1);
+            } else {
+                ++i;
+            }
+        }
+    }
+};
+
+// Copy `source` into `page` at x, y and repeat its edge pixels `bleed` pixels outwards,
+// so filtering at the border of an entry never samples its neighbours
+static void blit(Image& page, const Image& source, int x, int y, int bleed) {
+    const unsigned char* src = static_cast<const unsigned char*>(source.data);
+    unsigned char* dst = static_cast<unsigned char*>(page.data);
+
+    for (int dy = -bleed; dy < source.height + bleed; ++dy) {
+        int sy = std::clamp(dy, 0, source.height - 1);
+        int py = y + dy;
+        if (py < 0 || py >= page.height) {
+            continue;
+        }
+
+        for (int dx = -bleed; dx < source.width + bleed; ++dx) {
+            int sx = std::clamp(dx, 0, source.width - 1);
+            int px = x + dx;
+            if (px < 0 || px >= page.width) {
+                continue;
+            }
+
+            memcpy(dst + (static_cast<size_t>(py) * page.width + px) * 4, src + (static_cast<size_t>(sy) * source.width + sx) * 4, 4);
+        }
+    }
+}
+
+// Images unloaded when pack returns, or when it raises an error halfway through
+struct ImageList {
+    std::vector<Image> images;
+
+    ~ImageList() {
+        for (Image& image : images) {
+            UnloadImage(image);
+        }
+    }
+};
+
+static Image load_source(lua_State* L, int tableIndex, int i) {
+    lua_rawgeti(L, tableIndex, i);
+
+    Image image;
+    if (lua_type(L, -1) == LUA_TSTRING) {
+        const char* path = lua_tostring(L, -1);
+        image = LoadImage(path);
+        if (image.data == nullptr) {
+            luaL_error(L, "Failed to load atlas image: %s", path);
+        }
+    } else {
+        image = ImageCopy(*image::check_image(L, -1));
+    }
+    lua_pop(L, 1);
+
+    ImageFormat(&image, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+    return image;
+}
+
+static int opt_field(lua_State* L, int index, const char* name, int fallback) {
+    if (lua_isnoneornil(L, index)) {
+        return fallback;
+    }
+
+    lua_getfield(L, index, name);
+    int value = lua_isnil(L, -1) ? fallback : luaL_checkinteger(L, -1);
+    lua_pop(L, 1);
+    return value;
+}
+
+static bool opt_boolean_field(lua_State* L, int index, const char* name, bool fallback) {
+    if (lua_isnoneornil(L, index)) {
+        return fallback;
+    }
+
+    lua_getfield(L, index, name);
+    bool value = lua_isnil(L, -1) ? fallback : lua_toboolean(L, -1);
+    lua_pop(L, 1);
+    return value;
+}
+
+int pack(lua_State* L) {
+    WINDOW_NOT_INITIALIZED_CHECK();
+
+    luaL_checktype(L, 1, LUA_TTABLE);
+    if (!lua_isnoneornil(L, 2)) {
+        luaL_checktype(L, 2, LUA_TTABLE);
+    }
+
+    int pageSize = opt_field(L, 2, "size", kDefaultPageSize);
+    int padding = opt_field(L, 2, "padding", kDefaultPadding);
+    bool bleed = opt_boolean_field(L, 2, "bleed", true);
+    if (pageSize <= 0 || padding < 0) {
+        luaL_error(L, "Invalid atlas size or padding");
+    }
+
+    int count = lua_objlen(L, 1);
+
+    ImageList sources;
+    std::vector<Image>& images = sources.images;
+    images.reserve(count);
+    for (int i = 1; i <= count; ++i) {
+        images.push_back(load_source(L, 1, i));
+
+        const Image& image = images.back();
+        if (image.width + 2 * padding > pageSize || image.height + 2 * padding > pageSize) {
+            luaL_error(L, "Image %d (%dx%d) does not fit in a %d atlas page", i, image.width, image.height, pageSize);
+        }
+    }
+
+    // tallest first packs a skyline much tighter
+    std::vector<int> order(count);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&images](int a, int b) {
+        return images[a].height > images[b].height;
+    });
+
+    void* ud = lua_newuserdatatagged(L, sizeof(Atlas), kAtlasUserdataTag);
+    Atlas* atlas = new (ud) Atlas();
+    lua_getuserdatametatable(L, kAtlasUserdataTag);
+    lua_setmetatable(L, -2);
+
+    atlas->entries.resize(count);
+
+    std::vector<Skyline> skylines;
+    ImageList pages;
+    std::vector<Image>& pageImages = pages.images;
+    for (int i : order) {
+        const Image& image = images[i];
+        int w = image.width + 2 * padding;
+        int h = image.height + 2 * padding;
+
+        int x = 0;
+        int y = 0;
+        int pageIndex = -1;
+        for (size_t p = 0; p < skylines.size(); ++p) {
+            if (skylines[p].insert(w, h, x, y)) {
+                pageIndex = static_cast<int>(p);
+                break;
+            }
+        }
+
+        if (pageIndex < 0) {
+            skylines.emplace_back(pageSize, pageSize);
+            pageImages.push_back(GenImageColor(pageSize, pageSize, BLANK));
+            pageIndex = static_cast<int>(skylines.size()) - 1;
+            skylines.back().insert(w, h, x, y);
+        }
+
+        blit(pageImages[pageIndex], image, x + padding, y + padding, bleed ? padding : 0);
+        atlas->entries[i] = Entry{
+            pageIndex,
+            { static_cast<float>(x + padding), static_cast<float>(y + padding), static_cast<float>(image.width), static_cast<float>(image.height) },
+        };
+    }
+
+    for (Image& pageImage : pageImages) {
+        Texture2D texture = LoadTextureFromImage(pageImage);
+        resources::track(resources::Kind::TEXTURE, resources::texture_bytes(texture));
+        atlas->pages.push_back(texture);
+    }
+
+    return 1;
+}
+
+Atlas* check_atlas(lua_State* L, int index) {
+    void* ud = lua_touserdatatagged(L, index, kAtlasUserdataTag);
+    if (!ud) {
+        luaL_typeerror(L, index, "Atlas");
+    }
+    return static_cast<Atlas*>(ud);
+}
+
+int index(lua_State* L) {
+    const char* key = luaL_checkstring(L, 2);
+
+    for (auto& [name, func] : udata) {
+        if (name && strcmp(name, key) == 0) {
+            lua_pushcfunction(L, func, name);
+            return 1;
+        }
+    }
+
+    Atlas* atlas = check_atlas(L, 1);
+
+    if (strcmp(key, "count") == 0) {
+        lua_pushinteger(L, static_cast<int>(atlas->entries.size()));
+        return 1;
+    } else if (strcmp(key, "pages") == 0) {
+        lua_pushinteger(L, static_cast<int>(atlas->pages.size()));
+        return 1;
+    }
+
+    luaL_error(L, "Attempt to access invalid Atlas property: %s", key);
+    return 0;
+}
+
+int get(lua_State* L) {
+    Atlas* atlas = check_atlas(L, 1);
+    int i = luaL_checkinteger(L, 2);
+    if (i < 1 || i > static_cast<int>(atlas->entries.size())) {
+        luaL_error(L, "Atlas entry %d out of range", i);
+    }
+
+    const Entry& entry = atlas->entries[i - 1];
+    if (atlas->pages.empty()) {
+        luaL_error(L, "Atlas has been released");
+    }
+
+    if (views::push(L, &entry)) {
+        return 1;
+    }
+
+    texture::create_texture_region_userdata(L, atlas->pages[entry.page], entry.region);
+    views::cache(L, 1, &entry);
+    return 1;
+}
+
+int page(lua_State* L) {
+    Atlas* atlas = check_atlas(L, 1);
+    int i = luaL_checkinteger(L, 2);
+    if (i < 1 || i > static_cast<int>(atlas->pages.size())) {
+        luaL_error(L, "Atlas page %d out of range", i);
+    }
+
+    return texture::push_texture_view(L, 1, atlas->pages[i - 1]);
+}
+
+int release(lua_State* L) {
+    Atlas* atlas = check_atlas(L, 1);
+
+    for (const Entry& entry : atlas->entries) {
+        if (views::push(L, &entry)) {
+            texture::TextureRef* textureRef = static_cast<texture::TextureRef*>(lua_touserdatatagged(L, -1, kTextureUserdataTag));
+            if (textureRef) {
+                textureRef->texture.id = 0;
+            }
+            lua_pop(L, 1);
+        }
+    }
+
+    for (const Texture2D& texture : atlas->pages) {
+        texture::invalidate_texture_view(L, texture);
+        resources::defer(texture);
+    }
+    atlas->pages.clear();
+
+    return 0;
+}
+
+} // namespace atlas
+
+
+int adoreregister_atlas(lua_State* L)
+{
+    luaL_newmetatable(L, "Atlas");
+    lua_pushvalue(L, -1);
+    lua_setuserdatametatable(L, kAtlasUserdataTag);
+
+    lua_pushcfunction(L, atlas::index, nullptr);
+    lua_setfield(L, -2, "__index");
+
+    lua_setreadonly(L, -1, true);
+
+    lua_setuserdatadtor(L, kAtlasUserdataTag,
+        [](lua_State* L, void* ud)
+        {
+            atlas::Atlas* atlas = static_cast<atlas::Atlas*>(ud);
+            for (const Texture2D& texture : atlas->pages) {
+                resources::defer(texture);
+            }
+            atlas->~Atlas();
+        }
+    );
+
+    lua_pop(L, 1);
+
+    lua_createtable(L, 0, std::size(atlas::lib));
+    luaL_register(L, nullptr, atlas::lib); //
+    lua_setreadonly(L, -1, true);
+
+    return 1;
+}
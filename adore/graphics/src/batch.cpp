@@ -0,0 +1,182 @@
+#include "adore/batch.h"
+
+#include "adore/core.h"
+#include "adore/window.h"
+#include "adore/texture.h"
+#include "adore/drawlist.h"
+#include "adore/software.h"
+#include <cmath>
+#include <cstring>
+#include "raylib.h"
+#include "rlgl.h"
+
+namespace batch {
+
+// 16k quads keeps us within 16 bit indices on GLES2, two buffers so we don't
+// wait on the upload of the previous flush
+constexpr int kBatchQuads = 16384;
+constexpr int kBatchBuffers = 2;
+
+static rlRenderBatch spriteBatch;
+static bool spriteBatchLoaded = false;
+
+struct Instance {
+    float x, y;
+    float sx, sy, sw, sh;
+    float scalex, scaley;
+    float originx, originy;
+    float rotation;
+    unsigned char r, g, b, a;
+};
+
+static_assert(sizeof(Instance) == kInstanceSize, "Sprite instance layout must be 48 bytes");
+
+static inline void emit(const Texture2D& texture, const Rectangle& region, const Instance& instance) {
+    float texWidth = static_cast<float>(texture.width);
+    float texHeight = static_cast<float>(texture.height);
+
+    // source rectangles are relative to the region of atlas sub-textures
+    float sx = instance.sx + region.x;
+    float sy = instance.sy + region.y;
+    float sw = instance.sw;
+    float sh = instance.sh;
+
+    bool flipX = false;
+    if (sw < 0) {
+        flipX = true;
+        sw = -sw;
+    }
+    if (sh < 0) {
+        sy -= sh;
+    }
+
+    float width = sw * instance.scalex;
+    float height = std::fabs(sh) * instance.scaley;
+
+    Vector2 topLeft, topRight, bottomLeft, bottomRight;
+    if (instance.rotation == 0.0f) {
+        float x = instance.x - instance.originx;
+        float y = instance.y - instance.originy;
+        topLeft = { x, y };
+        topRight = { x + width, y };
+        bottomLeft = { x, y + height };
+        bottomRight = { x + width, y + height };
+    } else {
+        float radians = instance.rotation * DEG2RAD;
+        float sinRotation = sinf(radians);
+        float cosRotation = cosf(radians);
+        float dx = -instance.originx;
+        float dy = -instance.originy;
+
+        topLeft.x = instance.x + dx * cosRotation - dy * sinRotation;
+        topLeft.y = instance.y + dx * sinRotation + dy * cosRotation;
+        topRight.x = instance.x + (dx + width) * cosRotation - dy * sinRotation;
+        topRight.y = instance.y + (dx + width) * sinRotation + dy * cosRotation;
+        bottomLeft.x = instance.x + dx * cosRotation - (dy + height) * sinRotation;
+        bottomLeft.y = instance.y + dx * sinRotation + (dy + height) * cosRotation;
+        bottomRight.x = instance.x + (dx + width) * cosRotation - (dy + height) * sinRotation;
+        bottomRight.y = instance.y + (dx + width) * sinRotation + (dy + height) * cosRotation;
+    }
+
+    float u0 = sx / texWidth;
+    float u1 = (sx + sw) / texWidth;
+    float v0 = sy / texHeight;
+    float v1 = (sy + sh) / texHeight;
+    if (flipX) {
+        float swap = u0;
+        u0 = u1;
+        u1 = swap;
+    }
+
+    // flushes the batch when it is full and restores our texture
+    rlCheckRenderBatchLimit(4);
+
+    rlColor4ub(instance.r, instance.g, instance.b, instance.a);
+
+    rlTexCoord2f(u0, v0);
+    rlVertex2f(topLeft.x, topLeft.y);
+    rlTexCoord2f(u0, v1);
+    rlVertex2f(bottomLeft.x, bottomLeft.y);
+    rlTexCoord2f(u1, v1);
+    rlVertex2f(bottomRight.x, bottomRight.y);
+    rlTexCoord2f(u1, v0);
+    rlVertex2f(topRight.x, topRight.y);
+}
+
+int draw(lua_State* L) {
+    WINDOW_NOT_INITIALIZED_CHECK();
+
+    texture::TextureRef* textureRef = texture::check_texture(L, 1);
+
+    if (drawlist::recording()) {
+        luaL_error(L, "graphics.batch cannot be recorded, the buffer is already a replayable list");
+    }
+    SOFTWARE_UNSUPPORTED_CHECK("graphics.batch");
+
+    size_t length;
+    const char* data = static_cast<const char*>(luaL_checkbuffer(L, 2, &length));
+
+    int stride = luaL_optinteger(L, 4, static_cast<int>(kInstanceSize));
+    int offset = luaL_optinteger(L, 5, 0);
+    if (stride < static_cast<int>(kInstanceSize)) {
+        luaL_error(L, "Stride must be at least %d bytes", static_cast<int>(kInstanceSize));
+    }
+    if (offset < 0 || static_cast<size_t>(offset) > length) {
+        luaL_error(L, "Offset %d is outside the buffer", offset);
+    }
+
+    size_t available = length - offset < kInstanceSize ? 0 : (length - offset - kInstanceSize) / stride + 1;
+    int count = luaL_optinteger(L, 3, static_cast<int>(available));
+    if (count < 0 || static_cast<size_t>(count) > available) {
+        luaL_error(L, "Buffer holds %d instances, %d requested", static_cast<int>(available), count);
+    }
+
+    if (count == 0) {
+        return 0;
+    }
+
+    begin(textureRef->texture.id);
+
+    const char* cursor = data + offset;
+    for (int i = 0; i < count; ++i, cursor += stride) {
+        // the buffer has no alignment guarantees
+        Instance instance;
+        memcpy(&instance, cursor, sizeof(Instance));
+        emit(textureRef->texture, textureRef->region, instance);
+    }
+
+    end();
+
+    return 0;
+}
+
+void begin(unsigned int texture) {
+    if (!spriteBatchLoaded) {
+        spriteBatch = rlLoadRenderBatch(kBatchBuffers, kBatchQuads);
+        spriteBatchLoaded = true;
+    }
+
+    // draws whatever the default batch holds so ordering is kept
+    rlSetRenderBatchActive(&spriteBatch);
+
+    rlSetTexture(texture);
+    rlBegin(RL_QUADS);
+    rlNormal3f(0.0f, 0.0f, 1.0f);
+}
+
+void end() {
+    rlEnd();
+    rlSetTexture(0);
+
+    // flushes our batch and goes back to the default one
+    rlSetRenderBatchActive(nullptr);
+}
+
+void shutdown() {
+    if (spriteBatchLoaded) {
+        rlUnloadRenderBatch(spriteBatch);
+        spriteBatchLoaded = false;
+    }
+}
+
+} // namespace batch
@@ -0,0 +1,242 @@
+#include "adore/convolve.h"
+
+#include "adore/jobs.h"
+#include "adore/pixels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace convolve {
+
+// pixels per column strip, 16 floats wide rows of 4 channels fill a cache line each
+constexpr int kStrip = 16;
+
+// rows or strips per band
+constexpr size_t kGrain = 16;
+
+constexpr int kBoxPasses = 3;
+
+// One pixel, four channels. SSE2 is part of x86-64, other targets get plain floats.
+#if ADORE_PIXELS_X86
+using Vec = __m128;
+
+static inline Vec load(const float* p) { return _mm_loadu_ps(p); }
+static inline void store(float* p, Vec v) { _mm_storeu_ps(p, v); }
+static inline Vec splat(float value) { return _mm_set1_ps(value); }
+static inline Vec add(Vec a, Vec b) { return _mm_add_ps(a, b); }
+static inline Vec sub(Vec a, Vec b) { return _mm_sub_ps(a, b); }
+static inline Vec mul(Vec a, Vec b) { return _mm_mul_ps(a, b); }
+
+static inline Vec load_bytes(const unsigned char* p) {
+    int32_t bytes;
+    memcpy(&bytes, p, sizeof(bytes));
+    const __m128i zero = _mm_setzero_si128();
+    return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero));
+}
+
+// rounds to nearest and saturates
+static inline void store_bytes(unsigned char* p, Vec v) {
+    __m128i values = _mm_cvtps_epi32(v);
+    values = _mm_packus_epi16(_mm_packs_epi32(values, values), values);
+    int32_t bytes = _mm_cvtsi128_si32(values);
+    memcpy(p, &bytes, sizeof(bytes));
+}
+#else
+struct Vec {
+    float v[4];
+};
+
+static inline Vec load(const float* p) { return Vec{ { p[0], p[1], p[2], p[3] } }; }
+static inline void store(float* p, Vec a) { memcpy(p, a.v, sizeof(a.v)); }
+static inline Vec splat(float value) { return Vec{ { value, value, value, value } }; }
+static inline Vec add(Vec a, Vec b) { return Vec{ { a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3] } }; }
+static inline Vec sub(Vec a, Vec b) { return Vec{ { a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3] } }; }
+static inline Vec mul(Vec a, Vec b) { return Vec{ { a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3] } }; }
+
+static inline Vec load_bytes(const unsigned char* p) {
+    return Vec{ { static_cast<float>(p[0]), static_cast<float>(p[1]), static_cast<float>(p[2]), static_cast<float>(p[3]) } };
+}
+
+static inline void store_bytes(unsigned char* p, Vec a) {
+    for (int i = 0; i < 4; ++i) {
+        p[i] = static_cast<unsigned char>(std::clamp(std::nearbyint(a.v[i]), 0.0f, 255.0f));
+    }
+}
+#endif
+
+// Copy `count` pixels starting at `index` into floats and back. 8-bit pixels are
+// filtered on the 0-255 scale, so box sums stay exact integers.
+static void read_pixels(const Surface& s, size_t index, int count, float* out) {
+    if (s.isFloat) {
+        memcpy(out, static_cast<const float*>(s.data) + index * 4, sizeof(float) * 4 * count);
+        return;
+    }
+
+    const unsigned char* source = static_cast<const unsigned char*>(s.data) + index * 4;
+    for (int i = 0; i < count; ++i) {
+        store(out + i * 4, load_bytes(source + i * 4));
+    }
+}
+
+static void write_pixels(const Surface& s, size_t index, int count, const float* in) {
+    if (s.isFloat) {
+        memcpy(static_cast<float*>(s.data) + index * 4, in, sizeof(float) * 4 * count);
+        return;
+    }
+
+    unsigned char* destination = static_cast<unsigned char*>(s.data) + index * 4;
+    for (int i = 0; i < count; ++i) {
+        store_bytes(destination + i * 4, load(in + i * 4));
+    }
+}
+
+// A line of `n` elements, each `lanes` pixels side by side: one pixel for a row,
+// a strip of pixels for a column band. Filters read `in` and write `out`.
+
+static void box_pass(const float* in, float* out, int n, int lanes, int radius) {
+    size_t stride = static_cast<size_t>(lanes) * 4;
+    Vec scale = splat(1.0f / (2 * radius + 1));
+
+    Vec sums[kStrip];
+    for (int l = 0; l < lanes; ++l) {
+        sums[l] = mul(load(in + l * 4), splat(static_cast<float>(radius + 1)));
+    }
+    for (int i = 1; i <= radius; ++i) {
+        const float* element = in + std::min(i, n - 1) * stride;
+        for (int l = 0; l < lanes; ++l) {
+            sums[l] = add(sums[l], load(element + l * 4));
+        }
+    }
+
+    // a running sum, one pixel enters and one leaves per step
+    for (int i = 0; i < n; ++i) {
+        float* target = out + i * stride;
+        const float* entering = in + std::min(i + radius + 1, n - 1) * stride;
+        const float* leaving = in + std::max(i - radius, 0) * stride;
+        for (int l = 0; l < lanes; ++l) {
+            store(target + l * 4, mul(sums[l], scale));
+            sums[l] = add(sub(sums[l], load(leaving + l * 4)), load(entering + l * 4));
+        }
+    }
+}
+
+static void kernel_pass(const float* in, float* out, int n, int lanes, const float* kernel, int size) {
+    size_t stride = static_cast<size_t>(lanes) * 4;
+    int radius = size / 2;
+
+    for (int i = 0; i < n; ++i) {
+        Vec sums[kStrip];
+        for (int l = 0; l < lanes; ++l) {
+            sums[l] = splat(0.0f);
+        }
+
+        for (int tap = 0; tap < size; ++tap) {
+            const float* element = in + std::clamp(i + tap - radius, 0, n - 1) * stride;
+            Vec weight = splat(kernel[tap]);
+            for (int l = 0; l < lanes; ++l) {
+                sums[l] = add(sums[l], mul(load(element + l * 4), weight));
+            }
+        }
+
+        for (int l = 0; l < lanes; ++l) {
+            store(out + i * stride + l * 4, sums[l]);
+        }
+    }
+}
+
+// Runs `filter(in, out, n, lanes)` over every row and then every column strip,
+// as many times as it likes by swapping the buffers it is given
+template <typename Filter>
+static void filter_rows(const Surface& s, Filter filter) {
+    jobs::parallel_for(s.height, kGrain, [&](size_t begin, size_t end) {
+        std::vector<float> line(static_cast<size_t>(s.width) * 4);
+        std::vector<float> scratch(line.size());
+
+        for (size_t y = begin; y < end; ++y) {
+            read_pixels(s, y * s.width, s.width, line.data());
+            const float* result = filter(line.data(), scratch.data(), s.width, 1);
+            write_pixels(s, y * s.width, s.width, result);
+        }
+    });
+}
+
+template <typename Filter>
+static void filter_columns(const Surface& s, Filter filter) {
+    size_t strips = (s.width + kStrip - 1) / kStrip;
+
+    jobs::parallel_for(strips, 1, [&](size_t begin, size_t end) {
+        std::vector<float> strip(static_cast<size_t>(s.height) * kStrip * 4);
+        std::vector<float> scratch(strip.size());
+
+        for (size_t index = begin; index < end; ++index) {
+            int left = static_cast<int>(index) * kStrip;
+            int lanes = std::min(kStrip, s.width - left);
+            size_t stride = static_cast<size_t>(lanes) * 4;
+
+            for (int y = 0; y < s.height; ++y) {
+                read_pixels(s, static_cast<size_t>(y) * s.width + left, lanes, strip.data() + y * stride);
+            }
+
+            const float* result = filter(strip.data(), scratch.data(), s.height, lanes);
+
+            for (int y = 0; y < s.height; ++y) {
+                write_pixels(s, static_cast<size_t>(y) * s.width + left, lanes, result + y * stride);
+            }
+        }
+    });
+}
+
+// Box widths whose repeated application best matches a Gaussian of this sigma
+static void box_radii(float sigma, int radii[kBoxPasses]) {
+    double ideal = std::sqrt(12.0 * sigma * sigma / kBoxPasses + 1.0);
+    int lower = static_cast<int>(std::floor(ideal));
+    if (lower % 2 == 0) {
+        lower--;
+    }
+    int upper = lower + 2;
+
+    double idealCount = (12.0 * sigma * sigma - kBoxPasses * lower * lower - 4.0 * kBoxPasses * lower - 3.0 * kBoxPasses) / (-4.0 * lower - 4.0);
+    int lowerCount = static_cast<int>(std::lround(idealCount));
+
+    for (int i = 0; i < kBoxPasses; ++i) {
+        int width = i < lowerCount ? lower : upper;
+        radii[i] = std::max((width - 1) / 2, 0);
+    }
+}
+
+void blur(const Surface& surface, float sigma) {
+    int radii[kBoxPasses];
+    box_radii(sigma, radii);
+
+    auto boxes = [&radii](float* line, float* scratch, int n, int lanes) -> const float* {
+        float* in = line;
+        float* out = scratch;
+        for (int radius : radii) {
+            if (radius == 0) {
+                continue;
+            }
+            box_pass(in, out, n, lanes, radius);
+            std::swap(in, out);
+        }
+        return in;
+    };
+
+    filter_rows(surface, boxes);
+    filter_columns(surface, boxes);
+}
+
+void separable(const Surface& surface, const float* horizontal, int horizontalSize, const float* vertical, int verticalSize) {
+    filter_rows(surface, [horizontal, horizontalSize](float* line, float* scratch, int n, int lanes) -> const float* {
+        kernel_pass(line, scratch, n, lanes, horizontal, horizontalSize);
+        return scratch;
+    });
+
+    filter_columns(surface, [vertical, verticalSize](float* line, float* scratch, int n, int lanes) -> const float* {
+        kernel_pass(line, scratch, n, lanes, vertical, verticalSize);
+        return scratch;
+    });
+}
+
+} // namespace convolve
@@ -0,0 +1,453 @@
+#include "adore/drawlist.h"
+
+#include "adore/core.h"
+#include "adore/window.h"
+#include "adore/colors.h"
+#include "adore/software.h"
+#include <cmath>
+#include <new>
+#include "raylib.h"
+#include "rlgl.h"
+
+namespace drawlist {
+
+// list -> table of the textures and fonts it draws, weak so the list can be collected
+static const char* kAnchorsRegistryKey = "adore.graphics.drawlistanchors";
+
+// raylib's default spacing between lines of text
+constexpr float kTextLineSpacing = 2.0f;
+constexpr int kCircleSegments = 36;
+
+static DrawList* current = nullptr;
+
+static Color multiply(Color color, Color tint) {
+    return Color{
+        static_cast<unsigned char>(color.r * tint.r / 255),
+        static_cast<unsigned char>(color.g * tint.g / 255),
+        static_cast<unsigned char>(color.b * tint.b / 255),
+        static_cast<unsigned char>(color.a * tint.a / 255),
+    };
+}
+
+// The texture was released, or the render target it belonged to went back to the pool
+static bool released(const Span& span) {
+    return span.owner && *span.owner == 0;
+}
+
+// What the handle holds now, it may have taken a private copy of a shared texture since
+static unsigned int texture_of(const Span& span) {
+    return span.owner ? *span.owner : span.texture;
+}
+
+static int vertices_per_primitive(int mode) {
+    switch (mode) {
+    case RL_LINES:
+        return 2;
+    case RL_TRIANGLES:
+        return 3;
+    default:
+        return 4;
+    }
+}
+
+void DrawList::begin(unsigned int texture, int mode, const unsigned int* owner) {
+    if (!spans.empty() && spans.back().texture == texture && spans.back().mode == mode && spans.back().owner == owner) {
+        return;
+    }
+
+    spans.push_back(Span{texture, mode, vertices.size(), 0, owner});
+}
+
+void DrawList::vertex(float x, float y, float u, float v, Color color) {
+    vertices.push_back(Vertex{x, y, u, v, color});
+    spans.back().count++;
+}
+
+void DrawList::clear(Color color) {
+    spans.push_back(Span{0, kClear, vertices.size(), 0, nullptr});
+    vertex(0.0f, 0.0f, 0.0f, 0.0f, color);
+}
+
+void DrawList::rectangle(Rectangle rect, Color color) {
+    begin(rlGetTextureIdDefault(), RL_QUADS);
+    vertex(rect.x, rect.y, 0.0f, 0.0f, color);
+    vertex(rect.x, rect.y + rect.height, 0.0f, 1.0f, color);
+    vertex(rect.x + rect.width, rect.y + rect.height, 1.0f, 1.0f, color);
+    vertex(rect.x + rect.width, rect.y, 1.0f, 0.0f, color);
+}
+
+void DrawList::rectangle_lines(Rectangle rect, Color color) {
+    // same offsets as DrawRectangleLines so recorded and direct outlines line up
+    float x = rect.x;
+    float y = rect.y;
+    float w = rect.width;
+    float h = rect.height;
+
+    begin(rlGetTextureIdDefault(), RL_LINES);
+    vertex(x, y, 0.0f, 0.0f, color);
+    vertex(x + w, y + 1, 0.0f, 0.0f, color);
+    vertex(x + w, y + 1, 0.0f, 0.0f, color);
+    vertex(x + w, y + h, 0.0f, 0.0f, color);
+    vertex(x + w, y + h, 0.0f, 0.0f, color);
+    vertex(x + 1, y + h, 0.0f, 0.0f, color);
+    vertex(x + 1, y + h, 0.0f, 0.0f, color);
+    vertex(x + 1, y + 1, 0.0f, 0.0f, color);
+}
+
+void DrawList::circle(Vector2 center, float radius, Color color) {
+    float step = 360.0f / kCircleSegments;
+
+    begin(rlGetTextureIdDefault(), RL_TRIANGLES);
+    for (int i = 0; i < kCircleSegments; ++i) {
+        float angle = i * step;
+        vertex(center.x, center.y, 0.0f, 0.0f, color);
+        vertex(center.x + cosf(DEG2RAD * (angle + step)) * radius, center.y + sinf(DEG2RAD * (angle + step)) * radius, 0.0f, 0.0f, color);
+        vertex(center.x + cosf(DEG2RAD * angle) * radius, center.y + sinf(DEG2RAD * angle) * radius, 0.0f, 0.0f, color);
+    }
+}
+
+void DrawList::circle_lines(Vector2 center, float radius, Color color) {
+    begin(rlGetTextureIdDefault(), RL_LINES);
+    for (int i = 0; i < 360; i += 10) {
+        vertex(center.x + cosf(DEG2RAD * i) * radius, center.y + sinf(DEG2RAD * i) * radius, 0.0f, 0.0f, color);
+        vertex(center.x + cosf(DEG2RAD * (i + 10)) * radius, center.y + sinf(DEG2RAD * (i + 10)) * radius, 0.0f, 0.0f, color);
+    }
+}
+
+// Mirrors DrawTexturePro
+void DrawList::texture(const Texture2D& texture, Rectangle source, Rectangle dest, Vector2 origin, float rotation, Color tint, const unsigned int* owner) {
+    if (texture.id == 0) {
+        return;
+    }
+
+    float width = static_cast<float>(texture.width);
+    float height = static_cast<float>(texture.height);
+
+    bool flipX = false;
+    if (source.width < 0) {
+        flipX = true;
+        source.width *= -1;
+    }
+    if (source.height < 0) {
+        source.y -= source.height;
+    }
+    if (dest.width < 0) {
+        dest.width *= -1;
+    }
+    if (dest.height < 0) {
+        dest.height *= -1;
+    }
+
+    Vector2 topLeft, topRight, bottomLeft, bottomRight;
+    if (rotation == 0.0f) {
+        float x = dest.x - origin.x;
+        float y = dest.y - origin.y;
+        topLeft = { x, y };
+        topRight = { x + dest.width, y };
+        bottomLeft = { x, y + dest.height };
+        bottomRight = { x + dest.width, y + dest.height };
+    } else {
+        float sinRotation = sinf(rotation * DEG2RAD);
+        float cosRotation = cosf(rotation * DEG2RAD);
+        float x = dest.x;
+        float y = dest.y;
+        float dx = -origin.x;
+        float dy = -origin.y;
+
+        topLeft.x = x + dx * cosRotation - dy * sinRotation;
+        topLeft.y = y + dx * sinRotation + dy * cosRotation;
+        topRight.x = x + (dx + dest.width) * cosRotation - dy * sinRotation;
+        topRight.y = y + (dx + dest.width) * sinRotation + dy * cosRotation;
+        bottomLeft.x = x + dx * cosRotation - (dy + dest.height) * sinRotation;
+        bottomLeft.y = y + dx * sinRotation + (dy + dest.height) * cosRotation;
+        bottomRight.x = x + (dx + dest.width) * cosRotation - (dy + dest.height) * sinRotation;
+        bottomRight.y = y + (dx + dest.width) * sinRotation + (dy + dest.height) * cosRotation;
+    }
+
+    float u0 = source.x / width;
+    float u1 = (source.x + source.width) / width;
+    float v0 = source.y / height;
+    float v1 = (source.y + source.height) / height;
+    if (flipX) {
+        float swap = u0;
+        u0 = u1;
+        u1 = swap;
+    }
+
+    begin(texture.id, RL_QUADS, owner);
+    vertex(topLeft.x, topLeft.y, u0, v0, tint);
+    vertex(bottomLeft.x, bottomLeft.y, u0, v1, tint);
+    vertex(bottomRight.x, bottomRight.y, u1, v1, tint);
+    vertex(topRight.x, topRight.y, u1, v0, tint);
+}
+
+// Mirrors DrawTextEx, one quad per visible glyph
+void DrawList::text(const Font& font, const char* text, Vector2 position, float fontSize, float spacing, Color tint) {
+    // GetFontDefault returns a copy, which has no id of its own to watch
+    const Font* source = &font;
+    Font fallback = {};
+    if (font.texture.id == 0) {
+        fallback = GetFontDefault();
+        source = &fallback;
+    }
+    if (source->texture.id == 0 || source->baseSize == 0) {
+        return;
+    }
+    const unsigned int* owner = source == &font ? &font.texture.id : nullptr;
+
+    float scale = fontSize / source->baseSize;
+    float padding = static_cast<float>(source->glyphPadding);
+    float offsetX = 0.0f;
+    float offsetY = 0.0f;
+
+    for (const char* cursor = text; *cursor;) {
+        int length = 0;
+        int codepoint = GetCodepointNext(cursor, &length);
+        int glyph = GetGlyphIndex(*source, codepoint);
+        cursor += length > 0 ? length : 1;
+
+        if (codepoint == '\n') {
+            offsetY += fontSize + kTextLineSpacing;
+            offsetX = 0.0f;
+            continue;
+        }
+
+        const Rectangle& rec = source->recs[glyph];
+        const GlyphInfo& info = source->glyphs[glyph];
+
+        if (codepoint != ' ' && codepoint != '\t') {
+            Rectangle src = { rec.x - padding, rec.y - padding, rec.width + 2.0f * padding, rec.height + 2.0f * padding };
+            Rectangle dst = {
+                position.x + offsetX + info.offsetX * scale - padding * scale,
+                position.y + offsetY + info.offsetY * scale - padding * scale,
+                src.width * scale,
+                src.height * scale,
+            };
+            texture(source->texture, src, dst, { 0.0f, 0.0f }, 0.0f, tint, owner);
+        }
+
+        offsetX += (info.advanceX == 0 ? rec.width : info.advanceX) * scale + spacing;
+    }
+}
+
+DrawList* recording() {
+    return current;
+}
+
+DrawList* capture() {
+    return current ? current : software::commands();
+}
+
+void anchor(lua_State* L, int index) {
+    if (!current) {
+        return;
+    }
+
+    index = lua_absindex(L, index);
+    lua_getref(L, current->anchorsRef);
+    lua_pushvalue(L, index);
+    lua_pushboolean(L, true);
+    lua_rawset(L, -3);
+    lua_pop(L, 1);
+}
+
+static void push_anchors_table(lua_State* L) {
+    lua_getfield(L, LUA_REGISTRYINDEX, kAnchorsRegistryKey);
+    if (lua_istable(L, -1)) {
+        return;
+    }
+    lua_pop(L, 1);
+
+    lua_newtable(L);
+    lua_createtable(L, 0, 1);
+    lua_pushstring(L, "k");
+    lua_setfield(L, -2, "__mode");
+    lua_setmetatable(L, -2);
+
+    lua_pushvalue(L, -1);
+    lua_setfield(L, LUA_REGISTRYINDEX, kAnchorsRegistryKey);
+}
+
+int record(lua_State* L) {
+    luaL_checktype(L, 1, LUA_TFUNCTION);
+
+    void* ud = lua_newuserdatatagged(L, sizeof(DrawList), kDrawListUserdataTag);
+    DrawList* list = new (ud) DrawList();
+    lua_getuserdatametatable(L, kDrawListUserdataTag);
+    lua_setmetatable(L, -2);
+    int listIndex = lua_gettop(L);
+
+    lua_newtable(L);
+    list->anchorsRef = lua_ref(L, -1);
+    lua_pop(L, 1);
+
+    DrawList* previous = current;
+    current = list;
+
+    lua_pushvalue(L, 1);
+    int status = lua_pcall(L, 0, 0, 0);
+
+    current = previous;
+
+    // hand the anchors over to the list itself
+    push_anchors_table(L);
+    lua_pushvalue(L, listIndex);
+    lua_getref(L, list->anchorsRef);
+    lua_rawset(L, -3);
+    lua_pop(L, 1);
+
+    lua_unref(L, list->anchorsRef);
+    list->anchorsRef = LUA_NOREF;
+
+    if (status != LUA_OK) {
+        lua_error(L);
+    }
+
+    lua_pushvalue(L, listIndex);
+    return 1;
+}
+
+DrawList* check_drawlist(lua_State* L, int index) {
+    void* ud = lua_touserdatatagged(L, index, kDrawListUserdataTag);
+    if (!ud) {
+        luaL_typeerror(L, index, "DrawList");
+    }
+    return static_cast<DrawList*>(ud);
+}
+
+int index(lua_State* L) {
+    const char* key = luaL_checkstring(L, 2);
+
+    for (auto& [name, func] : udata) {
+        if (name && strcmp(name, key) == 0) {
+            lua_pushcfunction(L, func, name);
+            return 1;
+        }
+    }
+
+    luaL_error(L, "Attempt to access invalid DrawList property: %s", key);
+    return 0;
+}
+
+int draw(lua_State* L) {
+    WINDOW_NOT_INITIALIZED_CHECK();
+
+    DrawList* list = check_drawlist(L, 1);
+
+    float dx = 0.0f;
+    float dy = 0.0f;
+    if (const float* offset = lua_tovector(L, 2)) {
+        dx = offset[0];
+        dy = offset[1];
+    } else if (!lua_isnoneornil(L, 2)) {
+        luaL_typeerror(L, 2, "vector");
+    }
+
+    Color tint = lua_isnoneornil(L, 3) ? WHITE : color::check_color(L, 3);
+    bool tinted = tint.r != 255 || tint.g != 255 || tint.b != 255 || tint.a != 255;
+
+    if (DrawList* target = capture()) {
+        // nested lists are flattened into the one being recorded
+        if (target == list) {
+            luaL_error(L, "Cannot draw a DrawList into itself");
+        }
+        anchor(L, 1);
+
+        for (const Span& span : list->spans) {
+            if (released(span)) {
+                continue;
+            }
+
+            target->spans.push_back(Span{span.texture, span.mode, target->vertices.size(), span.count, span.owner});
+            for (size_t i = span.first; i < span.first + span.count; ++i) {
+                Vertex vertex = list->vertices[i];
+                if (span.mode != kClear) {
+                    vertex.x += dx;
+                    vertex.y += dy;
+                    vertex.color = tinted ? multiply(vertex.color, tint) : vertex.color;
+                }
+                target->vertices.push_back(vertex);
+            }
+        }
+        return 0;
+    }
+
+    for (const Span& span : list->spans) {
+        if (released(span)) {
+            continue;
+        }
+
+        const Vertex* vertices = list->vertices.data() + span.first;
+
+        if (span.mode == kClear) {
+            ClearBackground(vertices[0].color);
+            continue;
+        }
+
+        int primitive = vertices_per_primitive(span.mode);
+
+        rlSetTexture(texture_of(span));
+        rlBegin(span.mode);
+
+        for (size_t i = 0; i < span.count; i += primitive) {
+            // flushes the batch when it is full and keeps our texture and mode
+            rlCheckRenderBatchLimit(primitive);
+
+            for (int j = 0; j < primitive; ++j) {
+                const Vertex& vertex = vertices[i + j];
+                Color color = tinted ? multiply(vertex.color, tint) : vertex.color;
+                rlColor4ub(color.r, color.g, color.b, color.a);
+                rlTexCoord2f(vertex.u, vertex.v);
+                rlVertex2f(vertex.x + dx, vertex.y + dy);
+            }
+        }
+
+        rlEnd();
+    }
+
+    rlSetTexture(0);
+
+    return 0;
+}
+
+int stats(lua_State* L) {
+    DrawList* list = check_drawlist(L, 1);
+
+    lua_createtable(L, 0, 2);
+    lua_pushinteger(L, static_cast<int>(list->vertices.size()));
+    lua_setfield(L, -2, "vertices");
+    lua_pushinteger(L, static_cast<int>(list->spans.size()));
+    lua_setfield(L, -2, "spans");
+
+    return 1;
+}
+
+} // namespace drawlist
+
+
+int adoreregister_drawlist(lua_State* L)
+{
+    luaL_newmetatable(L, "DrawList");
+    lua_pushvalue(L, -1);
+    lua_setuserdatametatable(L, kDrawListUserdataTag);
+
+    lua_pushcfunction(L, drawlist::index, nullptr);
+    lua_setfield(L, -2, "__index");
+
+    lua_setreadonly(L, -1, true);
+
+    lua_setuserdatadtor(L, kDrawListUserdataTag,
+        [](lua_State* L, void* ud)
+        {
+            static_cast<drawlist::DrawList*>(ud)->~DrawList();
+        }
+    );
+
+    lua_pop(L, 1);
+
+    lua_createtable(L, 0, std::size(drawlist::lib));
+    luaL_register(L, nullptr, drawlist::lib);
+    lua_setreadonly(L, -1, true);
+
+    return 1;
+}
@@ -0,0 +1,477 @@
+#include "adore/dynamicfont.h"
+
+#include "adore/core.h"
+#include "adore/window.h"
+#include "adore/colors.h"
+#include "adore/resources.h"
+#include "adore/drawlist.h"
+#include "adore/software.h"
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include "raylib.h"
+#include "rlgl.h"
+
+namespace dynamicfont {
+
+constexpr int kDefaultPageSize = 512;
+constexpr int kDefaultMaxPages = 4;
+constexpr int kPadding = 2;
+constexpr int kBytesPerPixel = 2;
+
+// raylib's default spacing between lines of text
+constexpr float kLineSpacing = 2.0f;
+
+// Rasterizing a glyph of this much more than a shelf wastes the rest of the shelf
+constexpr float kShelfWaste = 0.7f;
+
+const Glyph& DynamicFont::glyph(int codepoint) {
+    auto it = glyphs.find(codepoint);
+    if (it != glyphs.end()) {
+        if (it->second.page >= 0) {
+            pages[it->second.page].lastUsed = stamp;
+        }
+        return it->second;
+    }
+
+    Glyph entry = { -1, { 0.0f, 0.0f, 0.0f, 0.0f }, 0.0f, 0.0f, static_cast<float>(baseSize) / 2.0f };
+
+    GlyphInfo* info = LoadFontData(fileData.data(), static_cast<int>(fileData.size()), baseSize, &codepoint, 1, FONT_DEFAULT);
+    if (info) {
+        const Image& image = info->image;
+        entry.offsetX = static_cast<float>(info->offsetX);
+        entry.offsetY = static_cast<float>(info->offsetY);
+        entry.advanceX = static_cast<float>(info->advanceX == 0 ? image.width : info->advanceX);
+        entry.rec.width = static_cast<float>(image.width);
+        entry.rec.height = static_cast<float>(image.height);
+
+        int page, x, y;
+        if (image.data && image.width > 0 && image.height > 0 && place(image.width + 2 * kPadding, image.height + 2 * kPadding, page, x, y)) {
+            Page& target = pages[page];
+            const unsigned char* source = static_cast<const unsigned char*>(image.data);
+            for (int row = 0; row < image.height; ++row) {
+                unsigned char* destination = target.pixels.data() + ((y + kPadding + row) * pageSize + x + kPadding) * kBytesPerPixel;
+                for (int column = 0; column < image.width; ++column) {
+                    destination[column * kBytesPerPixel] = 255;
+                    destination[column * kBytesPerPixel + 1] = source[row * image.width + column];
+                }
+            }
+
+            target.dirtyTop = std::min(target.dirtyTop, y);
+            target.dirtyBottom = std::max(target.dirtyBottom, y + image.height + 2 * kPadding);
+            target.codepoints.push_back(codepoint);
+            target.lastUsed = stamp;
+
+            entry.page = page;
+            entry.rec.x = static_cast<float>(x + kPadding);
+            entry.rec.y = static_cast<float>(y + kPadding);
+        }
+
+        UnloadFontData(info, 1);
+    }
+
+    rasterized++;
+    return glyphs.emplace(codepoint, entry).first->second;
+}
+
+bool DynamicFont::place(int width, int height, int& page, int& x, int& y) {
+    if (width > pageSize || height > pageSize) {
+        return false;
+    }
+
+    auto try_page = [&](int index) {
+        Page& candidate = pages[index];
+        for (Shelf& shelf : candidate.shelves) {
+            if (height <= shelf.height && height >= shelf.height * kShelfWaste && shelf.x + width <= pageSize) {
+                x = shelf.x;
+                y = shelf.y;
+                shelf.x += width;
+                page = index;
+                return true;
+            }
+        }
+
+        int bottom = candidate.shelves.empty() ? 0 : candidate.shelves.back().y + candidate.shelves.back().height;
+        if (bottom + height > pageSize) {
+            return false;
+        }
+
+        candidate.shelves.push_back(Shelf{bottom, height, width});
+        x = 0;
+        y = bottom;
+        page = index;
+        return true;
+    };
+
+    for (size_t i = 0; i < pages.size(); ++i) {
+        if (try_page(static_cast<int>(i))) {
+            return true;
+        }
+    }
+
+    int index = pages.size() < maxPages ? -1 : evict();
+    if (index < 0) {
+        // pages are all in use by this very call, grow past the limit rather than drop glyphs
+        Page created = {};
+        created.pixels.assign(static_cast<size_t>(pageSize) * pageSize * kBytesPerPixel, 0);
+        created.dirtyTop = pageSize;
+        created.dirtyBottom = 0;
+
+        Image image = { created.pixels.data(), pageSize, pageSize, 1, PIXELFORMAT_UNCOMPRESSED_GRAY_ALPHA };
+        created.texture = LoadTextureFromImage(image);
+        resources::track(resources::Kind::TEXTURE, resources::texture_bytes(created.texture));
+
+        pages.push_back(std::move(created));
+        index = static_cast<int>(pages.size()) - 1;
+    }
+
+    return try_page(index);
+}
+
+int DynamicFont::evict() {
+    int oldest = -1;
+    for (size_t i = 0; i < pages.size(); ++i) {
+        if (pages[i].lastUsed == stamp) {
+            continue;
+        }
+        if (oldest < 0 || pages[i].lastUsed < pages[oldest].lastUsed) {
+            oldest = static_cast<int>(i);
+        }
+    }
+
+    if (oldest < 0) {
+        return -1;
+    }
+
+    Page& page = pages[oldest];
+    for (int codepoint : page.codepoints) {
+        glyphs.erase(codepoint);
+    }
+    evicted += page.codepoints.size();
+
+    page.codepoints.clear();
+    page.shelves.clear();
+    std::fill(page.pixels.begin(), page.pixels.end(), 0);
+    page.dirtyTop = 0;
+    page.dirtyBottom = pageSize;
+
+    // text drawn earlier this frame may still be waiting in the batch with the old glyphs
+    rlDrawRenderBatchActive();
+
+    return oldest;
+}
+
+void DynamicFont::flush() {
+    for (Page& page : pages) {
+        if (page.dirtyTop >= page.dirtyBottom) {
+            continue;
+        }
+
+        // whole rows are contiguous in the copy, so no repacking is needed
+        Rectangle rows = { 0.0f, static_cast<float>(page.dirtyTop), static_cast<float>(pageSize), static_cast<float>(page.dirtyBottom - page.dirtyTop) };
+        software::forget(page.texture.id);
+        UpdateTextureRec(page.texture, rows, page.pixels.data() + static_cast<size_t>(page.dirtyTop) * pageSize * kBytesPerPixel);
+
+        page.dirtyTop = pageSize;
+        page.dirtyBottom = 0;
+        uploads++;
+    }
+}
+
+void DynamicFont::release() {
+    for (Page& page : pages) {
+        resources::defer(page.texture);
+    }
+
+    pages.clear();
+    glyphs.clear();
+    fileData.clear();
+    fileData.shrink_to_fit();
+}
+
+int load(lua_State* L) {
+    WINDOW_NOT_INITIALIZED_CHECK();
+
+    const char* path = luaL_checkstring(L, 1);
+    int size = luaL_optinteger(L, 2, 32);
+    bool hasOptions = !lua_isnoneornil(L, 3);
+    if (hasOptions) {
+        luaL_checktype(L, 3, LUA_TTABLE);
+    }
+
+    int pageSize = kDefaultPageSize;
+    int maxPages = kDefaultMaxPages;
+    if (hasOptions) {
+        lua_getfield(L, 3, "pagesize");
+        pageSize = lua_isnil(L, -1) ? pageSize : luaL_checkinteger(L, -1);
+        lua_pop(L, 1);
+
+        lua_getfield(L, 3, "maxpages");
+        maxPages = lua_isnil(L, -1) ? maxPages : luaL_checkinteger(L, -1);
+        lua_pop(L, 1);
+    }
+
+    if (size <= 0 || pageSize <= 0 || maxPages <= 0) {
+        luaL_error(L, "Font size, page size and page count must be positive");
+    }
+
+    int dataSize = 0;
+    unsigned char* data = LoadFileData(path, &dataSize);
+    if (!data) {
+        luaL_error(L, "Failed to load font: %s", path);
+    }
+
+    void* ud = lua_newuserdatatagged(L, sizeof(DynamicFont), kDynamicFontUserdataTag);
+    DynamicFont* font = new (ud) DynamicFont();
+    lua_getuserdatametatable(L, kDynamicFontUserdataTag);
+    lua_setmetatable(L, -2);
+
+    font->fileData.assign(data, data + dataSize);
+    UnloadFileData(data);
+
+    font->baseSize = size;
+    font->pageSize = pageSize;
+    font->maxPages = static_cast<size_t>(maxPages);
+
+    return 1;
+}
+
+DynamicFont* check_dynamicfont(lua_State* L, int index) {
+    void* ud = lua_touserdatatagged(L, index, kDynamicFontUserdataTag);
+    if (!ud) {
+        luaL_typeerror(L, index, "DynamicFont");
+    }
+
+    DynamicFont* font = static_cast<DynamicFont*>(ud);
+    if (font->fileData.empty()) {
+        luaL_error(L, "Font has been released");
+    }
+    return font;
+}
+
+int index(lua_State* L) {
+    const char* key = luaL_checkstring(L, 2);
+
+    for (auto& [name, func] : udata) {
+        if (name && strcmp(name, key) == 0) {
+            lua_pushcfunction(L, func, name);
+            return 1;
+        }
+    }
+
+    DynamicFont* font = check_dynamicfont(L, 1);
+
+    if (strcmp(key, "size") == 0) {
+        lua_pushinteger(L, font->baseSize);
+        return 1;
+    }
+
+    luaL_error(L, "Attempt to access invalid DynamicFont property: %s", key);
+    return 0;
+}
+
+// Rasterize every glyph of `text` that is missing, then upload the pages once
+static void prepare(DynamicFont* font, const char* text) {
+    font->stamp++;
+
+    for (const char* cursor = text; *cursor;) {
+        int length = 0;
+        int codepoint = GetCodepointNext(cursor, &length);
+        cursor += length > 0 ? length : 1;
+
+        if (codepoint != '\n') {
+            font->glyph(codepoint);
+        }
+    }
+
+    font->flush();
+}
+
+int draw(lua_State* L) {
+    WINDOW_NOT_INITIALIZED_CHECK();
+
+    DynamicFont* font = check_dynamicfont(L, 1);
+    float x = static_cast<float>(luaL_checknumber(L, 2));
+    float y = static_cast<float>(luaL_checknumber(L, 3));
+    float size = static_cast<float>(luaL_checknumber(L, 4));
+    const char* text = luaL_checkstring(L, 5);
+    Color color = color::check_color(L, 6);
+    float spacing = static_cast<float>(luaL_optnumber(L, 7, 1.0f));
+
+    // recorded quads would point at glyphs that may be evicted later
+    if (drawlist::recording()) {
+        luaL_error(L, "Dynamic fonts cannot be drawn while recording a DrawList");
+    }
+
+    prepare(font, text);
+
+    float scale = size / font->baseSize;
+    float offsetX = 0.0f;
+    float offsetY = 0.0f;
+    int current = -1;
+    // not recording, so this is the software renderer's list when it is enabled
+    drawlist::DrawList* list = drawlist::capture();
+
+    for (const char* cursor = text; *cursor;) {
+        int length = 0;
+        int codepoint = GetCodepointNext(cursor, &length);
+        cursor += length > 0 ? length : 1;
+
+        if (codepoint == '\n') {
+            offsetY += size + kLineSpacing;
+            offsetX = 0.0f;
+            continue;
+        }
+
+        const Glyph& glyph = font->glyph(codepoint);
+        if (glyph.page >= 0 && list) {
+            const Texture2D& texture = font->pages[glyph.page].texture;
+            Rectangle dest = { x + offsetX + glyph.offsetX * scale, y + offsetY + glyph.offsetY * scale, glyph.rec.width * scale, glyph.rec.height * scale };
+            list->texture(texture, glyph.rec, dest, { 0.0f, 0.0f }, 0.0f, color);
+        } else if (glyph.page >= 0) {
+            const Texture2D& texture = font->pages[glyph.page].texture;
+            if (glyph.page != current) {
+                if (current >= 0) {
+                    rlEnd();
+                }
+                rlSetTexture(texture.id);
+                rlBegin(RL_QUADS);
+                rlColor4ub(color.r, color.g, color.b, color.a);
+                rlNormal3f(0.0f, 0.0f, 1.0f);
+                current = glyph.page;
+            }
+
+            // flushes the batch when it is full and keeps our texture and mode
+            rlCheckRenderBatchLimit(4);
+
+            float left = x + offsetX + glyph.offsetX * scale;
+            float top = y + offsetY + glyph.offsetY * scale;
+            float right = left + glyph.rec.width * scale;
+            float bottom = top + glyph.rec.height * scale;
+
+            float u0 = glyph.rec.x / texture.width;
+            float v0 = glyph.rec.y / texture.height;
+            float u1 = (glyph.rec.x + glyph.rec.width) / texture.width;
+            float v1 = (glyph.rec.y + glyph.rec.height) / texture.height;
+
+            rlTexCoord2f(u0, v0);
+            rlVertex2f(left, top);
+            rlTexCoord2f(u0, v1);
+            rlVertex2f(left, bottom);
+            rlTexCoord2f(u1, v1);
+            rlVertex2f(right, bottom);
+            rlTexCoord2f(u1, v0);
+            rlVertex2f(right, top);
+        }
+
+        offsetX += glyph.advanceX * scale + spacing;
+    }
+
+    if (current >= 0) {
+        rlEnd();
+        rlSetTexture(0);
+    }
+
+    return 0;
+}
+
+int measure(lua_State* L) {
+    // measuring rasterizes missing glyphs into the atlas, which uploads them
+    WINDOW_NOT_INITIALIZED_CHECK();
+
+    DynamicFont* font = check_dynamicfont(L, 1);
+    float size = static_cast<float>(luaL_checknumber(L, 2));
+    const char* text = luaL_checkstring(L, 3);
+    float spacing = static_cast<float>(luaL_optnumber(L, 4, 1.0f));
+
+    prepare(font, text);
+
+    float scale = size / font->baseSize;
+    float width = 0.0f;
+    float lineWidth = 0.0f;
+    int lines = 1;
+
+    for (const char* cursor = text; *cursor;) {
+        int length = 0;
+        int codepoint = GetCodepointNext(cursor, &length);
+        cursor += length > 0 ? length : 1;
+
+        if (codepoint == '\n') {
+            width = std::max(width, lineWidth);
+            lineWidth = 0.0f;
+            lines++;
+            continue;
+        }
+
+        lineWidth += font->glyph(codepoint).advanceX * scale + spacing;
+    }
+    width = std::max(width, lineWidth);
+
+    // like MeasureTextEx, no spacing after the last glyph
+    width = width > 0.0f ? width - spacing : 0.0f;
+    float height = lines * size + (lines - 1) * kLineSpacing;
+
+    lua_pushvector(L, width, height, 0.0f, 0.0f);
+    return 1;
+}
+
+int stats(lua_State* L) {
+    DynamicFont* font = check_dynamicfont(L, 1);
+
+    lua_createtable(L, 0, 5);
+    lua_pushinteger(L, static_cast<int>(font->glyphs.size()));
+    lua_setfield(L, -2, "glyphs");
+    lua_pushinteger(L, static_cast<int>(font->pages.size()));
+    lua_setfield(L, -2, "pages");
+    lua_pushnumber(L, static_cast<double>(font->rasterized));
+    lua_setfield(L, -2, "rasterized");
+    lua_pushnumber(L, static_cast<double>(font->evicted));
+    lua_setfield(L, -2, "evicted");
+    lua_pushnumber(L, static_cast<double>(font->uploads));
+    lua_setfield(L, -2, "uploads");
+
+    return 1;
+}
+
+int release(lua_State* L) {
+    void* ud = lua_touserdatatagged(L, 1, kDynamicFontUserdataTag);
+    if (!ud) {
+        luaL_typeerror(L, 1, "DynamicFont");
+    }
+
+    static_cast<DynamicFont*>(ud)->release();
+
+    return 0;
+}
+
+} // namespace dynamicfont
+
+
+int adoreregister_dynamicfont(lua_State* L)
+{
+    luaL_newmetatable(L, "DynamicFont");
+    lua_pushvalue(L, -1);
+    lua_setuserdatametatable(L, kDynamicFontUserdataTag);
+
+    lua_pushcfunction(L, dynamicfont::index, nullptr);
+    lua_setfield(L, -2, "__index");
+
+    lua_setreadonly(L, -1, true);
+
+    lua_setuserdatadtor(L, kDynamicFontUserdataTag,
+        [](lua_State* L, void* ud)
+        {
+            dynamicfont::DynamicFont* font = static_cast<dynamicfont::DynamicFont*>(ud);
+            font->release();
+            font->~DynamicFont();
+        }
+    );
+
+    lua_pop(L, 1);
+
+    lua_createtable(L, 0, std::size(dynamicfont::lib));
+    luaL_register(L, nullptr, dynamicfont::lib); //
+    lua_setreadonly(L, -1, true);
+
+    return 1;
+}
@@ -4,16 +4,123 @@
 #include "adore/window.h"
 #include "adore/colors.h"
 #include "adore/texture.h"
+#include "adore/resources.h"
+#include "adore/drawlist.h"
+#include "adore/software.h"
+#include "adore/assets.h"
+#include "adore/shader.h"
 #include <memory>
 #include <iostream>
 #include "raylib.h"
+#include "rlgl.h"
 
 namespace font {
 
+// Padding around each glyph in the atlas, same as LoadFontEx
+constexpr int kGlyphPadding = 4;
+constexpr int kGlyphCount = 95;
+
+// Distance fields are stored in a single channel, 0.5 is the glyph outline
+static const char* kSdfShader330 = R"(#version 330
+in vec2 fragTexCoord;
+in vec4 fragColor;
+uniform sampler2D texture0;
+uniform vec4 colDiffuse;
+out vec4 finalColor;
+
+void main()
+{
+    float distance = texture(texture0, fragTexCoord).r - 0.5;
+    float change = length(vec2(dFdx(distance), dFdy(distance)));
+    float alpha = smoothstep(-change, change, distance);
+    finalColor = vec4(fragColor.rgb, fragColor.a * alpha) * colDiffuse;
+}
+)";
+
+static const char* kSdfShader100 = R"(#version 100
+#extension GL_OES_standard_derivatives : enable
+precision mediump float;
+varying vec2 fragTexCoord;
+varying vec4 fragColor;
+uniform sampler2D texture0;
+uniform vec4 colDiffuse;
+
+void main()
+{
+    float distance = texture2D(texture0, fragTexCoord).r - 0.5;
+    float change = length(vec2(dFdx(distance), dFdy(distance)));
+    float alpha = smoothstep(-change, change, distance);
+    gl_FragColor = vec4(fragColor.rgb, fragColor.a * alpha) * colDiffuse;
+}
+)";
+
+static Shader sdfShader = {};
+
+bool is_sdf(const Font& font) {
+    return font.texture.format == PIXELFORMAT_UNCOMPRESSED_GRAYSCALE;
+}
+
+const Shader& sdf_shader() {
+    if (sdfShader.id == 0) {
+        sdfShader = LoadShaderFromMemory(nullptr, rlGetVersion() == RL_OPENGL_ES_20 ? kSdfShader100 : kSdfShader330);
+    }
+    return sdfShader;
+}
+
+void shutdown() {
+    if (sdfShader.id != 0) {
+        UnloadShader(sdfShader);
+        sdfShader = {};
+    }
+}
+
+// Bake the ASCII range as distance fields into a single channel atlas
+static Font load_sdf_font(const char* path, int size) {
+    Font font = {};
+
+    int dataSize = 0;
+    unsigned char* data = LoadFileData(path, &dataSize);
+    if (!data) {
+        return font;
+    }
+
+    font.baseSize = size;
+    font.glyphCount = kGlyphCount;
+    font.glyphPadding = kGlyphPadding;
+    font.glyphs = LoadFontData(data, dataSize, size, nullptr, kGlyphCount, FONT_SDF);
+    UnloadFileData(data);
+
+    if (!font.glyphs) {
+        return Font{};
+    }
+
+    Image atlas = GenImageFontAtlas(font.glyphs, &font.recs, kGlyphCount, size, kGlyphPadding, 0);
+
+    // the atlas comes back as GRAY_ALPHA with the field in alpha, keep only that
+    int pixels = atlas.width * atlas.height;
+    unsigned char* field = static_cast<unsigned char*>(MemAlloc(pixels));
+    const unsigned char* source = static_cast<const unsigned char*>(atlas.data);
+    for (int i = 0; i < pixels; ++i) {
+        field[i] = source[i * 2 + 1];
+    }
+    UnloadImage(atlas);
+
+    atlas.data = field;
+    atlas.format = PIXELFORMAT_UNCOMPRESSED_GRAYSCALE;
+    font.texture = LoadTextureFromImage(atlas);
+    UnloadImage(atlas);
+
+    SetTextureFilter(font.texture, TEXTURE_FILTER_BILINEAR);
+
+    return font;
+}
+
 int create_font_userdata(lua_State* L, const Font& font) {
     Font* fontPtr = static_cast<Font*>(lua_newuserdatatagged(L, sizeof(Font), kFontUserdataTag));
     *fontPtr = font;
 
+    resources::track(resources::Kind::FONT, resources::font_bytes(font));
+
     lua_getuserdatametatable(L, kFontUserdataTag);
     lua_setmetatable(L, -2);
 
@@ -25,13 +132,27 @@ int load_font_from_path(lua_State* L) {
 
     const char* path = luaL_checkstring(L, 1);
     int size = luaL_optinteger(L, 2, 32);
+    bool sdf = false;
+    if (!lua_isnoneornil(L, 3)) {
+        luaL_checktype(L, 3, LUA_TTABLE);
+        lua_getfield(L, 3, "sdf");
+        sdf = lua_toboolean(L, -1);
+        lua_pop(L, 1);
+    }
+
+    assets::Key key = assets::key(resources::Kind::FONT, path, size, sdf ? "sdf" : nullptr);
+    if (assets::push(L, key)) {
+        return 1;
+    }
 
-    Font font = LoadFontEx(path, size, nullptr, 95);
+    Font font = sdf ? load_sdf_font(path, size) : LoadFontEx(path, size, nullptr, kGlyphCount);
     if (font.texture.id == 0) {
         luaL_error(L, "Failed to load font: %s", path);
     }
 
-    return create_font_userdata(L, font);
+    create_font_userdata(L, font);
+    assets::store(L, -1, key, font.texture.id);
+    return 1;
 }
 
 Font* check_font(lua_State* L, int index) {
@@ -39,15 +160,34 @@ Font* check_font(lua_State* L, int index) {
     if (!ud) {
         luaL_typeerror(L, index, "Font");
     }
-    return static_cast<Font*>(ud);
+
+    Font* font = static_cast<Font*>(ud);
+    if (font->texture.id == 0) {
+        luaL_error(L, "Font has been released");
+    }
+    return font;
 }
 
 int index(lua_State* L) {
-    Font* font = check_font(L, 1);
     const char* key = luaL_checkstring(L, 2);
 
+    for (auto& [name, func] : udata) {
+        if (name && strcmp(name, key) == 0) {
+            lua_pushcfunction(L, func, name);
+            return 1;
+        }
+    }
+
+    Font* font = check_font(L, 1);
+
     if (strcmp(key, "texture") == 0) {
-        return texture::create_texture_userdata(L, font->texture, false /* owned */);
+        return texture::push_texture_view(L, 1, font->texture);
+    } else if (strcmp(key, "size") == 0) {
+        lua_pushinteger(L, font->baseSize);
+        return 1;
+    } else if (strcmp(key, "sdf") == 0) {
+        lua_pushboolean(L, is_sdf(*font));
+        return 1;
     }
 
     luaL_error(L, "Attempt to access invalid Texture property: %s", key);
@@ -68,6 +208,30 @@ int draw_font(lua_State* L) {
     Color color = color::check_color(L, 6);
     float spacing = luaL_optnumber(L, 7, 1.0f);
 
+    if (is_sdf(*font)) {
+        // draw lists have no notion of shaders
+        if (drawlist::recording()) {
+            luaL_error(L, "SDF fonts cannot be drawn while recording a DrawList");
+        }
+        SOFTWARE_UNSUPPORTED_CHECK("SDF fonts");
+
+        BeginShaderMode(sdf_shader());
+        DrawTextEx(*font, text, { x, y }, static_cast<float>(size), spacing, WHITE);
+        EndShaderMode();
+
+        // back to the script's shader pass if the text was drawn inside one
+        if (const Shader* active = shader::active()) {
+            BeginShaderMode(*active);
+        }
+        return 0;
+    }
+
+    if (drawlist::DrawList* list = drawlist::capture()) {
+        drawlist::anchor(L, 1);
+        list->text(*font, text, { x, y }, static_cast<float>(size), spacing, WHITE);
+        return 0;
+    }
+
     DrawTextEx(*font, text, { x, y }, static_cast<float>(size), spacing, WHITE);
 
     return 0;
@@ -90,6 +254,24 @@ int get_default_font(lua_State* L) {
     return create_font_userdata(L, defaultFont);
 }
 
+int release(lua_State* L) {
+    void* ud = lua_touserdatatagged(L, 1, kFontUserdataTag);
+    if (!ud) {
+        luaL_typeerror(L, 1, "Font");
+    }
+
+    Font* font = static_cast<Font*>(ud);
+    // other loads of the same file keep drawing it
+    if (font->texture.id != 0 && !assets::drop(resources::Kind::FONT, font->texture.id)) {
+        resources::defer(*font);
+    }
+
+    texture::invalidate_texture_view(L, font->texture);
+    *font = Font{};
+
+    return 0;
+}
+
 } // namespace font
 
 
@@ -108,7 +290,9 @@ int adoreregister_font(lua_State* L)
         [](lua_State* L, void* ud)
         {
             Font* font = static_cast<Font*>(ud);
-            UnloadFont(*font);
+            if (font->texture.id != 0 && !assets::retain(resources::Kind::FONT, font->texture.id, *font)) {
+                resources::defer(*font);
+            }
         }
     );
 
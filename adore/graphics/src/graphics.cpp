@@ -2,18 +2,115 @@
 
 #include "adore/colors.h"
 #include "adore/rect.h"
+#include "adore/resources.h"
+#include "adore/drawlist.h"
+#include "adore/targetpool.h"
+#include "adore/readback.h"
+#include "adore/recorder.h"
+#include "adore/software.h"
+#include "adore/metrics.h"
 #include <memory>
 #include "raylib.h"
+#include "external/glad.h"
 #include <iostream>
 
 namespace graphics {
 
+// Unloading a texture can stall on the driver, spread big releases over a few frames
+static size_t releaseBudget = 32;
+
+// rlgl submits every batch through glDrawArrays and glDrawElements, which are
+// wrapped once GL is loaded to count the draw calls of each frame
+static PFNGLDRAWARRAYSPROC drawArrays = nullptr;
+static PFNGLDRAWELEMENTSPROC drawElements = nullptr;
+static uint64_t frameDrawCalls = 0;
+static uint64_t lastFrameDrawCalls = 0;
+
+static void GLAD_API_PTR counted_draw_arrays(GLenum mode, GLint first, GLsizei count) {
+    frameDrawCalls++;
+    drawArrays(mode, first, count);
+}
+
+static void GLAD_API_PTR counted_draw_elements(GLenum mode, GLsizei count, GLenum type, const void* indices) {
+    frameDrawCalls++;
+    drawElements(mode, count, type, indices);
+}
+
+static void count_draw_calls() {
+    static metrics::Counter& drawCalls = metrics::counter("adore_graphics_draw_calls_total", "Draw calls submitted to the GPU");
+
+    if (!drawArrays && glad_glDrawArrays && glad_glDrawElements) {
+        drawArrays = glad_glDrawArrays;
+        drawElements = glad_glDrawElements;
+        glad_glDrawArrays = counted_draw_arrays;
+        glad_glDrawElements = counted_draw_elements;
+    }
+
+    drawCalls.add(frameDrawCalls);
+    lastFrameDrawCalls = frameDrawCalls;
+    frameDrawCalls = 0;
+}
+
+void end_frame() {
+    count_draw_calls();
+    loader::update();
+    readback::update();
+    recorder::update();
+    rendertexture::end_frame();
+    targetpool::end_frame();
+    resources::drain(releaseBudget);
+}
+
+void before_present() {
+    // a pass the draw callback left open would otherwise carry into the next frame
+    shader::reset();
+    software::present();
+    recorder::capture();
+}
+
+void shutdown() {
+    loader::shutdown();
+    batch::shutdown();
+    readback::shutdown();
+    recorder::shutdown();
+    font::shutdown();
+    targetpool::shutdown();
+    resources::drain();
+    software::shutdown();
+}
+
+int setreleasebudget(lua_State* L) {
+    int budget = luaL_checkinteger(L, 1);
+    if (budget < 0) {
+        luaL_error(L, "Release budget must not be negative");
+    }
+
+    releaseBudget = static_cast<size_t>(budget);
+    return 0;
+}
+
+int drawcalls(lua_State* L) {
+    lua_pushnumber(L, static_cast<double>(lastFrameDrawCalls));
+    return 1;
+}
+
 int rectangle(lua_State* L) {
     const char* mode = luaL_checkstring(L, 1);
     Rectangle rect;
     int end = rect::check_rect(L, 2, &rect);
     Color color = color::check_color(L, end);
 
+    if (drawlist::DrawList* list = drawlist::capture()) {
+        if (strcmp(mode, "fill") == 0) {
+            list->rectangle(rect, color);
+        } else if (strcmp(mode, "line") == 0) {
+            list->rectangle_lines(rect, color);
+        } else {
+            luaL_error(L, "Invalid mode for rectangle: %s", mode);
+        }
+        return 0;
+    }
+
     if (strcmp(mode, "fill") == 0) {
         DrawRectangle(rect.x, rect.y, rect.width, rect.height, color);
     } else if (strcmp(mode, "line") == 0) {
@@ -32,6 +129,18 @@ int circle(lua_State* L) {
     int radius = luaL_checkinteger(L, 4);
     Color color = color::check_color(L, 5);
 
+    if (drawlist::DrawList* list = drawlist::capture()) {
+        Vector2 center = { static_cast<float>(x), static_cast<float>(y) };
+        if (strcmp(mode, "fill") == 0) {
+            list->circle(center, static_cast<float>(radius), color);
+        } else if (strcmp(mode, "line") == 0) {
+            list->circle_lines(center, static_cast<float>(radius), color);
+        } else {
+            luaL_error(L, "Invalid mode for circle: %s", mode);
+        }
+        return 0;
+    }
+
     if (strcmp(mode, "fill") == 0) {
         DrawCircle(x, y, radius, color);
     } else if (strcmp(mode, "line") == 0) {
@@ -50,6 +159,13 @@ int print(lua_State* L) {
     int fontsize = luaL_checkinteger(L, 4);
     Color color = color::check_color(L, 5);
 
+    if (drawlist::DrawList* list = drawlist::capture()) {
+        // same defaults as DrawText
+        fontsize = fontsize < 10 ? 10 : fontsize;
+        list->text(GetFontDefault(), text, { static_cast<float>(x), static_cast<float>(y) }, static_cast<float>(fontsize), static_cast<float>(fontsize / 10), color);
+        return 0;
+    }
+
     DrawText(text, x, y, fontsize, color);
 
     return 0;
@@ -58,18 +174,12 @@ int print(lua_State* L) {
 int clear(lua_State* L) {
     Color color = color::check_color(L, 1);
 
-    ClearBackground(color);
-
-    return 0;
-}
-
-int drawtexture(lua_State* L) {
-    texture::TextureRef* textureRef = texture::check_texture(L, 1);
-    int x = luaL_checkinteger(L, 2);
-    int y = luaL_checkinteger(L, 3);
-    Color tint = color::check_color(L, 4);
+    if (drawlist::DrawList* list = drawlist::capture()) {
+        list->clear(color);
+        return 0;
+    }
 
-    DrawTexture(textureRef->texture, x, y, tint);
+    ClearBackground(color);
 
     return 0;
 }
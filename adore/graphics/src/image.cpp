@@ -2,16 +2,50 @@
 
 #include "adore/core.h"
 #include "adore/window.h"
+#include "adore/resources.h"
+#include "adore/loader.h"
+#include "adore/assets.h"
+#include "adore/pixels.h"
+#include "adore/resample.h"
+#include "adore/convolve.h"
+#include <algorithm>
+#include <functional>
+#include <limits>
 #include <memory>
+#include <unordered_set>
+#include <vector>
 #include <iostream>
 #include "raylib.h"
 
 namespace image {
 
+static const char* kBuffersRegistryKey = "adore.graphics.imagebuffers";
+
+// Images whose pixels live in a Luau buffer, which frees them instead of raylib
+static std::unordered_set<const Image*> borrowed;
+
+// raylib sizes pixel data with int, larger images can't go through it
+static const size_t kMaxImageBytes = static_cast<size_t>(std::numeric_limits<int>::max());
+
+// Allocate pixels for a new image, raising an error instead of wrapping around
+static void* alloc_pixels(lua_State* L, size_t size) {
+    if (size > kMaxImageBytes) {
+        luaL_error(L, "Image would need %.0f bytes, more than the %.0f supported", static_cast<double>(size), static_cast<double>(kMaxImageBytes));
+    }
+
+    void* data = MemAlloc(static_cast<unsigned int>(size));
+    if (data == nullptr) {
+        luaL_error(L, "Out of memory allocating %.0f bytes for an image", static_cast<double>(size));
+    }
+    return data;
+}
+
 int create_image_userdata(lua_State* L, const Image& image) {
     Image* imagePtr = static_cast<Image*>(lua_newuserdatatagged(L, sizeof(Image), kImageUserdataTag));
     *imagePtr = image;
 
+    resources::track(resources::Kind::IMAGE, resources::image_bytes(image));
+
     lua_getuserdatametatable(L, kImageUserdataTag);
     lua_setmetatable(L, -2);
 
@@ -23,13 +57,27 @@ int load_image(lua_State* L) {
 
     const char* path = luaL_checkstring(L, 1);
 
-    Image image = LoadImage(path);
-    if (image.data == NULL) {
-        lua_pushnil(L);
-        return 1;
+    Image image = {};
+    assets::Key key = assets::key(resources::Kind::IMAGE, path);
+    if (!assets::copy(key, image)) {
+        image = LoadImage(path);
+        if (image.data == NULL) {
+            lua_pushnil(L);
+            return 1;
+        }
+        assets::keep(key, image);
     }
 
-    return create_image_userdata(L, image);
+    create_image_userdata(L, image);
+    return 1;
+}
+
+int load_image_async(lua_State* L) {
+    WINDOW_NOT_INITIALIZED_CHECK();
+
+    const char* path = luaL_checkstring(L, 1);
+
+    return loader::load_async(L, path, loader::Target::IMAGE);
 }
 
 Image* check_image(lua_State* L, int index) {
@@ -37,7 +85,12 @@ Image* check_image(lua_State* L, int index) {
     if (!ud) {
         luaL_typeerror(L, index, "Image");
     }
-    return static_cast<Image*>(ud);
+
+    Image* image = static_cast<Image*>(ud);
+    if (image->data == nullptr) {
+        luaL_error(L, "Image has been released");
+    }
+    return image;
 }
 
 static const std::pair<const char*, int> formats[] = {
@@ -56,10 +109,31 @@ static const std::pair<const char*, int> formats[] = {
     { "r16g16b16a16", PIXELFORMAT_UNCOMPRESSED_R16G16B16A16 }
 };
 
+int check_format(lua_State* L, int index) {
+    const char* formatStr = luaL_checkstring(L, index);
+
+    for (const auto& [name, format] : formats) {
+        if (strcmp(formatStr, name) == 0) {
+            return format;
+        }
+    }
+
+    luaL_error(L, "Invalid pixel format: %s", formatStr);
+    return 0;
+}
+
 int index(lua_State* L) {
-    Image* image = check_image(L, 1);
     const char* key = luaL_checkstring(L, 2);
 
+    for (auto& [name, func] : udata) {
+        if (name && strcmp(name, key) == 0) {
+            lua_pushcfunction(L, func, name);
+            return 1;
+        }
+    }
+
+    Image* image = check_image(L, 1);
+
     if (strcmp(key, "width") == 0) {
         lua_pushinteger(L, image->width);
         return 1;
@@ -84,22 +158,408 @@ int index(lua_State* L) {
     return 0;
 }
 
+// The pixels are about to change under the image, its size will be tracked
+// again by attach()
+static void detach(Image* image) {
+    resources::untrack(resources::Kind::IMAGE, resources::image_bytes(*image));
+}
+
+static void attach(Image* image) {
+    resources::track(resources::Kind::IMAGE, resources::image_bytes(*image));
+}
+
+// Bytes of the whole mip chain, like ImageCopy
+static size_t data_size(const Image& image) {
+    size_t size = 0;
+    int width = image.width;
+    int height = image.height;
+    for (int level = 0; level < image.mipmaps; ++level) {
+        size += GetPixelDataSize(width, height, image.format);
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+    return size;
+}
+
+// Weak keyed by image, holds the buffer backing its pixels
+static void push_buffers_table(lua_State* L) {
+    lua_getfield(L, LUA_REGISTRYINDEX, kBuffersRegistryKey);
+    if (lua_istable(L, -1)) {
+        return;
+    }
+    lua_pop(L, 1);
+
+    lua_newtable(L);
+    lua_createtable(L, 0, 1);
+    lua_pushstring(L, "k");
+    lua_setfield(L, -2, "__mode");
+    lua_setmetatable(L, -2);
+
+    lua_pushvalue(L, -1);
+    lua_setfield(L, LUA_REGISTRYINDEX, kBuffersRegistryKey);
+}
+
+static void set_buffer(lua_State* L, int imageIndex, int bufferIndex) {
+    imageIndex = lua_absindex(L, imageIndex);
+    bufferIndex = lua_absindex(L, bufferIndex);
+
+    push_buffers_table(L);
+    lua_pushvalue(L, imageIndex);
+    lua_pushvalue(L, bufferIndex);
+    lua_rawset(L, -3);
+    lua_pop(L, 1);
+}
+
+// Point the image at the memory of the buffer at bufferIndex
+static void borrow(lua_State* L, int imageIndex, Image* image, int bufferIndex) {
+    image->data = lua_tobuffer(L, bufferIndex, nullptr);
+    set_buffer(L, imageIndex, bufferIndex);
+    borrowed.insert(image);
+}
+
+// Raylib is about to free or reallocate the pixels, a buffer backed image gets its
+// own copy first. The buffer keeps the pixels as they were.
+static void own(lua_State* L, int imageIndex, Image* image) {
+    if (borrowed.erase(image) == 0) {
+        return;
+    }
+
+    size_t size = data_size(*image);
+    void* data = MemAlloc(static_cast<unsigned int>(size));
+    memcpy(data, image->data, size);
+    image->data = data;
+
+    lua_pushnil(L);
+    set_buffer(L, imageIndex, -1);
+    lua_pop(L, 1);
+}
+
 int format_image(lua_State* L) {
     Image* image = check_image(L, 1);
-    const char* formatStr = luaL_checkstring(L, 2);
+    int format = check_format(L, 2);
+    bool inplace = luaL_optboolean(L, 3, false);
 
-    for (const auto& [name, format] : formats) {
-        if (strcmp(formatStr, name) == 0) {
-            Image newImage = ImageCopy(*image);
-            ImageFormat(&newImage, format);
-            return create_image_userdata(L, newImage);
+    if (image->mipmaps == 1 && pixels::can_convert(image->format, format)) {
+        size_t count = static_cast<size_t>(image->width) * image->height;
+        size_t texel = static_cast<size_t>(GetPixelDataSize(1, 1, format));
+
+        // checked before multiplying so the size can't wrap around
+        if (count > kMaxImageBytes / texel) {
+            luaL_error(L, "Image of %dx%d is too large", image->width, image->height);
+        }
+        size_t size = count * texel;
+
+        if (!inplace) {
+            void* data = alloc_pixels(L, size);
+            pixels::convert(image->data, image->format, data, format, count);
+            return create_image_userdata(L, Image{ data, image->width, image->height, 1, format });
         }
+
+        // allocated before the image is touched, so a failure leaves it as it was
+        bool shrinks = size <= data_size(*image);
+        void* data = shrinks ? nullptr : alloc_pixels(L, size);
+
+        detach(image);
+        own(L, 1, image);
+        if (shrinks) {
+            pixels::convert(image->data, image->format, image->data, format, count);
+            // the larger block still holds the pixels if it can't be shrunk
+            if (void* smaller = MemRealloc(image->data, static_cast<unsigned int>(size))) {
+                image->data = smaller;
+            }
+        } else {
+            pixels::convert(image->data, image->format, data, format, count);
+            MemFree(image->data);
+            image->data = data;
+        }
+        image->format = format;
+        attach(image);
+
+        lua_pushvalue(L, 1);
+        return 1;
     }
 
-    luaL_error(L, "Invalid pixel format: %s", formatStr);
+    // everything else still goes through raylib's float conversion
+    if (inplace) {
+        detach(image);
+        own(L, 1, image);
+        ImageFormat(image, format);
+        attach(image);
+
+        lua_pushvalue(L, 1);
+        return 1;
+    }
+
+    Image newImage = ImageCopy(*image);
+    ImageFormat(&newImage, format);
+    return create_image_userdata(L, newImage);
+}
+
+// Run an R8G8B8A8 kernel into a new image, or over the image itself
+static int apply_rgba(lua_State* L, Image* image, bool inplace, const char* name, const std::function<void(const unsigned char*, unsigned char*, size_t)>& kernel) {
+    if (image->format != PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 || image->mipmaps != 1) {
+        luaL_error(L, "%s needs an r8g8b8a8 image without mipmaps", name);
+    }
+
+    size_t count = static_cast<size_t>(image->width) * image->height;
+    const unsigned char* source = static_cast<const unsigned char*>(image->data);
+
+    if (inplace) {
+        detach(image);
+        kernel(source, static_cast<unsigned char*>(image->data), count);
+        attach(image);
+
+        lua_pushvalue(L, 1);
+        return 1;
+    }
+
+    void* data = MemAlloc(count * 4);
+    kernel(source, static_cast<unsigned char*>(data), count);
+    return create_image_userdata(L, Image{ data, image->width, image->height, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 });
+}
+
+int swizzle_image(lua_State* L) {
+    Image* image = check_image(L, 1);
+    const char* orderStr = luaL_checkstring(L, 2);
+    bool inplace = luaL_optboolean(L, 3, false);
+
+    // "bgra" takes blue into the first channel, and so on
+    unsigned char order[4];
+    const char* channels = "rgba";
+    if (strlen(orderStr) != 4) {
+        luaL_error(L, "Invalid channel order: %s", orderStr);
+    }
+    for (int i = 0; i < 4; ++i) {
+        const char* channel = strchr(channels, orderStr[i]);
+        if (!channel) {
+            luaL_error(L, "Invalid channel order: %s", orderStr);
+        }
+        order[i] = static_cast<unsigned char>(channel - channels);
+    }
+
+    return apply_rgba(L, image, inplace, "swizzle", [&order](const unsigned char* source, unsigned char* destination, size_t count) {
+        pixels::swizzle(source, destination, count, order);
+    });
+}
+
+int premultiply_image(lua_State* L) {
+    Image* image = check_image(L, 1);
+    bool inplace = luaL_optboolean(L, 2, false);
+
+    return apply_rgba(L, image, inplace, "premultiply", pixels::premultiply);
+}
+
+int unpremultiply_image(lua_State* L) {
+    Image* image = check_image(L, 1);
+    bool inplace = luaL_optboolean(L, 2, false);
+
+    return apply_rgba(L, image, inplace, "unpremultiply", pixels::unpremultiply);
+}
+
+static const std::pair<const char*, resample::Filter> filters[] = {
+    { "box", resample::Filter::BOX },
+    { "bilinear", resample::Filter::BILINEAR },
+    { "lanczos", resample::Filter::LANCZOS },
+};
+
+int resize_image(lua_State* L) {
+    Image* image = check_image(L, 1);
+    int width = luaL_checkinteger(L, 2);
+    int height = luaL_checkinteger(L, 3);
+    const char* filterStr = luaL_optstring(L, 4, "bilinear");
+
+    auto filter = std::find_if(std::begin(filters), std::end(filters), [filterStr](const auto& entry) { return strcmp(entry.first, filterStr) == 0; });
+    if (filter == std::end(filters)) {
+        luaL_error(L, "Invalid resize filter: %s", filterStr);
+    }
+    if (width <= 0 || height <= 0) {
+        luaL_error(L, "Image size must be positive");
+    }
+    if (image->format != PIXELFORMAT_UNCOMPRESSED_R8G8B8A8) {
+        luaL_error(L, "resize needs an r8g8b8a8 image, convert it with image.format first");
+    }
+
+    // checked before multiplying so the size can't wrap around
+    if (static_cast<size_t>(width) > kMaxImageBytes / 4 / static_cast<size_t>(height)) {
+        luaL_error(L, "Image of %dx%d is too large", width, height);
+    }
+
+    // only the first level of a mip chain is resized
+    void* data = alloc_pixels(L, static_cast<size_t>(width) * height * 4);
+    resample::resize(static_cast<const unsigned char*>(image->data), image->width, image->height, static_cast<unsigned char*>(data), width, height, filter->second);
+    return create_image_userdata(L, Image{ data, width, height, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 });
+}
+
+int genmipmaps(lua_State* L) {
+    Image* image = check_image(L, 1);
+    bool inplace = luaL_optboolean(L, 2, false);
+
+    if (image->format != PIXELFORMAT_UNCOMPRESSED_R8G8B8A8) {
+        luaL_error(L, "genmipmaps needs an r8g8b8a8 image, convert it with image.format first");
+    }
+
+    int levels;
+    size_t size = resample::mipmap_size(image->width, image->height, &levels);
+    size_t baseSize = static_cast<size_t>(image->width) * image->height * 4;
+    if (size > kMaxImageBytes) {
+        luaL_error(L, "Mip chain of %dx%d is too large", image->width, image->height);
+    }
+
+    unsigned char* chain;
+    if (inplace) {
+        detach(image);
+        own(L, 1, image);
+        chain = static_cast<unsigned char*>(MemRealloc(image->data, static_cast<unsigned int>(size)));
+        if (chain == nullptr) {
+            attach(image);
+            luaL_error(L, "Out of memory allocating %.0f bytes for an image", static_cast<double>(size));
+        }
+    } else {
+        chain = static_cast<unsigned char*>(alloc_pixels(L, size));
+        memcpy(chain, image->data, baseSize);
+    }
+
+    resample::mipmaps(chain, image->width, image->height, levels);
+
+    if (inplace) {
+        image->data = chain;
+        image->mipmaps = levels;
+        attach(image);
+
+        lua_pushvalue(L, 1);
+        return 1;
+    }
+
+    return create_image_userdata(L, Image{ chain, image->width, image->height, levels, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 });
+}
+
+// The filters work in place on one level of four channel pixels
+static convolve::Surface check_filterable(lua_State* L, Image* image, const char* name) {
+    bool isFloat = image->format == PIXELFORMAT_UNCOMPRESSED_R32G32B32A32;
+    if ((!isFloat && image->format != PIXELFORMAT_UNCOMPRESSED_R8G8B8A8) || image->mipmaps != 1) {
+        luaL_error(L, "%s needs an r8g8b8a8 or r32g32b32a32 image without mipmaps", name);
+    }
+
+    return convolve::Surface{ image->data, image->width, image->height, isFloat };
+}
+
+static std::vector<float> check_kernel(lua_State* L, int index) {
+    luaL_checktype(L, index, LUA_TTABLE);
+
+    int size = lua_objlen(L, index);
+    if (size % 2 == 0) {
+        luaL_error(L, "Convolution kernel must have an odd number of weights");
+    }
+
+    std::vector<float> kernel(size);
+    for (int i = 0; i < size; ++i) {
+        lua_rawgeti(L, index, i + 1);
+        kernel[i] = static_cast<float>(luaL_checknumber(L, -1));
+        lua_pop(L, 1);
+    }
+    return kernel;
+}
+
+int blur_image(lua_State* L) {
+    Image* image = check_image(L, 1);
+    double sigma = luaL_checknumber(L, 2);
+
+    convolve::Surface surface = check_filterable(L, image, "blur");
+    if (sigma < 0) {
+        luaL_error(L, "Blur sigma must not be negative");
+    }
+
+    detach(image);
+    convolve::blur(surface, static_cast<float>(sigma));
+    attach(image);
+
+    lua_pushvalue(L, 1);
+    return 1;
+}
+
+int convolve_image(lua_State* L) {
+    Image* image = check_image(L, 1);
+    convolve::Surface surface = check_filterable(L, image, "convolve");
+
+    std::vector<float> horizontal = check_kernel(L, 2);
+    std::vector<float> vertical = lua_isnoneornil(L, 3) ? horizontal : check_kernel(L, 3);
+
+    detach(image);
+    convolve::separable(surface, horizontal.data(), static_cast<int>(horizontal.size()), vertical.data(), static_cast<int>(vertical.size()));
+    attach(image);
+
+    lua_pushvalue(L, 1);
+    return 1;
+}
+
+static const std::pair<const char*, pixels::Level> levels[] = {
+    { "reference", pixels::Level::REFERENCE },
+    { "scalar", pixels::Level::SCALAR },
+    { "sse2", pixels::Level::SSE2 },
+    { "avx2", pixels::Level::AVX2 },
+};
+
+int setkernels(lua_State* L) {
+    const char* levelStr = luaL_checkstring(L, 1);
+
+    for (const auto& [name, level] : levels) {
+        if (strcmp(levelStr, name) == 0) {
+            pixels::limit(level);
+            // capped at what the CPU supports
+            lua_pushstring(L, pixels::level_name(pixels::level()));
+            return 1;
+        }
+    }
+
+    luaL_error(L, "Invalid kernel level: %s", levelStr);
     return 0;
 }
 
+int lock(lua_State* L) {
+    Image* image = check_image(L, 1);
+
+    push_buffers_table(L);
+    lua_pushvalue(L, 1);
+    lua_rawget(L, -2);
+    if (lua_isbuffer(L, -1)) {
+        return 1;
+    }
+    lua_pop(L, 2);
+
+    // moved into a buffer once, every later lock hands out the same memory
+    detach(image);
+    size_t size = data_size(*image);
+    void* data = lua_newbuffer(L, size);
+    memcpy(data, image->data, size);
+    MemFree(image->data);
+    borrow(L, 1, image, -1);
+    attach(image);
+
+    return 1;
+}
+
+int from_buffer(lua_State* L) {
+    size_t length;
+    luaL_checkbuffer(L, 1, &length);
+    int width = luaL_checkinteger(L, 2);
+    int height = luaL_checkinteger(L, 3);
+    int format = lua_isnoneornil(L, 4) ? PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 : check_format(L, 4);
+
+    if (width <= 0 || height <= 0) {
+        luaL_error(L, "Image size must be positive");
+    }
+    int size = GetPixelDataSize(width, height, format);
+    if (static_cast<size_t>(size) > length) {
+        luaL_error(L, "Buffer holds %d bytes, a %dx%d image needs %d", static_cast<int>(length), width, height, size);
+    }
+
+    create_image_userdata(L, Image{ nullptr, width, height, 1, format });
+    Image* image = static_cast<Image*>(lua_touserdatatagged(L, -1, kImageUserdataTag));
+    borrow(L, -1, image, 1);
+
+    return 1;
+}
+
 int export_image(lua_State* L) {
     Image* image = check_image(L, 1);
     const char* path = luaL_checkstring(L, 2);
@@ -111,6 +571,30 @@ int export_image(lua_State* L) {
     return 1;
 }
 
+int release(lua_State* L) {
+    void* ud = lua_touserdatatagged(L, 1, kImageUserdataTag);
+    if (!ud) {
+        luaL_typeerror(L, 1, "Image");
+    }
+
+    // images live in system memory, there is no reason to wait for the frame
+    Image* image = static_cast<Image*>(ud);
+    if (image->data != nullptr) {
+        resources::untrack(resources::Kind::IMAGE, resources::image_bytes(*image));
+        if (borrowed.erase(image)) {
+            lua_pushnil(L);
+            set_buffer(L, 1, -1);
+            lua_pop(L, 1);
+        } else {
+            UnloadImage(*image);
+        }
+    }
+
+    *image = Image{};
+
+    return 0;
+}
+
 } // namespace image
 
 
@@ -129,7 +613,14 @@ int adoreregister_image(lua_State* L)
         [](lua_State* L, void* ud)
         {
             Image* image = static_cast<Image*>(ud);
-            UnloadImage(*image);
+            if (image::borrowed.erase(image)) {
+                resources::untrack(resources::Kind::IMAGE, resources::image_bytes(*image));
+                return;
+            }
+            if (image->data != nullptr) {
+                resources::untrack(resources::Kind::IMAGE, resources::image_bytes(*image));
+                UnloadImage(*image);
+            }
         }
     );
 
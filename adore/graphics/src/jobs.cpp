@@ -0,0 +1,154 @@
+#include "adore/jobs.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace jobs {
+
+// decoding is memory bound, more threads than this only fight over bandwidth
+constexpr unsigned int kMaxWorkers = 4;
+
+struct Pool {
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<std::function<void()>> queue;
+    // parallel_for helpers, taken before anything in `queue` so a frame never waits on decodes
+    std::deque<std::function<void()>> bands;
+    std::vector<std::thread> workers;
+    bool stopping = false;
+};
+
+static Pool& pool() {
+    static Pool instance;
+    return instance;
+}
+
+static void work(Pool& p) {
+    for (;;) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(p.mutex);
+            p.wake.wait(lock, [&p]() { return p.stopping || !p.bands.empty() || !p.queue.empty(); });
+            if (p.stopping) {
+                return;
+            }
+
+            std::deque<std::function<void()>>& source = p.bands.empty() ? p.queue : p.bands;
+            job = std::move(source.front());
+            source.pop_front();
+        }
+
+        job();
+    }
+}
+
+// leave a core for the render thread
+static unsigned int worker_count() {
+    unsigned int hardware = std::thread::hardware_concurrency();
+    return std::clamp(hardware > 1 ? hardware - 1 : 1u, 1u, kMaxWorkers);
+}
+
+static void start_workers(Pool& p) {
+    if (p.workers.empty()) {
+        unsigned int count = worker_count();
+        p.stopping = false;
+        for (unsigned int i = 0; i < count; ++i) {
+            p.workers.emplace_back(work, std::ref(p));
+        }
+    }
+}
+
+void submit(std::function<void()> job) {
+    Pool& p = pool();
+
+    {
+        std::lock_guard<std::mutex> lock(p.mutex);
+        start_workers(p);
+        p.queue.push_back(std::move(job));
+    }
+
+    p.wake.notify_one();
+}
+
+// Shared by the caller and its helpers. Bands are claimed one at a time, so the
+// caller works through all of them itself when every worker is busy with a decode.
+struct ParallelFor {
+    const std::function<void(size_t begin, size_t end)>* body;
+    size_t count;
+    size_t size;
+    size_t bands;
+    std::atomic<size_t> next{0};
+
+    std::mutex mutex;
+    std::condition_variable done;
+    size_t finished = 0;
+
+    void run() {
+        for (size_t band = next++; band < bands; band = next++) {
+            size_t begin = band * size;
+            (*body)(begin, std::min(count, begin + size));
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (++finished == bands) {
+                done.notify_one();
+            }
+        }
+    }
+};
+
+void parallel_for(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& body) {
+    size_t bands = std::min<size_t>(worker_count() + 1, count / std::max<size_t>(grain, 1));
+    if (bands <= 1) {
+        body(0, count);
+        return;
+    }
+
+    // helpers that only start after the caller returned find no band left, they
+    // keep the state alive but never touch `body`
+    auto state = std::make_shared<ParallelFor>();
+    state->body = &body;
+    state->count = count;
+    state->size = (count + bands - 1) / bands;
+    state->bands = bands;
+
+    Pool& p = pool();
+    {
+        std::lock_guard<std::mutex> lock(p.mutex);
+        start_workers(p);
+        for (size_t band = 1; band < bands; ++band) {
+            p.bands.push_back([state]() { state->run(); });
+        }
+    }
+    p.wake.notify_all();
+
+    // the caller claims bands too instead of sitting idle
+    state->run();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->done.wait(lock, [&state]() { return state->finished == state->bands; });
+}
+
+void shutdown() {
+    Pool& p = pool();
+
+    {
+        std::lock_guard<std::mutex> lock(p.mutex);
+        p.stopping = true;
+        p.queue.clear();
+        p.bands.clear();
+    }
+    p.wake.notify_all();
+
+    for (std::thread& worker : p.workers) {
+        worker.join();
+    }
+    p.workers.clear();
+}
+
+} // namespace jobs
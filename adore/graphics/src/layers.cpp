@@ -0,0 +1,398 @@
+#include "adore/layers.h"
+
+#include "adore/core.h"
+#include "adore/window.h"
+#include "adore/texture.h"
+#include "adore/drawlist.h"
+#include "adore/software.h"
+#include "adore/resources.h"
+#include "adore/rendertexture.h"
+#include "adore/targetpool.h"
+#include "adore/metrics.h"
+#include <cmath>
+#include <cstring>
+#include <new>
+#include "raylib.h"
+#include "rlgl.h"
+
+namespace layers {
+
+struct BlendName {
+    const char* name;
+    int mode;
+};
+
+// layers hold premultiplied colour, every mode here expects it
+static const BlendName blends[] = {
+    { "normal", BLEND_ALPHA_PREMULTIPLY },
+    { "add", BLEND_ADD_COLORS },
+    { "multiply", BLEND_MULTIPLIED },
+};
+
+struct Counters {
+    metrics::Counter& rendered = metrics::counter("adore_graphics_layer_composites_total", "Layers composited", metrics::label("result", "rendered"));
+    metrics::Counter& cached = metrics::counter("adore_graphics_layer_composites_total", "Layers composited", metrics::label("result", "cached"));
+};
+
+static Counters& counters() {
+    static Counters instance;
+    return instance;
+}
+
+// the layer whose draw function is running, targets cannot nest
+static bool rendering = false;
+
+bool Layer::stale() const {
+    return dirty || animated || GetTime() < animateUntil;
+}
+
+static int check_blend(lua_State* L, int index) {
+    const char* blendStr = luaL_checkstring(L, index);
+
+    for (const auto& [name, mode] : blends) {
+        if (strcmp(blendStr, name) == 0) {
+            return mode;
+        }
+    }
+
+    luaL_error(L, "Invalid layer blend mode: %s", blendStr);
+    return 0;
+}
+
+static const char* blend_name(int mode) {
+    for (const auto& [name, blend] : blends) {
+        if (blend == mode) {
+            return name;
+        }
+    }
+    return "normal";
+}
+
+static void configure(lua_State* L, int index, Layer* layer) {
+    lua_getfield(L, index, "blend");
+    if (!lua_isnil(L, -1)) {
+        layer->blend = check_blend(L, -1);
+    }
+    lua_pop(L, 1);
+
+    lua_getfield(L, index, "opacity");
+    if (!lua_isnil(L, -1)) {
+        double opacity = luaL_checknumber(L, -1);
+        layer->opacity = static_cast<float>(opacity < 0.0 ? 0.0 : (opacity > 1.0 ? 1.0 : opacity));
+    }
+    lua_pop(L, 1);
+
+    lua_getfield(L, index, "visible");
+    if (!lua_isnil(L, -1)) {
+        layer->visible = lua_toboolean(L, -1);
+    }
+    lua_pop(L, 1);
+
+    lua_getfield(L, index, "animated");
+    if (!lua_isnil(L, -1)) {
+        layer->animated = lua_toboolean(L, -1);
+    }
+    lua_pop(L, 1);
+}
+
+int create(lua_State* L) {
+    WINDOW_NOT_INITIALIZED_CHECK();
+
+    luaL_checktype(L, 1, LUA_TFUNCTION);
+    bool hasOptions = !lua_isnoneornil(L, 2);
+    if (hasOptions) {
+        luaL_checktype(L, 2, LUA_TTABLE);
+    }
+
+    int width = GetScreenWidth();
+    int height = GetScreenHeight();
+    if (hasOptions) {
+        lua_getfield(L, 2, "width");
+        width = lua_isnil(L, -1) ? width : luaL_checkinteger(L, -1);
+        lua_getfield(L, 2, "height");
+        height = lua_isnil(L, -1) ? height : luaL_checkinteger(L, -1);
+        lua_pop(L, 2);
+    }
+    if (width <= 0 || height <= 0) {
+        luaL_error(L, "Layer size must be positive, got %dx%d", width, height);
+    }
+
+    void* ud = lua_newuserdatatagged(L, sizeof(Layer), kLayerUserdataTag);
+    Layer* layer = new (ud) Layer();
+    lua_getuserdatametatable(L, kLayerUserdataTag);
+    lua_setmetatable(L, -2);
+
+    layer->blend = BLEND_ALPHA_PREMULTIPLY;
+    layer->opacity = 1.0f;
+    layer->visible = true;
+    layer->dirty = true;
+    layer->animated = false;
+    layer->animateUntil = 0.0;
+    layer->drawRef = LUA_NOREF;
+    layer->renders = 0;
+    layer->composites = 0;
+    if (hasOptions) {
+        configure(L, 2, layer);
+    }
+
+    layer->target = targetpool::load(width, height, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+    if (layer->target.id == 0) {
+        luaL_error(L, "Failed to create %dx%d layer", width, height);
+    }
+    resources::track(resources::Kind::RENDERTEXTURE, resources::rendertexture_bytes(layer->target));
+
+    layer->drawRef = lua_ref(L, 1);
+
+    return 1;
+}
+
+Layer* check_layer(lua_State* L, int index) {
+    void* ud = lua_touserdatatagged(L, index, kLayerUserdataTag);
+    if (!ud) {
+        luaL_typeerror(L, index, "Layer");
+    }
+
+    Layer* layer = static_cast<Layer*>(ud);
+    if (layer->target.id == 0) {
+        luaL_error(L, "Layer has been released");
+    }
+    return layer;
+}
+
+int index(lua_State* L) {
+    const char* key = luaL_checkstring(L, 2);
+
+    for (auto& [name, func] : udata) {
+        if (name && strcmp(name, key) == 0) {
+            lua_pushcfunction(L, func, name);
+            return 1;
+        }
+    }
+
+    Layer* layer = check_layer(L, 1);
+
+    if (strcmp(key, "width") == 0) {
+        lua_pushinteger(L, layer->target.texture.width);
+        return 1;
+    } else if (strcmp(key, "height") == 0) {
+        lua_pushinteger(L, layer->target.texture.height);
+        return 1;
+    } else if (strcmp(key, "blend") == 0) {
+        lua_pushstring(L, blend_name(layer->blend));
+        return 1;
+    } else if (strcmp(key, "opacity") == 0) {
+        lua_pushnumber(L, layer->opacity);
+        return 1;
+    } else if (strcmp(key, "visible") == 0) {
+        lua_pushboolean(L, layer->visible);
+        return 1;
+    } else if (strcmp(key, "animated") == 0) {
+        lua_pushboolean(L, layer->animated);
+        return 1;
+    } else if (strcmp(key, "dirty") == 0) {
+        lua_pushboolean(L, layer->stale());
+        return 1;
+    } else if (strcmp(key, "texture") == 0) {
+        return texture::push_texture_view(L, 1, layer->target.texture);
+    }
+
+    luaL_error(L, "Attempt to access invalid Layer property: %s", key);
+    return 0;
+}
+
+int set(lua_State* L) {
+    Layer* layer = check_layer(L, 1);
+    luaL_checktype(L, 2, LUA_TTABLE);
+    configure(L, 2, layer);
+    return 0;
+}
+
+int invalidate(lua_State* L) {
+    Layer* layer = check_layer(L, 1);
+    layer->dirty = true;
+    return 0;
+}
+
+int animate(lua_State* L) {
+    Layer* layer = check_layer(L, 1);
+    double seconds = luaL_checknumber(L, 2);
+    if (seconds < 0) {
+        luaL_error(L, "Layer animation time must not be negative");
+    }
+
+    layer->animateUntil = std::fmax(layer->animateUntil, GetTime() + seconds);
+    return 0;
+}
+
+// Run the draw function of the layer into its target
+static void render(lua_State* L, Layer* layer) {
+    if (rendering) {
+        luaL_error(L, "Layers cannot be drawn while another layer renders");
+    }
+
+    lua_getref(L, layer->drawRef);
+
+    rendering = true;
+    BeginTextureMode(layer->target);
+    ClearBackground(BLANK);
+    // straight alpha in, premultiplied out, so compositing the target over
+    // anything matches drawing the same calls there directly
+    rlSetBlendFactorsSeparate(RL_SRC_ALPHA, RL_ONE_MINUS_SRC_ALPHA, RL_ONE, RL_ONE_MINUS_SRC_ALPHA, RL_FUNC_ADD, RL_FUNC_ADD);
+    BeginBlendMode(BLEND_CUSTOM_SEPARATE);
+
+    int status = lua_pcall(L, 0, 0, 0);
+
+    EndBlendMode();
+    EndTextureMode();
+    rendering = false;
+
+    // layers drawn inside rendertexture.start composite into that target
+    if (const RenderTexture* outer = rendertexture::active()) {
+        BeginTextureMode(*outer);
+    }
+
+    // a failed render is retried next frame instead of caching half a layer
+    if (status != LUA_OK) {
+        lua_error(L);
+    }
+
+    layer->dirty = false;
+    layer->renders++;
+    counters().rendered.add();
+}
+
+static void composite_layer(lua_State* L, int index, Layer* layer, float x, float y) {
+    if (!layer->visible || layer->opacity <= 0.0f) {
+        return;
+    }
+
+    if (layer->stale()) {
+        render(L, layer);
+    } else {
+        counters().cached.add();
+    }
+    layer->composites++;
+
+    // premultiplied, the opacity scales colour and alpha alike
+    unsigned char alpha = static_cast<unsigned char>(layer->opacity * 255.0f + 0.5f);
+    Color tint = { alpha, alpha, alpha, alpha };
+
+    // render textures are stored bottom up
+    const Texture2D& texture = layer->target.texture;
+    Rectangle source = { 0.0f, 0.0f, static_cast<float>(texture.width), -static_cast<float>(texture.height) };
+
+    BeginBlendMode(layer->blend);
+    DrawTextureRec(texture, source, Vector2{ x, y }, tint);
+    EndBlendMode();
+}
+
+static void check_not_recording(lua_State* L) {
+    // rendering a layer switches render target, and a recording would keep
+    // whatever the layer held at the time
+    if (drawlist::recording()) {
+        luaL_error(L, "Layers cannot be recorded into a draw list");
+    }
+    // they blend with separate alpha factors the rasterizer does not have
+    SOFTWARE_UNSUPPORTED_CHECK("Layers");
+}
+
+int draw(lua_State* L) {
+    WINDOW_NOT_INITIALIZED_CHECK();
+
+    Layer* layer = check_layer(L, 1);
+    float x = static_cast<float>(luaL_optnumber(L, 2, 0.0));
+    float y = static_cast<float>(luaL_optnumber(L, 3, 0.0));
+    check_not_recording(L);
+
+    composite_layer(L, 1, layer, x, y);
+    return 0;
+}
+
+int composite(lua_State* L) {
+    WINDOW_NOT_INITIALIZED_CHECK();
+
+    luaL_checktype(L, 1, LUA_TTABLE);
+    float x = static_cast<float>(luaL_optnumber(L, 2, 0.0));
+    float y = static_cast<float>(luaL_optnumber(L, 3, 0.0));
+    check_not_recording(L);
+
+    int count = lua_objlen(L, 1);
+    for (int i = 1; i <= count; ++i) {
+        lua_rawgeti(L, 1, i);
+        Layer* layer = check_layer(L, -1);
+        composite_layer(L, -1, layer, x, y);
+        lua_pop(L, 1);
+    }
+
+    return 0;
+}
+
+int stats(lua_State* L) {
+    Layer* layer = check_layer(L, 1);
+
+    lua_createtable(L, 0, 3);
+    lua_pushnumber(L, static_cast<double>(layer->renders));
+    lua_setfield(L, -2, "renders");
+    lua_pushnumber(L, static_cast<double>(layer->composites));
+    lua_setfield(L, -2, "composites");
+    lua_pushnumber(L, static_cast<double>(layer->composites - layer->renders));
+    lua_setfield(L, -2, "cached");
+
+    return 1;
+}
+
+static void release_target(Layer* layer) {
+    // may still be bound by the batch, unloaded after the frame
+    if (layer->target.id != 0 && !targetpool::release(layer->target)) {
+        resources::defer(layer->target);
+    }
+    layer->target = RenderTexture{};
+}
+
+int release(lua_State* L) {
+    void* ud = lua_touserdatatagged(L, 1, kLayerUserdataTag);
+    if (!ud) {
+        luaL_typeerror(L, 1, "Layer");
+    }
+
+    Layer* layer = static_cast<Layer*>(ud);
+    texture::invalidate_texture_view(L, layer->target.texture);
+    release_target(layer);
+
+    lua_unref(L, layer->drawRef);
+    layer->drawRef = LUA_NOREF;
+
+    return 0;
+}
+
+} // namespace layers
+
+
+int adoreregister_layers(lua_State* L)
+{
+    luaL_newmetatable(L, "Layer");
+    lua_pushvalue(L, -1);
+    lua_setuserdatametatable(L, kLayerUserdataTag);
+
+    lua_pushcfunction(L, layers::index, nullptr);
+    lua_setfield(L, -2, "__index");
+
+    lua_setreadonly(L, -1, true);
+
+    lua_setuserdatadtor(L, kLayerUserdataTag,
+        [](lua_State* L, void* ud)
+        {
+            layers::Layer* layer = static_cast<layers::Layer*>(ud);
+            layers::release_target(layer);
+            lua_unref(L, layer->drawRef);
+        }
+    );
+
+    lua_pop(L, 1);
+
+    lua_createtable(L, 0, std::size(layers::lib));
+    luaL_register(L, nullptr, layers::lib); //
+    lua_setreadonly(L, -1, true);
+
+    return 1;
+}
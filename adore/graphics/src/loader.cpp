@@ -0,0 +1,186 @@
+#include "adore/loader.h"
+
+#include "adore/assets.h"
+#include "adore/image.h"
+#include "adore/jobs.h"
+#include "adore/texture.h"
+#include "adore/scheduler.h"
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "raylib.h"
+#include "rlgl.h"
+
+namespace loader {
+
+struct Request {
+    std::string path;
+    assets::Key key;
+    Target target;
+    scheduler::Token token;
+
+    // written by the worker, owned by the main thread once it is in the decoded list
+    Image image = {};
+
+    Texture2D texture = {};
+    int uploadedRows = 0;
+};
+
+using RequestPtr = std::shared_ptr<Request>;
+
+static std::mutex decodedMutex;
+static std::vector<RequestPtr> decoded;
+
+static std::deque<RequestPtr> uploads;
+
+// A 4K RGBA frame is ~33MB, this spreads it over about four frames
+static size_t uploadBudget = 8 * 1024 * 1024;
+
+int load_async(lua_State* L, const char* path, Target target) {
+    assets::Key key = assets::key(target == Target::IMAGE ? resources::Kind::IMAGE : resources::Kind::TEXTURE, path);
+    if (target == Target::IMAGE) {
+        Image image = {};
+        if (assets::copy(key, image)) {
+            return image::create_image_userdata(L, image);
+        }
+    } else if (assets::push(L, key)) {
+        return 1;
+    }
+
+    RequestPtr request = std::make_shared<Request>();
+    request->path = path;
+    request->key = key;
+    request->target = target;
+    request->token = scheduler::park(L);
+
+    jobs::submit([request]() {
+        request->image = LoadImage(request->path.c_str());
+
+        std::lock_guard<std::mutex> lock(decodedMutex);
+        decoded.push_back(request);
+    });
+
+    return lua_yield(L, 0);
+}
+
+static void finish_texture(const RequestPtr& request) {
+    UnloadImage(request->image);
+    request->image = {};
+
+    Texture2D texture = request->texture;
+    assets::Key key = request->key;
+    request->token->complete([texture, key](lua_State* L) {
+        texture::create_texture_userdata(L, texture, true);
+        assets::store(L, -1, key, texture.id);
+        return 1;
+    });
+}
+
+// Upload up to `budget` bytes of the texture, returns the bytes used
+static size_t upload(const RequestPtr& request, size_t budget) {
+    Image& image = request->image;
+
+    if (image.format >= PIXELFORMAT_COMPRESSED_DXT1_RGB) {
+        // compressed blocks can't be split by rows
+        request->texture = LoadTextureFromImage(image);
+        request->uploadedRows = image.height;
+        return static_cast<size_t>(GetPixelDataSize(image.width, image.height, image.format));
+    }
+
+    if (request->texture.id == 0) {
+        unsigned int id = rlLoadTexture(nullptr, image.width, image.height, image.format, 1);
+        request->texture = Texture2D{ id, image.width, image.height, 1, image.format };
+        if (id == 0) {
+            // update() fails the request, there is nothing to upload into
+            return 0;
+        }
+    }
+
+    size_t rowBytes = static_cast<size_t>(GetPixelDataSize(image.width, 1, image.format));
+    int remaining = image.height - request->uploadedRows;
+    int rows = budget == 0 ? remaining : static_cast<int>(budget / rowBytes);
+    rows = rows < 1 ? 1 : (rows > remaining ? remaining : rows);
+
+    const unsigned char* data = static_cast<const unsigned char*>(image.data) + rowBytes * request->uploadedRows;
+    rlUpdateTexture(request->texture.id, 0, request->uploadedRows, image.width, rows, image.format, data);
+    request->uploadedRows += rows;
+
+    return rowBytes * rows;
+}
+
+void update() {
+    std::vector<RequestPtr> ready;
+    {
+        std::lock_guard<std::mutex> lock(decodedMutex);
+        ready.swap(decoded);
+    }
+
+    for (const RequestPtr& request : ready) {
+        if (request->image.data == nullptr) {
+            request->token->fail("Failed to load image: " + request->path);
+            continue;
+        }
+
+        if (request->target == Target::IMAGE) {
+            Image image = request->image;
+            assets::keep(request->key, image);
+            request->token->complete([image](lua_State* L) {
+                return image::create_image_userdata(L, image);
+            });
+            continue;
+        }
+
+        uploads.push_back(request);
+    }
+
+    size_t used = 0;
+    while (!uploads.empty() && (uploadBudget == 0 || used < uploadBudget)) {
+        const RequestPtr& request = uploads.front();
+
+        used += upload(request, uploadBudget == 0 ? 0 : uploadBudget - used);
+
+        if (request->texture.id == 0) {
+            request->token->fail("Failed to upload texture: " + request->path);
+            UnloadImage(request->image);
+            uploads.pop_front();
+            continue;
+        }
+
+        if (request->uploadedRows >= request->image.height) {
+            finish_texture(request);
+            uploads.pop_front();
+        }
+    }
+}
+
+void shutdown() {
+    jobs::shutdown();
+
+    std::lock_guard<std::mutex> lock(decodedMutex);
+    for (const RequestPtr& request : decoded) {
+        UnloadImage(request->image);
+    }
+    decoded.clear();
+
+    for (const RequestPtr& request : uploads) {
+        UnloadImage(request->image);
+        if (request->texture.id != 0) {
+            rlUnloadTexture(request->texture.id);
+        }
+    }
+    uploads.clear();
+}
+
+int setuploadbudget(lua_State* L) {
+    double bytes = luaL_checknumber(L, 1);
+    if (bytes < 0) {
+        luaL_error(L, "Upload budget must not be negative");
+    }
+
+    uploadBudget = static_cast<size_t>(bytes);
+    return 0;
+}
+
+} // namespace loader
@@ -0,0 +1,518 @@
+#include "adore/particles.h"
+
+#include "adore/core.h"
+#include "adore/window.h"
+#include "adore/colors.h"
+#include "adore/texture.h"
+#include "adore/batch.h"
+#include "adore/drawlist.h"
+#include "adore/software.h"
+#include "adore/pixels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <new>
+#include "raylib.h"
+#include "rlgl.h"
+
+namespace particles {
+
+constexpr int kDefaultCapacity = 10000;
+constexpr int kMaxCapacity = 1 << 22;
+
+// arrays are padded to this many floats so the kernels never need a scalar tail
+constexpr size_t kLanes = 8;
+
+struct Step {
+    float dt;
+    float gravityX, gravityY;
+    float damping;
+};
+
+static void integrate_scalar(Emitter& e, size_t begin, size_t end, const Step& s) {
+    for (size_t i = begin; i < end; ++i) {
+        e.vx[i] = (e.vx[i] + s.gravityX * s.dt) * s.damping;
+        e.vy[i] = (e.vy[i] + s.gravityY * s.dt) * s.damping;
+        e.x[i] += e.vx[i] * s.dt;
+        e.y[i] += e.vy[i] * s.dt;
+        e.age[i] += e.aging[i] * s.dt;
+    }
+}
+
+#if ADORE_PIXELS_X86
+static void integrate_sse2(Emitter& e, size_t end, const Step& s) {
+    const __m128 dt = _mm_set1_ps(s.dt);
+    const __m128 pullX = _mm_set1_ps(s.gravityX * s.dt);
+    const __m128 pullY = _mm_set1_ps(s.gravityY * s.dt);
+    const __m128 damping = _mm_set1_ps(s.damping);
+
+    float* x = e.x.data();
+    float* y = e.y.data();
+    float* vx = e.vx.data();
+    float* vy = e.vy.data();
+    float* age = e.age.data();
+    const float* aging = e.aging.data();
+
+    for (size_t i = 0; i < end; i += 4) {
+        __m128 velocityX = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(vx + i), pullX), damping);
+        __m128 velocityY = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(vy + i), pullY), damping);
+        _mm_storeu_ps(vx + i, velocityX);
+        _mm_storeu_ps(vy + i, velocityY);
+        _mm_storeu_ps(x + i, _mm_add_ps(_mm_loadu_ps(x + i), _mm_mul_ps(velocityX, dt)));
+        _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(velocityY, dt)));
+        _mm_storeu_ps(age + i, _mm_add_ps(_mm_loadu_ps(age + i), _mm_mul_ps(_mm_loadu_ps(aging + i), dt)));
+    }
+}
+
+ADORE_TARGET_AVX2 static void integrate_avx2(Emitter& e, size_t end, const Step& s) {
+    const __m256 dt = _mm256_set1_ps(s.dt);
+    const __m256 pullX = _mm256_set1_ps(s.gravityX * s.dt);
+    const __m256 pullY = _mm256_set1_ps(s.gravityY * s.dt);
+    const __m256 damping = _mm256_set1_ps(s.damping);
+
+    float* x = e.x.data();
+    float* y = e.y.data();
+    float* vx = e.vx.data();
+    float* vy = e.vy.data();
+    float* age = e.age.data();
+    const float* aging = e.aging.data();
+
+    for (size_t i = 0; i < end; i += 8) {
+        __m256 velocityX = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(vx + i), pullX), damping);
+        __m256 velocityY = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(vy + i), pullY), damping);
+        _mm256_storeu_ps(vx + i, velocityX);
+        _mm256_storeu_ps(vy + i, velocityY);
+        _mm256_storeu_ps(x + i, _mm256_add_ps(_mm256_loadu_ps(x + i), _mm256_mul_ps(velocityX, dt)));
+        _mm256_storeu_ps(y + i, _mm256_add_ps(_mm256_loadu_ps(y + i), _mm256_mul_ps(velocityY, dt)));
+        _mm256_storeu_ps(age + i, _mm256_add_ps(_mm256_loadu_ps(age + i), _mm256_mul_ps(_mm256_loadu_ps(aging + i), dt)));
+    }
+}
+#endif
+
+// xorshift32, in [0, 1)
+static inline float next_random(uint32_t& state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return static_cast<float>(state >> 8) * (1.0f / 16777216.0f);
+}
+
+void Emitter::spawn(size_t amount) {
+    amount = std::min(amount, capacity - count);
+
+    for (size_t n = 0; n < amount; ++n) {
+        size_t i = count++;
+
+        x[i] = originX + (next_random(random) - 0.5f) * width;
+        y[i] = originY + (next_random(random) - 0.5f) * height;
+
+        float angle = (direction + (next_random(random) - 0.5f) * spread) * DEG2RAD;
+        float speed = speedMin + (speedMax - speedMin) * next_random(random);
+        vx[i] = cosf(angle) * speed;
+        vy[i] = sinf(angle) * speed;
+
+        age[i] = 0.0f;
+        aging[i] = 1.0f / (lifetimeMin + (lifetimeMax - lifetimeMin) * next_random(random));
+    }
+}
+
+void Emitter::update(float dt) {
+    Step step = { dt, gravityX, gravityY, std::exp(-drag * dt) };
+
+    // whole vectors, the padding past count is never read back
+    size_t end = (count + kLanes - 1) / kLanes * kLanes;
+#if ADORE_PIXELS_X86
+    if (pixels::level() >= pixels::Level::AVX2) {
+        integrate_avx2(*this, end, step);
+    } else if (pixels::level() >= pixels::Level::SSE2) {
+        integrate_sse2(*this, end, step);
+    } else {
+        integrate_scalar(*this, 0, count, step);
+    }
+#else
+    integrate_scalar(*this, 0, count, step);
+#endif
+
+    // the last particle takes the place of each dead one, draw order does not matter
+    for (size_t i = 0; i < count;) {
+        if (age[i] < 1.0f) {
+            ++i;
+            continue;
+        }
+
+        --count;
+        x[i] = x[count];
+        y[i] = y[count];
+        vx[i] = vx[count];
+        vy[i] = vy[count];
+        age[i] = age[count];
+        aging[i] = aging[count];
+    }
+
+    pending += rate * dt;
+    size_t amount = static_cast<size_t>(pending);
+    pending -= static_cast<float>(amount);
+    spawn(amount);
+}
+
+void Emitter::draw(const Texture2D* texture, Rectangle region) {
+    unsigned int id = rlGetTextureIdDefault();
+    float u0 = 0.0f, v0 = 0.0f, u1 = 1.0f, v1 = 1.0f;
+    if (texture) {
+        id = texture->id;
+        u0 = region.x / texture->width;
+        v0 = region.y / texture->height;
+        u1 = (region.x + region.width) / texture->width;
+        v1 = (region.y + region.height) / texture->height;
+    }
+
+    if (additive) {
+        BeginBlendMode(BLEND_ADDITIVE);
+    }
+    batch::begin(id);
+
+    for (size_t i = 0; i < count; ++i) {
+        int step = std::min(static_cast<int>(age[i] * (kCurveSteps - 1)), kCurveSteps - 1);
+        float half = sizes[step] * 0.5f;
+        const Color& color = colors[step];
+        if (color.a == 0 || half <= 0.0f) {
+            continue;
+        }
+
+        // flushes the batch when it is full and restores our texture
+        rlCheckRenderBatchLimit(4);
+
+        rlColor4ub(color.r, color.g, color.b, color.a);
+
+        rlTexCoord2f(u0, v0);
+        rlVertex2f(x[i] - half, y[i] - half);
+        rlTexCoord2f(u0, v1);
+        rlVertex2f(x[i] - half, y[i] + half);
+        rlTexCoord2f(u1, v1);
+        rlVertex2f(x[i] + half, y[i] + half);
+        rlTexCoord2f(u1, v0);
+        rlVertex2f(x[i] + half, y[i] - half);
+    }
+
+    batch::end();
+    if (additive) {
+        EndBlendMode();
+    }
+}
+
+void Emitter::release() {
+    for (std::vector<float>* array : { &x, &y, &vx, &vy, &age, &aging }) {
+        array->clear();
+        array->shrink_to_fit();
+    }
+    count = 0;
+    capacity = 0;
+}
+
+// A number, or a { min, max } table
+static void opt_range(lua_State* L, int index, const char* name, float& min, float& max) {
+    lua_getfield(L, index, name);
+    if (lua_istable(L, -1)) {
+        lua_rawgeti(L, -1, 1);
+        min = static_cast<float>(luaL_checknumber(L, -1));
+        lua_rawgeti(L, -2, 2);
+        max = static_cast<float>(luaL_checknumber(L, -1));
+        lua_pop(L, 2);
+    } else if (!lua_isnil(L, -1)) {
+        min = max = static_cast<float>(luaL_checknumber(L, -1));
+    }
+    lua_pop(L, 1);
+
+    if (max < min) {
+        luaL_error(L, "Particle %s range must not be reversed", name);
+    }
+}
+
+static void opt_number(lua_State* L, int index, const char* name, float& value) {
+    lua_getfield(L, index, name);
+    value = lua_isnil(L, -1) ? value : static_cast<float>(luaL_checknumber(L, -1));
+    lua_pop(L, 1);
+}
+
+// Keys spread evenly over the lifetime, sampled into kCurveSteps entries
+template <typename T, typename Read, typename Mix>
+static void opt_curve(lua_State* L, int index, const char* name, T (&curve)[kCurveSteps], Read read, Mix mix) {
+    lua_getfield(L, index, name);
+    if (lua_isnil(L, -1)) {
+        lua_pop(L, 1);
+        return;
+    }
+
+    std::vector<T> keys;
+    if (lua_istable(L, -1)) {
+        int length = lua_objlen(L, -1);
+        for (int i = 1; i <= length; ++i) {
+            lua_rawgeti(L, -1, i);
+            keys.push_back(read(L, -1));
+            lua_pop(L, 1);
+        }
+    } else {
+        keys.push_back(read(L, -1));
+    }
+    lua_pop(L, 1);
+
+    if (keys.empty()) {
+        luaL_error(L, "Particle %s need at least one value", name);
+    }
+
+    for (int step = 0; step < kCurveSteps; ++step) {
+        float position = static_cast<float>(step) / (kCurveSteps - 1) * (keys.size() - 1);
+        size_t key = std::min(static_cast<size_t>(position), keys.size() - 1);
+        size_t next = std::min(key + 1, keys.size() - 1);
+        curve[step] = mix(keys[key], keys[next], position - key);
+    }
+}
+
+static void configure(lua_State* L, int index, Emitter* e) {
+    luaL_checktype(L, index, LUA_TTABLE);
+
+    opt_number(L, index, "x", e->originX);
+    opt_number(L, index, "y", e->originY);
+    opt_number(L, index, "width", e->width);
+    opt_number(L, index, "height", e->height);
+    opt_number(L, index, "rate", e->rate);
+    opt_number(L, index, "direction", e->direction);
+    opt_number(L, index, "spread", e->spread);
+    opt_number(L, index, "drag", e->drag);
+    opt_range(L, index, "lifetime", e->lifetimeMin, e->lifetimeMax);
+    opt_range(L, index, "speed", e->speedMin, e->speedMax);
+
+    lua_getfield(L, index, "gravity");
+    if (!lua_isnil(L, -1)) {
+        luaL_checktype(L, -1, LUA_TTABLE);
+        lua_rawgeti(L, -1, 1);
+        e->gravityX = static_cast<float>(luaL_checknumber(L, -1));
+        lua_rawgeti(L, -2, 2);
+        e->gravityY = static_cast<float>(luaL_checknumber(L, -1));
+        lua_pop(L, 2);
+    }
+    lua_pop(L, 1);
+
+    lua_getfield(L, index, "blend");
+    if (!lua_isnil(L, -1)) {
+        const char* blend = luaL_checkstring(L, -1);
+        if (strcmp(blend, "additive") == 0) {
+            e->additive = true;
+        } else if (strcmp(blend, "alpha") == 0) {
+            e->additive = false;
+        } else {
+            luaL_error(L, "Invalid particle blend mode: %s", blend);
+        }
+    }
+    lua_pop(L, 1);
+
+    opt_curve(L, index, "sizes", e->sizes,
+        [](lua_State* L, int i) { return static_cast<float>(luaL_checknumber(L, i)); },
+        [](float a, float b, float t) { return a + (b - a) * t; });
+    opt_curve(L, index, "colors", e->colors,
+        [](lua_State* L, int i) { return color::check_color(L, i); },
+        [](Color a, Color b, float t) {
+            auto channel = [t](unsigned char from, unsigned char to) {
+                return static_cast<unsigned char>(from + (to - from) * t + 0.5f);
+            };
+            return Color{ channel(a.r, b.r), channel(a.g, b.g), channel(a.b, b.b), channel(a.a, b.a) };
+        });
+
+    if (e->lifetimeMin <= 0.0f) {
+        luaL_error(L, "Particle lifetime must be positive");
+    }
+    if (e->rate < 0.0f || e->drag < 0.0f || e->speedMin < 0.0f) {
+        luaL_error(L, "Particle rate, speed and drag must not be negative");
+    }
+}
+
+int create(lua_State* L) {
+    bool hasOptions = !lua_isnoneornil(L, 1);
+    if (hasOptions) {
+        luaL_checktype(L, 1, LUA_TTABLE);
+    }
+
+    int capacity = kDefaultCapacity;
+    if (hasOptions) {
+        lua_getfield(L, 1, "capacity");
+        capacity = lua_isnil(L, -1) ? capacity : luaL_checkinteger(L, -1);
+        lua_pop(L, 1);
+    }
+    if (capacity <= 0 || capacity > kMaxCapacity) {
+        luaL_error(L, "Particle capacity must be between 1 and %d", kMaxCapacity);
+    }
+
+    void* ud = lua_newuserdatatagged(L, sizeof(Emitter), kEmitterUserdataTag);
+    Emitter* e = new (ud) Emitter();
+    lua_getuserdatametatable(L, kEmitterUserdataTag);
+    lua_setmetatable(L, -2);
+
+    size_t padded = (static_cast<size_t>(capacity) + kLanes - 1) / kLanes * kLanes;
+    for (std::vector<float>* array : { &e->x, &e->y, &e->vx, &e->vy, &e->age, &e->aging }) {
+        array->assign(padded, 0.0f);
+    }
+    e->count = 0;
+    e->capacity = static_cast<size_t>(capacity);
+
+    e->originX = e->originY = 0.0f;
+    e->width = e->height = 0.0f;
+    e->rate = 100.0f;
+    e->pending = 0.0f;
+    e->lifetimeMin = e->lifetimeMax = 1.0f;
+    e->speedMin = e->speedMax = 100.0f;
+    e->direction = -90.0f;
+    e->spread = 360.0f;
+    e->gravityX = e->gravityY = 0.0f;
+    e->drag = 0.0f;
+    e->additive = false;
+    std::fill(std::begin(e->sizes), std::end(e->sizes), 8.0f);
+    std::fill(std::begin(e->colors), std::end(e->colors), WHITE);
+    // any odd seed, emitters created together should not move in lockstep
+    e->random = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(ud)) | 1;
+
+    if (hasOptions) {
+        configure(L, 1, e);
+    }
+
+    return 1;
+}
+
+Emitter* check_emitter(lua_State* L, int index) {
+    void* ud = lua_touserdatatagged(L, index, kEmitterUserdataTag);
+    if (!ud) {
+        luaL_typeerror(L, index, "Emitter");
+    }
+
+    Emitter* e = static_cast<Emitter*>(ud);
+    if (e->capacity == 0) {
+        luaL_error(L, "Emitter has been released");
+    }
+    return e;
+}
+
+int index(lua_State* L) {
+    const char* key = luaL_checkstring(L, 2);
+
+    for (auto& [name, func] : udata) {
+        if (name && strcmp(name, key) == 0) {
+            lua_pushcfunction(L, func, name);
+            return 1;
+        }
+    }
+
+    Emitter* e = check_emitter(L, 1);
+
+    if (strcmp(key, "count") == 0) {
+        lua_pushinteger(L, static_cast<int>(e->count));
+        return 1;
+    } else if (strcmp(key, "capacity") == 0) {
+        lua_pushinteger(L, static_cast<int>(e->capacity));
+        return 1;
+    } else if (strcmp(key, "x") == 0) {
+        lua_pushnumber(L, e->originX);
+        return 1;
+    } else if (strcmp(key, "y") == 0) {
+        lua_pushnumber(L, e->originY);
+        return 1;
+    }
+
+    luaL_error(L, "Attempt to access invalid Emitter property: %s", key);
+    return 0;
+}
+
+int set(lua_State* L) {
+    Emitter* e = check_emitter(L, 1);
+    configure(L, 2, e);
+    return 0;
+}
+
+int update(lua_State* L) {
+    Emitter* e = check_emitter(L, 1);
+    double dt = luaL_checknumber(L, 2);
+    if (dt < 0) {
+        luaL_error(L, "Particle time step must not be negative");
+    }
+
+    e->update(static_cast<float>(dt));
+    return 0;
+}
+
+int emit(lua_State* L) {
+    Emitter* e = check_emitter(L, 1);
+    int amount = luaL_checkinteger(L, 2);
+    if (amount < 0) {
+        luaL_error(L, "Particle count must not be negative");
+    }
+
+    e->spawn(static_cast<size_t>(amount));
+    return 0;
+}
+
+int draw(lua_State* L) {
+    WINDOW_NOT_INITIALIZED_CHECK();
+
+    Emitter* e = check_emitter(L, 1);
+
+    // the particles move every update, a recording would only hold one frame of them
+    if (drawlist::recording()) {
+        luaL_error(L, "Particles cannot be recorded into a draw list");
+    }
+    SOFTWARE_UNSUPPORTED_CHECK("Particles");
+
+    if (lua_isnoneornil(L, 2)) {
+        e->draw(nullptr, Rectangle{});
+        return 0;
+    }
+
+    texture::TextureRef* textureRef = texture::check_texture(L, 2);
+    e->draw(&textureRef->texture, textureRef->region);
+    return 0;
+}
+
+int clear(lua_State* L) {
+    Emitter* e = check_emitter(L, 1);
+    e->count = 0;
+    e->pending = 0.0f;
+    return 0;
+}
+
+int release(lua_State* L) {
+    void* ud = lua_touserdatatagged(L, 1, kEmitterUserdataTag);
+    if (!ud) {
+        luaL_typeerror(L, 1, "Emitter");
+    }
+
+    static_cast<Emitter*>(ud)->release();
+
+    return 0;
+}
+
+} // namespace particles
+
+
+int adoreregister_particles(lua_State* L)
+{
+    luaL_newmetatable(L, "Emitter");
+    lua_pushvalue(L, -1);
+    lua_setuserdatametatable(L, kEmitterUserdataTag);
+
+    lua_pushcfunction(L, particles::index, nullptr);
+    lua_setfield(L, -2, "__index");
+
+    lua_setreadonly(L, -1, true);
+
+    lua_setuserdatadtor(L, kEmitterUserdataTag,
+        [](lua_State* L, void* ud)
+        {
+            static_cast<particles::Emitter*>(ud)->~Emitter();
+        }
+    );
+
+    lua_pop(L, 1);
+
+    lua_createtable(L, 0, std::size(particles::lib));
+    luaL_register(L, nullptr, particles::lib); //
+    lua_setreadonly(L, -1, true);
+
+    return 1;
+}
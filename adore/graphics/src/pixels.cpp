@@ -0,0 +1,713 @@
+#include "adore/pixels.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include "raylib.h"
+
+#if ADORE_PIXELS_X86 && defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+namespace pixels {
+
+static Level detect() {
+#if ADORE_PIXELS_X86
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    // the OS has to save the upper halves of the registers too
+    if (osxsave && avx && (_xgetbv(0) & 6) == 6) {
+        __cpuidex(info, 7, 0);
+        if (info[1] & (1 << 5)) {
+            return Level::AVX2;
+        }
+    }
+#else
+    if (__builtin_cpu_supports("avx2")) {
+        return Level::AVX2;
+    }
+#endif
+    // part of x86-64 itself
+    return Level::SSE2;
+#else
+    return Level::SCALAR;
+#endif
+}
+
+static Level supported = detect();
+static Level active = supported;
+
+Level level() {
+    return active;
+}
+
+const char* level_name(Level level) {
+    switch (level) {
+    case Level::REFERENCE:
+        return "reference";
+    case Level::SCALAR:
+        return "scalar";
+    case Level::SSE2:
+        return "sse2";
+    case Level::AVX2:
+        return "avx2";
+    }
+    return "unknown";
+}
+
+void limit(Level level) {
+    active = std::min(level, supported);
+}
+
+// x / 255 rounded down, exact for x below 65535
+static inline unsigned int div255(unsigned int x) {
+    return (x + 1 + (x >> 8)) >> 8;
+}
+
+// Scalar kernels, also used for the tails the vector loops leave behind
+
+static void rgba_to_rgb_scalar(const unsigned char* source, unsigned char* destination, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        destination[i * 3] = source[i * 4];
+        destination[i * 3 + 1] = source[i * 4 + 1];
+        destination[i * 3 + 2] = source[i * 4 + 2];
+    }
+}
+
+static void rgb_to_rgba_scalar(const unsigned char* source, unsigned char* destination, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        destination[i * 4] = source[i * 3];
+        destination[i * 4 + 1] = source[i * 3 + 1];
+        destination[i * 4 + 2] = source[i * 3 + 2];
+        destination[i * 4 + 3] = 255;
+    }
+}
+
+// BT.601 luma in 8.8 fixed point, within one step of raylib's float weights
+static void rgba_to_gray_scalar(const unsigned char* source, unsigned char* destination, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        const unsigned char* p = source + i * 4;
+        destination[i] = static_cast<unsigned char>((77 * p[0] + 150 * p[1] + 29 * p[2] + 128) >> 8);
+    }
+}
+
+static void gray_to_rgba_scalar(const unsigned char* source, unsigned char* destination, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        unsigned char gray = source[i];
+        destination[i * 4] = gray;
+        destination[i * 4 + 1] = gray;
+        destination[i * 4 + 2] = gray;
+        destination[i * 4 + 3] = 255;
+    }
+}
+
+// rounds to nearest like raylib does
+static void rgba_to_r5g6b5_scalar(const unsigned char* source, unsigned char* destination, size_t count) {
+    uint16_t* out = reinterpret_cast<uint16_t*>(destination);
+    for (size_t i = 0; i < count; ++i) {
+        const unsigned char* p = source + i * 4;
+        unsigned int r = div255(p[0] * 31 + 127);
+        unsigned int g = div255(p[1] * 63 + 127);
+        unsigned int b = div255(p[2] * 31 + 127);
+        out[i] = static_cast<uint16_t>((r << 11) | (g << 5) | b);
+    }
+}
+
+// bit replication, so 31 and 63 map to 255
+static void r5g6b5_to_rgba_scalar(const unsigned char* source, unsigned char* destination, size_t count) {
+    const uint16_t* in = reinterpret_cast<const uint16_t*>(source);
+    for (size_t i = 0; i < count; ++i) {
+        unsigned int r = in[i] >> 11;
+        unsigned int g = (in[i] >> 5) & 63;
+        unsigned int b = in[i] & 31;
+        destination[i * 4] = static_cast<unsigned char>((r << 3) | (r >> 2));
+        destination[i * 4 + 1] = static_cast<unsigned char>((g << 2) | (g >> 4));
+        destination[i * 4 + 2] = static_cast<unsigned char>((b << 3) | (b >> 2));
+        destination[i * 4 + 3] = 255;
+    }
+}
+
+static void rgba_to_rgba32f_scalar(const unsigned char* source, unsigned char* destination, size_t count) {
+    float* out = reinterpret_cast<float*>(destination);
+    for (size_t i = 0; i < count * 4; ++i) {
+        out[i] = static_cast<float>(source[i]) / 255.0f;
+    }
+}
+
+// clamped, NaN becomes 0
+static void rgba32f_to_rgba_scalar(const unsigned char* source, unsigned char* destination, size_t count) {
+    const float* in = reinterpret_cast<const float*>(source);
+    for (size_t i = 0; i < count * 4; ++i) {
+        float value = in[i] * 255.0f;
+        value = value > 0.0f ? value : 0.0f;
+        value = value < 255.0f ? value : 255.0f;
+        destination[i] = static_cast<unsigned char>(value);
+    }
+}
+
+static void swizzle_scalar(const unsigned char* source, unsigned char* destination, size_t count, const unsigned char order[4]) {
+    for (size_t i = 0; i < count; ++i) {
+        const unsigned char* p = source + i * 4;
+        unsigned char pixel[4] = { p[order[0]], p[order[1]], p[order[2]], p[order[3]] };
+        memcpy(destination + i * 4, pixel, 4);
+    }
+}
+
+static void premultiply_scalar(const unsigned char* source, unsigned char* destination, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        const unsigned char* p = source + i * 4;
+        unsigned int a = p[3];
+        destination[i * 4] = static_cast<unsigned char>(div255(p[0] * a + 127));
+        destination[i * 4 + 1] = static_cast<unsigned char>(div255(p[1] * a + 127));
+        destination[i * 4 + 2] = static_cast<unsigned char>(div255(p[2] * a + 127));
+        destination[i * 4 + 3] = static_cast<unsigned char>(a);
+    }
+}
+
+static void unpremultiply_scalar(const unsigned char* source, unsigned char* destination, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        const unsigned char* p = source + i * 4;
+        unsigned int a = p[3];
+        for (int c = 0; c < 3; ++c) {
+            destination[i * 4 + c] = a == 0 ? 0 : static_cast<unsigned char>(std::min(255u, (p[c] * 255u + a / 2) / a));
+        }
+        destination[i * 4 + 3] = static_cast<unsigned char>(a);
+    }
+}
+
+#if ADORE_PIXELS_X86
+
+// Vector kernels return how many pixels they converted, the scalar ones do the rest.
+// Each iteration loads its whole block before storing, which keeps the shrinking
+// conversions safe in place.
+
+static inline __m128i div255_epu16(__m128i x) {
+    return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(x, _mm_set1_epi16(1)), _mm_srli_epi16(x, 8)), 8);
+}
+
+static inline __m128i gray4_sse2(__m128i pixels) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i weights = _mm_setr_epi16(77, 150, 29, 0, 77, 150, 29, 0);
+
+    // red and green, blue and alpha, summed per pixel
+    __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(pixels, zero), weights);
+    __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(pixels, zero), weights);
+    lo = _mm_add_epi32(lo, _mm_srli_epi64(lo, 32));
+    hi = _mm_add_epi32(hi, _mm_srli_epi64(hi, 32));
+
+    __m128i sums = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(2, 0, 2, 0)));
+    return _mm_srli_epi32(_mm_add_epi32(sums, _mm_set1_epi32(128)), 8);
+}
+
+static size_t rgba_to_gray_sse2(const unsigned char* source, unsigned char* destination, size_t count) {
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m128i* in = reinterpret_cast<const __m128i*>(source + i * 4);
+        __m128i a = gray4_sse2(_mm_loadu_si128(in));
+        __m128i b = gray4_sse2(_mm_loadu_si128(in + 1));
+        __m128i c = gray4_sse2(_mm_loadu_si128(in + 2));
+        __m128i d = gray4_sse2(_mm_loadu_si128(in + 3));
+        __m128i gray = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), gray);
+    }
+    return i;
+}
+
+static size_t gray_to_rgba_sse2(const unsigned char* source, unsigned char* destination, size_t count) {
+    const __m128i opaque = _mm_set1_epi8(static_cast<char>(0xFF));
+
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i gray = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+        __m128i grayGrayLo = _mm_unpacklo_epi8(gray, gray);
+        __m128i grayGrayHi = _mm_unpackhi_epi8(gray, gray);
+        __m128i grayAlphaLo = _mm_unpacklo_epi8(gray, opaque);
+        __m128i grayAlphaHi = _mm_unpackhi_epi8(gray, opaque);
+
+        __m128i* out = reinterpret_cast<__m128i*>(destination + i * 4);
+        _mm_storeu_si128(out, _mm_unpacklo_epi16(grayGrayLo, grayAlphaLo));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(grayGrayLo, grayAlphaLo));
+        _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(grayGrayHi, grayAlphaHi));
+        _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(grayGrayHi, grayAlphaHi));
+    }
+    return i;
+}
+
+static inline __m128i r5g6b5_sse2(__m128i first, __m128i second) {
+    const __m128i mask = _mm_set1_epi32(0xFF);
+    __m128i r = _mm_packs_epi32(_mm_and_si128(first, mask), _mm_and_si128(second, mask));
+    __m128i g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(first, 8), mask), _mm_and_si128(_mm_srli_epi32(second, 8), mask));
+    __m128i b = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(first, 16), mask), _mm_and_si128(_mm_srli_epi32(second, 16), mask));
+
+    const __m128i half = _mm_set1_epi16(127);
+    r = div255_epu16(_mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(31)), half));
+    g = div255_epu16(_mm_add_epi16(_mm_mullo_epi16(g, _mm_set1_epi16(63)), half));
+    b = div255_epu16(_mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(31)), half));
+
+    return _mm_or_si128(_mm_slli_epi16(r, 11), _mm_or_si128(_mm_slli_epi16(g, 5), b));
+}
+
+static size_t rgba_to_r5g6b5_sse2(const unsigned char* source, unsigned char* destination, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i* in = reinterpret_cast<const __m128i*>(source + i * 4);
+        __m128i packed = r5g6b5_sse2(_mm_loadu_si128(in), _mm_loadu_si128(in + 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i * 2), packed);
+    }
+    return i;
+}
+
+static size_t r5g6b5_to_rgba_sse2(const unsigned char* source, unsigned char* destination, size_t count) {
+    const __m128i six = _mm_set1_epi16(63);
+    const __m128i five = _mm_set1_epi16(31);
+    const __m128i opaque = _mm_set1_epi16(static_cast<short>(0xFF00));
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * 2));
+        __m128i r = _mm_srli_epi16(packed, 11);
+        __m128i g = _mm_and_si128(_mm_srli_epi16(packed, 5), six);
+        __m128i b = _mm_and_si128(packed, five);
+        r = _mm_or_si128(_mm_slli_epi16(r, 3), _mm_srli_epi16(r, 2));
+        g = _mm_or_si128(_mm_slli_epi16(g, 2), _mm_srli_epi16(g, 4));
+        b = _mm_or_si128(_mm_slli_epi16(b, 3), _mm_srli_epi16(b, 2));
+
+        __m128i redGreen = _mm_or_si128(r, _mm_slli_epi16(g, 8));
+        __m128i blueAlpha = _mm_or_si128(b, opaque);
+
+        __m128i* out = reinterpret_cast<__m128i*>(destination + i * 4);
+        _mm_storeu_si128(out, _mm_unpacklo_epi16(redGreen, blueAlpha));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(redGreen, blueAlpha));
+    }
+    return i;
+}
+
+static size_t rgba_to_rgba32f_sse2(const unsigned char* source, unsigned char* destination, size_t count) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 scale = _mm_set1_ps(255.0f);
+    float* out = reinterpret_cast<float*>(destination);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * 4));
+        __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+        __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+        // divided rather than scaled by the reciprocal, to match the scalar result exactly
+        _mm_storeu_ps(out + i * 4, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), scale));
+        _mm_storeu_ps(out + i * 4 + 4, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), scale));
+        _mm_storeu_ps(out + i * 4 + 8, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), scale));
+        _mm_storeu_ps(out + i * 4 + 12, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), scale));
+    }
+    return i;
+}
+
+static inline __m128i quantize_sse2(__m128 value) {
+    value = _mm_mul_ps(value, _mm_set1_ps(255.0f));
+    // max returns its second operand for NaN
+    value = _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(255.0f));
+    return _mm_cvttps_epi32(value);
+}
+
+static size_t rgba32f_to_rgba_sse2(const unsigned char* source, unsigned char* destination, size_t count) {
+    const float* in = reinterpret_cast<const float*>(source);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i a = quantize_sse2(_mm_loadu_ps(in + i * 4));
+        __m128i b = quantize_sse2(_mm_loadu_ps(in + i * 4 + 4));
+        __m128i c = quantize_sse2(_mm_loadu_ps(in + i * 4 + 8));
+        __m128i d = quantize_sse2(_mm_loadu_ps(in + i * 4 + 12));
+        __m128i bytes = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i * 4), bytes);
+    }
+    return i;
+}
+
+static inline __m128i premultiply2_sse2(__m128i pixels) {
+    // colors are scaled by alpha, alpha by 255 which leaves it as it is
+    const __m128i colors = _mm_setr_epi16(-1, -1, -1, 0, -1, -1, -1, 0);
+    const __m128i opaque = _mm_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255);
+
+    __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(pixels, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    __m128i factor = _mm_or_si128(_mm_and_si128(alpha, colors), opaque);
+    return div255_epu16(_mm_add_epi16(_mm_mullo_epi16(pixels, factor), _mm_set1_epi16(127)));
+}
+
+static size_t premultiply_sse2(const unsigned char* source, unsigned char* destination, size_t count) {
+    const __m128i zero = _mm_setzero_si128();
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * 4));
+        __m128i lo = premultiply2_sse2(_mm_unpacklo_epi8(bytes, zero));
+        __m128i hi = premultiply2_sse2(_mm_unpackhi_epi8(bytes, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i * 4), _mm_packus_epi16(lo, hi));
+    }
+    return i;
+}
+
+// One pixel per 32-bit lane group. Float division is exact enough here: below
+// 256 a quotient is never within an ulp of the next integer.
+static inline __m128i unpremultiply1_sse2(__m128i pixel) {
+    const __m128i alphaLane = _mm_setr_epi32(0, 0, 0, -1);
+
+    __m128i alpha = _mm_shuffle_epi32(pixel, _MM_SHUFFLE(3, 3, 3, 3));
+    __m128 alphaFloat = _mm_cvtepi32_ps(alpha);
+    __m128 numerator = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(pixel), _mm_set1_ps(255.0f)), _mm_cvtepi32_ps(_mm_srli_epi32(alpha, 1)));
+    __m128 quotient = _mm_min_ps(_mm_div_ps(numerator, alphaFloat), _mm_set1_ps(255.0f));
+
+    // transparent pixels go to 0, whatever the division made of them
+    __m128i color = _mm_and_si128(_mm_cvttps_epi32(quotient), _mm_castps_si128(_mm_cmpneq_ps(alphaFloat, _mm_setzero_ps())));
+    return _mm_or_si128(_mm_andnot_si128(alphaLane, color), _mm_and_si128(alphaLane, pixel));
+}
+
+static size_t unpremultiply_sse2(const unsigned char* source, unsigned char* destination, size_t count) {
+    const __m128i zero = _mm_setzero_si128();
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * 4));
+        __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+        __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+        __m128i a = unpremultiply1_sse2(_mm_unpacklo_epi16(lo, zero));
+        __m128i b = unpremultiply1_sse2(_mm_unpackhi_epi16(lo, zero));
+        __m128i c = unpremultiply1_sse2(_mm_unpacklo_epi16(hi, zero));
+        __m128i d = unpremultiply1_sse2(_mm_unpackhi_epi16(hi, zero));
+        __m128i result = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i * 4), result);
+    }
+    return i;
+}
+
+// AVX2 works on two 128-bit lanes, packs interleave them so most kernels end
+// with a permute to put the pixels back in order.
+
+ADORE_TARGET_AVX2 static inline __m256i div255_epu16_avx2(__m256i x) {
+    return _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(x, _mm256_set1_epi16(1)), _mm256_srli_epi16(x, 8)), 8);
+}
+
+ADORE_TARGET_AVX2 static size_t rgba_to_rgb_avx2(const unsigned char* source, unsigned char* destination, size_t count) {
+    const __m256i drop = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                          0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    const __m256i join = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i * 4));
+        pixels = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(pixels, drop), join);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i * 3), _mm256_castsi256_si128(pixels));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(destination + i * 3 + 16), _mm256_extracti128_si256(pixels, 1));
+    }
+    return i;
+}
+
+ADORE_TARGET_AVX2 static size_t rgb_to_rgba_avx2(const unsigned char* source, unsigned char* destination, size_t count) {
+    const __m256i spread = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                            0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m256i opaque = _mm256_set1_epi32(static_cast<int>(0xFF000000));
+
+    // the second load reads four bytes past the eight pixels, stay clear of the end
+    size_t i = 0;
+    for (; i + 10 <= count; i += 8) {
+        __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * 3));
+        __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * 3 + 12));
+        __m256i pixels = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+        pixels = _mm256_or_si256(_mm256_shuffle_epi8(pixels, spread), opaque);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i * 4), pixels);
+    }
+    return i;
+}
+
+ADORE_TARGET_AVX2 static inline __m256i gray8_avx2(__m256i pixels) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i weights = _mm256_setr_epi16(77, 150, 29, 0, 77, 150, 29, 0, 77, 150, 29, 0, 77, 150, 29, 0);
+
+    __m256i lo = _mm256_madd_epi16(_mm256_unpacklo_epi8(pixels, zero), weights);
+    __m256i hi = _mm256_madd_epi16(_mm256_unpackhi_epi8(pixels, zero), weights);
+    lo = _mm256_add_epi32(lo, _mm256_srli_epi64(lo, 32));
+    hi = _mm256_add_epi32(hi, _mm256_srli_epi64(hi, 32));
+
+    __m256i sums = _mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(lo), _mm256_castsi256_ps(hi), _MM_SHUFFLE(2, 0, 2, 0)));
+    return _mm256_srli_epi32(_mm256_add_epi32(sums, _mm256_set1_epi32(128)), 8);
+}
+
+ADORE_TARGET_AVX2 static size_t rgba_to_gray_avx2(const unsigned char* source, unsigned char* destination, size_t count) {
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        const __m256i* in = reinterpret_cast<const __m256i*>(source + i * 4);
+        __m256i a = gray8_avx2(_mm256_loadu_si256(in));
+        __m256i b = gray8_avx2(_mm256_loadu_si256(in + 1));
+        __m256i c = gray8_avx2(_mm256_loadu_si256(in + 2));
+        __m256i d = gray8_avx2(_mm256_loadu_si256(in + 3));
+        __m256i gray = _mm256_packus_epi16(_mm256_packs_epi32(a, b), _mm256_packs_epi32(c, d));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i), _mm256_permutevar8x32_epi32(gray, order));
+    }
+    return i;
+}
+
+ADORE_TARGET_AVX2 static size_t rgba_to_r5g6b5_avx2(const unsigned char* source, unsigned char* destination, size_t count) {
+    const __m256i mask = _mm256_set1_epi32(0xFF);
+    const __m256i half = _mm256_set1_epi16(127);
+
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m256i* in = reinterpret_cast<const __m256i*>(source + i * 4);
+        __m256i first = _mm256_loadu_si256(in);
+        __m256i second = _mm256_loadu_si256(in + 1);
+
+        __m256i r = _mm256_packs_epi32(_mm256_and_si256(first, mask), _mm256_and_si256(second, mask));
+        __m256i g = _mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(first, 8), mask), _mm256_and_si256(_mm256_srli_epi32(second, 8), mask));
+        __m256i b = _mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(first, 16), mask), _mm256_and_si256(_mm256_srli_epi32(second, 16), mask));
+
+        r = div255_epu16_avx2(_mm256_add_epi16(_mm256_mullo_epi16(r, _mm256_set1_epi16(31)), half));
+        g = div255_epu16_avx2(_mm256_add_epi16(_mm256_mullo_epi16(g, _mm256_set1_epi16(63)), half));
+        b = div255_epu16_avx2(_mm256_add_epi16(_mm256_mullo_epi16(b, _mm256_set1_epi16(31)), half));
+
+        __m256i packed = _mm256_or_si256(_mm256_slli_epi16(r, 11), _mm256_or_si256(_mm256_slli_epi16(g, 5), b));
+        packed = _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i * 2), packed);
+    }
+    return i;
+}
+
+ADORE_TARGET_AVX2 static size_t r5g6b5_to_rgba_avx2(const unsigned char* source, unsigned char* destination, size_t count) {
+    const __m256i six = _mm256_set1_epi16(63);
+    const __m256i five = _mm256_set1_epi16(31);
+    const __m256i opaque = _mm256_set1_epi16(static_cast<short>(0xFF00));
+
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i packed = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i * 2));
+        __m256i r = _mm256_srli_epi16(packed, 11);
+        __m256i g = _mm256_and_si256(_mm256_srli_epi16(packed, 5), six);
+        __m256i b = _mm256_and_si256(packed, five);
+        r = _mm256_or_si256(_mm256_slli_epi16(r, 3), _mm256_srli_epi16(r, 2));
+        g = _mm256_or_si256(_mm256_slli_epi16(g, 2), _mm256_srli_epi16(g, 4));
+        b = _mm256_or_si256(_mm256_slli_epi16(b, 3), _mm256_srli_epi16(b, 2));
+
+        __m256i redGreen = _mm256_or_si256(r, _mm256_slli_epi16(g, 8));
+        __m256i blueAlpha = _mm256_or_si256(b, opaque);
+        __m256i lo = _mm256_unpacklo_epi16(redGreen, blueAlpha);
+        __m256i hi = _mm256_unpackhi_epi16(redGreen, blueAlpha);
+
+        __m256i* out = reinterpret_cast<__m256i*>(destination + i * 4);
+        _mm256_storeu_si256(out, _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256(out + 1, _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+    return i;
+}
+
+ADORE_TARGET_AVX2 static size_t rgba_to_rgba32f_avx2(const unsigned char* source, unsigned char* destination, size_t count) {
+    const __m256 scale = _mm256_set1_ps(255.0f);
+    float* out = reinterpret_cast<float*>(destination);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        for (int part = 0; part < 4; ++part) {
+            __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(source + i * 4 + part * 8));
+            __m256 values = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes));
+            _mm256_storeu_ps(out + i * 4 + part * 8, _mm256_div_ps(values, scale));
+        }
+    }
+    return i;
+}
+
+ADORE_TARGET_AVX2 static inline __m256i quantize_avx2(__m256 value) {
+    value = _mm256_mul_ps(value, _mm256_set1_ps(255.0f));
+    value = _mm256_min_ps(_mm256_max_ps(value, _mm256_setzero_ps()), _mm256_set1_ps(255.0f));
+    return _mm256_cvttps_epi32(value);
+}
+
+ADORE_TARGET_AVX2 static size_t rgba32f_to_rgba_avx2(const unsigned char* source, unsigned char* destination, size_t count) {
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    const float* in = reinterpret_cast<const float*>(source);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i a = quantize_avx2(_mm256_loadu_ps(in + i * 4));
+        __m256i b = quantize_avx2(_mm256_loadu_ps(in + i * 4 + 8));
+        __m256i c = quantize_avx2(_mm256_loadu_ps(in + i * 4 + 16));
+        __m256i d = quantize_avx2(_mm256_loadu_ps(in + i * 4 + 24));
+        __m256i bytes = _mm256_packus_epi16(_mm256_packs_epi32(a, b), _mm256_packs_epi32(c, d));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i * 4), _mm256_permutevar8x32_epi32(bytes, order));
+    }
+    return i;
+}
+
+ADORE_TARGET_AVX2 static size_t swizzle_avx2(const unsigned char* source, unsigned char* destination, size_t count, const unsigned char order[4]) {
+    alignas(32) char indices[32];
+    for (int i = 0; i < 32; ++i) {
+        indices[i] = static_cast<char>((i & ~3) + order[i & 3]);
+    }
+    const __m256i shuffle = _mm256_load_si256(reinterpret_cast<const __m256i*>(indices));
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i * 4));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i * 4), _mm256_shuffle_epi8(pixels, shuffle));
+    }
+    return i;
+}
+
+ADORE_TARGET_AVX2 static inline __m256i premultiply4_avx2(__m256i pixels) {
+    const __m256i colors = _mm256_setr_epi16(-1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1, 0);
+    const __m256i opaque = _mm256_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255);
+
+    __m256i alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(pixels, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    __m256i factor = _mm256_or_si256(_mm256_and_si256(alpha, colors), opaque);
+    return div255_epu16_avx2(_mm256_add_epi16(_mm256_mullo_epi16(pixels, factor), _mm256_set1_epi16(127)));
+}
+
+ADORE_TARGET_AVX2 static size_t premultiply_avx2(const unsigned char* source, unsigned char* destination, size_t count) {
+    const __m256i zero = _mm256_setzero_si256();
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i * 4));
+        __m256i lo = premultiply4_avx2(_mm256_unpacklo_epi8(bytes, zero));
+        __m256i hi = premultiply4_avx2(_mm256_unpackhi_epi8(bytes, zero));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i * 4), _mm256_packus_epi16(lo, hi));
+    }
+    return i;
+}
+
+ADORE_TARGET_AVX2 static inline __m256i unpremultiply2_avx2(__m128i bytes) {
+    const __m256i alphaLane = _mm256_setr_epi32(0, 0, 0, -1, 0, 0, 0, -1);
+
+    __m256i pixel = _mm256_cvtepu8_epi32(bytes);
+    __m256i alpha = _mm256_shuffle_epi32(pixel, _MM_SHUFFLE(3, 3, 3, 3));
+    __m256 alphaFloat = _mm256_cvtepi32_ps(alpha);
+    __m256 numerator = _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(pixel), _mm256_set1_ps(255.0f)), _mm256_cvtepi32_ps(_mm256_srli_epi32(alpha, 1)));
+    __m256 quotient = _mm256_min_ps(_mm256_div_ps(numerator, alphaFloat), _mm256_set1_ps(255.0f));
+
+    __m256i color = _mm256_and_si256(_mm256_cvttps_epi32(quotient), _mm256_castps_si256(_mm256_cmp_ps(alphaFloat, _mm256_setzero_ps(), _CMP_NEQ_UQ)));
+    return _mm256_or_si256(_mm256_andnot_si256(alphaLane, color), _mm256_and_si256(alphaLane, pixel));
+}
+
+ADORE_TARGET_AVX2 static size_t unpremultiply_avx2(const unsigned char* source, unsigned char* destination, size_t count) {
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const unsigned char* in = source + i * 4;
+        __m256i a = unpremultiply2_avx2(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(in)));
+        __m256i b = unpremultiply2_avx2(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(in + 8)));
+        __m256i c = unpremultiply2_avx2(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(in + 16)));
+        __m256i d = unpremultiply2_avx2(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(in + 24)));
+        __m256i result = _mm256_packus_epi16(_mm256_packs_epi32(a, b), _mm256_packs_epi32(c, d));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i * 4), _mm256_permutevar8x32_epi32(result, order));
+    }
+    return i;
+}
+
+#endif
+
+using Kernel = void (*)(const unsigned char*, unsigned char*, size_t);
+using VectorKernel = size_t (*)(const unsigned char*, unsigned char*, size_t);
+
+struct Conversion {
+    int from;
+    int to;
+    // source and destination bytes per pixel
+    size_t in;
+    size_t out;
+    Kernel scalar;
+#if ADORE_PIXELS_X86
+    VectorKernel sse2;
+    VectorKernel avx2;
+#endif
+};
+
+#if ADORE_PIXELS_X86
+#define ADORE_KERNELS(scalar, sse2, avx2) scalar, sse2, avx2
+#else
+#define ADORE_KERNELS(scalar, sse2, avx2) scalar
+#endif
+
+static const Conversion conversions[] = {
+    { PIXELFORMAT_UNCOMPRESSED_R8G8B8A8, PIXELFORMAT_UNCOMPRESSED_R8G8B8, 4, 3, ADORE_KERNELS(rgba_to_rgb_scalar, nullptr, rgba_to_rgb_avx2) },
+    { PIXELFORMAT_UNCOMPRESSED_R8G8B8, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8, 3, 4, ADORE_KERNELS(rgb_to_rgba_scalar, nullptr, rgb_to_rgba_avx2) },
+    { PIXELFORMAT_UNCOMPRESSED_R8G8B8A8, PIXELFORMAT_UNCOMPRESSED_GRAYSCALE, 4, 1, ADORE_KERNELS(rgba_to_gray_scalar, rgba_to_gray_sse2, rgba_to_gray_avx2) },
+    { PIXELFORMAT_UNCOMPRESSED_GRAYSCALE, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8, 1, 4, ADORE_KERNELS(gray_to_rgba_scalar, gray_to_rgba_sse2, gray_to_rgba_sse2) },
+    { PIXELFORMAT_UNCOMPRESSED_R8G8B8A8, PIXELFORMAT_UNCOMPRESSED_R5G6B5, 4, 2, ADORE_KERNELS(rgba_to_r5g6b5_scalar, rgba_to_r5g6b5_sse2, rgba_to_r5g6b5_avx2) },
+    { PIXELFORMAT_UNCOMPRESSED_R5G6B5, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8, 2, 4, ADORE_KERNELS(r5g6b5_to_rgba_scalar, r5g6b5_to_rgba_sse2, r5g6b5_to_rgba_avx2) },
+    { PIXELFORMAT_UNCOMPRESSED_R8G8B8A8, PIXELFORMAT_UNCOMPRESSED_R32G32B32A32, 4, 16, ADORE_KERNELS(rgba_to_rgba32f_scalar, rgba_to_rgba32f_sse2, rgba_to_rgba32f_avx2) },
+    { PIXELFORMAT_UNCOMPRESSED_R32G32B32A32, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8, 16, 4, ADORE_KERNELS(rgba32f_to_rgba_scalar, rgba32f_to_rgba_sse2, rgba32f_to_rgba_avx2) },
+};
+
+#undef ADORE_KERNELS
+
+static const Conversion* find(int from, int to) {
+    for (const Conversion& conversion : conversions) {
+        if (conversion.from == from && conversion.to == to) {
+            return &conversion;
+        }
+    }
+    return nullptr;
+}
+
+bool can_convert(int from, int to) {
+    return active != Level::REFERENCE && find(from, to) != nullptr;
+}
+
+void convert(const void* source, int from, void* destination, int to, size_t count) {
+    const Conversion* conversion = find(from, to);
+    const unsigned char* in = static_cast<const unsigned char*>(source);
+    unsigned char* out = static_cast<unsigned char*>(destination);
+
+    size_t done = 0;
+#if ADORE_PIXELS_X86
+    if (active >= Level::AVX2 && conversion->avx2) {
+        done = conversion->avx2(in, out, count);
+    } else if (active >= Level::SSE2 && conversion->sse2) {
+        done = conversion->sse2(in, out, count);
+    }
+#endif
+
+    conversion->scalar(in + done * conversion->in, out + done * conversion->out, count - done);
+}
+
+void swizzle(const unsigned char* source, unsigned char* destination, size_t count, const unsigned char order[4]) {
+    size_t done = 0;
+#if ADORE_PIXELS_X86
+    // byte shuffles only arrived with SSSE3, SSE2 machines take the scalar path
+    if (active >= Level::AVX2) {
+        done = swizzle_avx2(source, destination, count, order);
+    }
+#endif
+
+    swizzle_scalar(source + done * 4, destination + done * 4, count - done, order);
+}
+
+void premultiply(const unsigned char* source, unsigned char* destination, size_t count) {
+    size_t done = 0;
+#if ADORE_PIXELS_X86
+    if (active >= Level::AVX2) {
+        done = premultiply_avx2(source, destination, count);
+    } else if (active >= Level::SSE2) {
+        done = premultiply_sse2(source, destination, count);
+    }
+#endif
+
+    premultiply_scalar(source + done * 4, destination + done * 4, count - done);
+}
+
+void unpremultiply(const unsigned char* source, unsigned char* destination, size_t count) {
+    size_t done = 0;
+#if ADORE_PIXELS_X86
+    if (active >= Level::AVX2) {
+        done = unpremultiply_avx2(source, destination, count);
+    } else if (active >= Level::SSE2) {
+        done = unpremultiply_sse2(source, destination, count);
+    }
+#endif
+
+    unpremultiply_scalar(source + done * 4, destination + done * 4, count - done);
+}
+
+} // namespace pixels
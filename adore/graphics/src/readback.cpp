@@ -0,0 +1,159 @@
+#include "adore/readback.h"
+
+#include "adore/metrics.h"
+#include <cstring>
+#include <deque>
+#include "raylib.h"
+#include "rlgl.h"
+#include "external/glad.h"
+
+namespace readback {
+
+// Enough to keep two frames of readbacks in flight while the oldest completes
+constexpr size_t kRingSize = 3;
+
+constexpr int kBytesPerPixel = 4;
+
+struct Slot {
+    GLuint buffer = 0;
+    size_t capacity = 0;
+};
+
+struct Pending {
+    size_t slot;
+    GLsync fence;
+    int width;
+    int height;
+    Callback done;
+};
+
+struct ReadbackState {
+    Slot slots[kRingSize];
+    size_t next = 0;
+    // oldest first, they complete in the order they were requested
+    std::deque<Pending> pending;
+
+    metrics::Counter& requested = metrics::counter("adore_graphics_readbacks_total", "Asynchronous framebuffer readbacks requested");
+    metrics::Counter& stalls = metrics::counter("adore_graphics_readback_stalls_total", "Readbacks that had to wait for an older one because the ring was full");
+};
+
+static ReadbackState& state() {
+    static ReadbackState instance;
+    return instance;
+}
+
+static void finish(ReadbackState& s, Pending& entry) {
+    Slot& slot = s.slots[entry.slot];
+    size_t size = static_cast<size_t>(entry.width) * entry.height * kBytesPerPixel;
+
+    glDeleteSync(entry.fence);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, static_cast<GLsizeiptr>(size), GL_MAP_READ_BIT);
+    entry.done(static_cast<const unsigned char*>(pixels), entry.width, entry.height);
+    if (pixels) {
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+bool supported() {
+    // fences and mappable pack buffers need OpenGL 3.3
+    int version = rlGetVersion();
+    return version == RL_OPENGL_33 || version == RL_OPENGL_43;
+}
+
+bool request(unsigned int framebuffer, int width, int height, Callback done) {
+    if (!supported()) {
+        return false;
+    }
+
+    ReadbackState& s = state();
+    size_t index = s.next;
+    s.next = (s.next + 1) % kRingSize;
+
+    // the ring is full, the oldest readback has to complete before its buffer is reused
+    if (!s.pending.empty() && s.pending.size() >= kRingSize) {
+        Pending& oldest = s.pending.front();
+        glClientWaitSync(oldest.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        finish(s, oldest);
+        s.pending.pop_front();
+        s.stalls.add();
+    }
+
+    // whatever is still batched has to reach the framebuffer before it is read
+    rlDrawRenderBatchActive();
+
+    Slot& slot = s.slots[index];
+    size_t size = static_cast<size_t>(width) * height * kBytesPerPixel;
+
+    if (slot.buffer == 0) {
+        glGenBuffers(1, &slot.buffer);
+    }
+
+    GLint previous = 0;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previous);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    if (slot.capacity < size) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(size), nullptr, GL_STREAM_READ);
+        slot.capacity = size;
+    }
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, static_cast<GLuint>(previous));
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    s.pending.push_back(Pending{index, fence, width, height, std::move(done)});
+    s.requested.add();
+
+    return true;
+}
+
+void copy_flipped(const unsigned char* pixels, int width, int height, unsigned char* destination) {
+    size_t rowBytes = static_cast<size_t>(width) * kBytesPerPixel;
+    for (int row = 0; row < height; ++row) {
+        memcpy(destination + rowBytes * row, pixels + rowBytes * (height - 1 - row), rowBytes);
+    }
+}
+
+void update() {
+    ReadbackState& s = state();
+
+    while (!s.pending.empty()) {
+        Pending& oldest = s.pending.front();
+        GLenum status = glClientWaitSync(oldest.fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+            break;
+        }
+
+        // callbacks may request more readbacks, take the entry off the queue first
+        Pending entry = std::move(oldest);
+        s.pending.pop_front();
+        finish(s, entry);
+    }
+}
+
+void shutdown() {
+    ReadbackState& s = state();
+
+    while (!s.pending.empty()) {
+        Pending entry = std::move(s.pending.front());
+        s.pending.pop_front();
+        glDeleteSync(entry.fence);
+        entry.done(nullptr, entry.width, entry.height);
+    }
+
+    for (Slot& slot : s.slots) {
+        if (slot.buffer != 0) {
+            glDeleteBuffers(1, &slot.buffer);
+            slot = Slot{};
+        }
+    }
+}
+
+} // namespace readback
@@ -0,0 +1,588 @@
+#include "adore/recorder.h"
+
+#include "adore/readback.h"
+#include "adore/rendertexture.h"
+#include "adore/window.h"
+#include "adore/metrics.h"
+#include "adore/scheduler.h"
+#include <algorithm>
+#include <cctype>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "raylib.h"
+
+namespace recorder {
+
+constexpr int kBytesPerPixel = 4;
+
+// a little over the readback ring, enough to ride out a slow write or two
+constexpr int kDefaultQueue = 8;
+
+constexpr int kMaxWriters = 16;
+
+enum class Format {
+    Y4M,
+    RGBA,
+    PNG,
+};
+
+enum class Policy {
+    DROP,
+    BLOCK,
+};
+
+static const std::pair<const char*, Format> formats[] = {
+    { "y4m", Format::Y4M },
+    { "rgba", Format::RGBA },
+    { "png", Format::PNG },
+};
+
+static const std::pair<const char*, Policy> policies[] = {
+    { "drop", Policy::DROP },
+    { "block", Policy::BLOCK },
+};
+
+struct Frame {
+    // position in the output, dropped frames never get one
+    uint64_t index;
+    // rows bottom to top, as they were read back
+    std::vector<unsigned char> pixels;
+};
+
+struct Session {
+    Format format;
+    Policy policy;
+    std::string path;
+    int width;
+    int height;
+    size_t capacity;
+    FILE* file = nullptr;
+
+    // render texture being recorded, nullptr for the screen
+    RenderTexture* target = nullptr;
+    int targetRef = LUA_NOREF;
+
+    // main thread only
+    size_t inflight = 0;
+    bool stopping = false;
+    scheduler::Token token;
+
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::condition_variable space;
+    std::deque<Frame> queue;
+    std::vector<std::vector<unsigned char>> spare;
+    uint64_t queued = 0;
+    uint64_t written = 0;
+    uint64_t dropped = 0;
+    bool closing = false;
+    bool failed = false;
+    size_t finished = 0;
+
+    // sequential formats write frames in queue order, whichever writer encoded them
+    std::mutex fileMutex;
+    std::condition_variable turn;
+    uint64_t nextWrite = 0;
+
+    std::vector<std::thread> writers;
+};
+
+struct RecorderState {
+    std::shared_ptr<Session> active;
+    // stopped sessions still writing out their queue
+    std::vector<std::shared_ptr<Session>> draining;
+
+    metrics::Counter& written = metrics::counter("adore_graphics_recorded_frames_total", "Frames handed to the recorder", metrics::label("result", "written"));
+    metrics::Counter& dropped = metrics::counter("adore_graphics_recorded_frames_total", "Frames handed to the recorder", metrics::label("result", "dropped"));
+};
+
+static RecorderState& state() {
+    static RecorderState instance;
+    return instance;
+}
+
+static bool is_sequential(Format format) {
+    return format != Format::PNG;
+}
+
+// png sequences need one integer conversion for the frame number, like frames/%05d.png
+static bool is_sequence_pattern(const char* path) {
+    const char* percent = strchr(path, '%');
+    if (!percent) {
+        return false;
+    }
+
+    const char* conversion = percent + 1;
+    while (isdigit(static_cast<unsigned char>(*conversion))) {
+        conversion++;
+    }
+
+    return *conversion == 'd' && strchr(conversion, '%') == nullptr;
+}
+
+static void drop(Session& s) {
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.dropped++;
+    state().dropped.add();
+}
+
+static const unsigned char* row_of(const std::vector<unsigned char>& pixels, int width, int height, int row) {
+    return pixels.data() + static_cast<size_t>(width) * kBytesPerPixel * (height - 1 - row);
+}
+
+// BT.709 limited range with 2x2 averaged chroma in the 420jpeg layout. The header
+// tags the range with XCOLORRANGE=LIMITED, Y4M has no tag for the BT.709 matrix.
+static void encode_y4m(const Frame& frame, int width, int height, std::vector<unsigned char>& out) {
+    static const char kFrameHeader[] = "FRAME\n";
+    constexpr size_t kHeaderLength = sizeof(kFrameHeader) - 1;
+
+    int chromaWidth = (width + 1) / 2;
+    int chromaHeight = (height + 1) / 2;
+    size_t lumaSize = static_cast<size_t>(width) * height;
+    size_t chromaSize = static_cast<size_t>(chromaWidth) * chromaHeight;
+
+    out.resize(kHeaderLength + lumaSize + chromaSize * 2);
+    memcpy(out.data(), kFrameHeader, kHeaderLength);
+    unsigned char* y = out.data() + kHeaderLength;
+    unsigned char* u = y + lumaSize;
+    unsigned char* v = u + chromaSize;
+
+    for (int row = 0; row < height; ++row) {
+        const unsigned char* source = row_of(frame.pixels, width, height, row);
+        unsigned char* luma = y + static_cast<size_t>(width) * row;
+        for (int x = 0; x < width; ++x, source += kBytesPerPixel) {
+            luma[x] = static_cast<unsigned char>(((47 * source[0] + 157 * source[1] + 16 * source[2] + 128) >> 8) + 16);
+        }
+    }
+
+    for (int row = 0; row < chromaHeight; ++row) {
+        const unsigned char* top = row_of(frame.pixels, width, height, row * 2);
+        const unsigned char* bottom = row_of(frame.pixels, width, height, std::min(row * 2 + 1, height - 1));
+        size_t offset = static_cast<size_t>(chromaWidth) * row;
+
+        for (int x = 0; x < chromaWidth; ++x) {
+            size_t left = static_cast<size_t>(x) * 2 * kBytesPerPixel;
+            size_t right = static_cast<size_t>(std::min(x * 2 + 1, width - 1)) * kBytesPerPixel;
+
+            int r = (top[left] + top[right] + bottom[left] + bottom[right] + 2) >> 2;
+            int g = (top[left + 1] + top[right + 1] + bottom[left + 1] + bottom[right + 1] + 2) >> 2;
+            int b = (top[left + 2] + top[right + 2] + bottom[left + 2] + bottom[right + 2] + 2) >> 2;
+
+            // biased by 128 << 8 so the shift never sees a negative value
+            u[offset + x] = static_cast<unsigned char>((-26 * r - 87 * g + 112 * b + 32896) >> 8);
+            v[offset + x] = static_cast<unsigned char>((112 * r - 102 * g - 10 * b + 32896) >> 8);
+        }
+    }
+}
+
+static void encode_rgba(const Frame& frame, int width, int height, std::vector<unsigned char>& out) {
+    out.resize(frame.pixels.size());
+    readback::copy_flipped(frame.pixels.data(), width, height, out.data());
+}
+
+static bool write_png(const Session& s, const Frame& frame, std::vector<unsigned char>& scratch) {
+    encode_rgba(frame, s.width, s.height, scratch);
+
+    char filename[1024];
+    snprintf(filename, sizeof(filename), s.path.c_str(), static_cast<int>(frame.index));
+
+    Image image = { scratch.data(), s.width, s.height, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 };
+    return ExportImage(image, filename);
+}
+
+static void write_frames(Session& s) {
+    std::vector<unsigned char> encoded;
+
+    for (;;) {
+        Frame frame;
+        bool failed;
+        {
+            std::unique_lock<std::mutex> lock(s.mutex);
+            s.ready.wait(lock, [&s]() { return s.closing || !s.queue.empty(); });
+            if (s.queue.empty()) {
+                s.finished++;
+                return;
+            }
+
+            frame = std::move(s.queue.front());
+            s.queue.pop_front();
+            failed = s.failed;
+        }
+        s.space.notify_one();
+
+        bool ok = !failed;
+        if (ok) {
+            switch (s.format) {
+            case Format::Y4M:
+                encode_y4m(frame, s.width, s.height, encoded);
+                break;
+            case Format::RGBA:
+                encode_rgba(frame, s.width, s.height, encoded);
+                break;
+            case Format::PNG:
+                ok = write_png(s, frame, encoded);
+                break;
+            }
+        }
+
+        if (is_sequential(s.format)) {
+            {
+                std::unique_lock<std::mutex> order(s.fileMutex);
+                s.turn.wait(order, [&s, &frame]() { return s.nextWrite == frame.index; });
+                if (ok) {
+                    ok = fwrite(encoded.data(), 1, encoded.size(), s.file) == encoded.size();
+                }
+                s.nextWrite++;
+            }
+            s.turn.notify_all();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            if (ok) {
+                s.written++;
+                state().written.add();
+            } else {
+                // after the first failure the rest of the queue is only drained
+                s.failed = true;
+                s.dropped++;
+                state().dropped.add();
+            }
+            s.spare.push_back(std::move(frame.pixels));
+        }
+    }
+}
+
+static void enqueue(Session& s, const unsigned char* pixels, int width, int height) {
+    size_t size = static_cast<size_t>(width) * height * kBytesPerPixel;
+
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        Frame frame;
+        frame.index = s.queued++;
+        if (!s.spare.empty()) {
+            frame.pixels = std::move(s.spare.back());
+            s.spare.pop_back();
+        }
+
+        // the only copy on the render thread, the mapping is gone once we return
+        frame.pixels.assign(pixels, pixels + size);
+        s.queue.push_back(std::move(frame));
+    }
+    s.ready.notify_one();
+}
+
+void capture() {
+    RecorderState& r = state();
+    if (!r.active) {
+        return;
+    }
+
+    std::shared_ptr<Session> session = r.active;
+    Session& s = *session;
+
+    unsigned int framebuffer = 0;
+    int width = GetRenderWidth();
+    int height = GetRenderHeight();
+    if (s.target) {
+        framebuffer = s.target->id;
+        width = s.target->texture.width;
+        height = s.target->texture.height;
+    }
+
+    // a released target or a resized window cannot be written into a fixed size stream
+    if ((s.target && framebuffer == 0) || width != s.width || height != s.height) {
+        drop(s);
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(s.mutex);
+        if (s.queue.size() + s.inflight >= s.capacity) {
+            if (s.policy == Policy::DROP) {
+                s.dropped++;
+                r.dropped.add();
+                return;
+            }
+
+            // frames still being read back count against the queue, they are
+            // only waited for when nothing is left for the writers to drain
+            s.space.wait(lock, [&s]() { return s.queue.size() + s.inflight < s.capacity || s.queue.empty(); });
+        }
+    }
+
+    s.inflight++;
+    readback::request(framebuffer, width, height, [session](const unsigned char* pixels, int width, int height) {
+        Session& s = *session;
+        s.inflight--;
+
+        if (!pixels) {
+            drop(s);
+            return;
+        }
+
+        enqueue(s, pixels, width, height);
+    });
+}
+
+static void close_session(Session& s) {
+    for (std::thread& writer : s.writers) {
+        writer.join();
+    }
+    s.writers.clear();
+
+    if (s.file) {
+        if (fclose(s.file) != 0) {
+            s.failed = true;
+        }
+        s.file = nullptr;
+    }
+}
+
+void update() {
+    RecorderState& r = state();
+
+    for (size_t i = 0; i < r.draining.size();) {
+        Session& s = *r.draining[i];
+
+        bool finished;
+        {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            // readbacks still in flight would enqueue after the writers have gone
+            if (s.inflight == 0 && !s.closing) {
+                s.closing = true;
+                s.ready.notify_all();
+            }
+            finished = s.closing && s.finished == s.writers.size();
+        }
+
+        if (!finished) {
+            ++i;
+            continue;
+        }
+
+        close_session(s);
+
+        if (s.failed) {
+            s.token->fail("Failed to write recording: " + s.path);
+        } else {
+            uint64_t written = s.written;
+            uint64_t dropped = s.dropped;
+            s.token->complete([written, dropped](lua_State* L) {
+                lua_createtable(L, 0, 2);
+                lua_pushnumber(L, static_cast<double>(written));
+                lua_setfield(L, -2, "written");
+                lua_pushnumber(L, static_cast<double>(dropped));
+                lua_setfield(L, -2, "dropped");
+                return 1;
+            });
+        }
+
+        r.draining.erase(r.draining.begin() + i);
+    }
+}
+
+static void finish_now(Session& s) {
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        s.closing = true;
+    }
+    s.ready.notify_all();
+    close_session(s);
+}
+
+void shutdown() {
+    RecorderState& r = state();
+
+    // readback::shutdown has already cancelled whatever was in flight
+    if (r.active) {
+        finish_now(*r.active);
+        r.active.reset();
+    }
+
+    for (std::shared_ptr<Session>& session : r.draining) {
+        finish_now(*session);
+        if (session->token) {
+            session->token->fail("Recording was interrupted by shutdown");
+        }
+    }
+    r.draining.clear();
+}
+
+int start(lua_State* L) {
+    WINDOW_NOT_INITIALIZED_CHECK();
+
+    RecorderState& r = state();
+    if (r.active) {
+        luaL_error(L, "Already recording, stop the current recording first");
+    }
+
+    if (!readback::supported()) {
+        luaL_error(L, "Recording needs OpenGL 3.3 or newer");
+    }
+
+    const char* path = luaL_checkstring(L, 1);
+    bool hasOptions = !lua_isnoneornil(L, 2);
+    if (hasOptions) {
+        luaL_checktype(L, 2, LUA_TTABLE);
+    }
+
+    auto session = std::make_shared<Session>();
+    Session& s = *session;
+    s.path = path;
+    s.policy = Policy::DROP;
+    s.capacity = kDefaultQueue;
+    s.width = GetRenderWidth();
+    s.height = GetRenderHeight();
+
+    const char* formatName = IsFileExtension(path, ".y4m") ? "y4m" : IsFileExtension(path, ".png") ? "png" : "rgba";
+    int fps = window::get_target_fps() > 0 ? window::get_target_fps() : 60;
+    int threads = 0;
+
+    if (hasOptions) {
+        lua_getfield(L, 2, "format");
+        formatName = lua_isnil(L, -1) ? formatName : luaL_checkstring(L, -1);
+        lua_pop(L, 1);
+
+        lua_getfield(L, 2, "policy");
+        if (!lua_isnil(L, -1)) {
+            const char* name = luaL_checkstring(L, -1);
+            auto it = std::find_if(std::begin(policies), std::end(policies), [name](const auto& entry) { return strcmp(entry.first, name) == 0; });
+            if (it == std::end(policies)) {
+                luaL_error(L, "Invalid recording policy: %s", name);
+            }
+            s.policy = it->second;
+        }
+        lua_pop(L, 1);
+
+        lua_getfield(L, 2, "queue");
+        int capacity = lua_isnil(L, -1) ? kDefaultQueue : luaL_checkinteger(L, -1);
+        lua_pop(L, 1);
+        if (capacity <= 0) {
+            luaL_error(L, "Recording queue must hold at least one frame");
+        }
+        s.capacity = static_cast<size_t>(capacity);
+
+        lua_getfield(L, 2, "threads");
+        threads = lua_isnil(L, -1) ? 0 : luaL_checkinteger(L, -1);
+        lua_pop(L, 1);
+        // 0 picks a count suited to the format
+        if (threads < 0 || threads > kMaxWriters) {
+            luaL_error(L, "Recording threads must be between 0 and %d", kMaxWriters);
+        }
+
+        lua_getfield(L, 2, "fps");
+        fps = lua_isnil(L, -1) ? fps : luaL_checkinteger(L, -1);
+        lua_pop(L, 1);
+        if (fps <= 0) {
+            luaL_error(L, "Recording fps must be positive");
+        }
+
+        lua_getfield(L, 2, "target");
+        if (!lua_isnil(L, -1)) {
+            s.target = rendertexture::check_rendertexture(L, -1);
+            s.width = s.target->texture.width;
+            s.height = s.target->texture.height;
+        }
+        lua_pop(L, 1);
+    }
+
+    auto format = std::find_if(std::begin(formats), std::end(formats), [formatName](const auto& entry) { return strcmp(entry.first, formatName) == 0; });
+    if (format == std::end(formats)) {
+        luaL_error(L, "Invalid recording format: %s", formatName);
+    }
+    s.format = format->second;
+
+    if (s.format == Format::PNG && !is_sequence_pattern(path)) {
+        luaL_error(L, "PNG recordings need a frame number in the path, like frames/%%05d.png");
+    }
+
+    if (s.width <= 0 || s.height <= 0) {
+        luaL_error(L, "Nothing to record, the frame is empty");
+    }
+
+    if (is_sequential(s.format)) {
+        s.file = fopen(path, "wb");
+        if (!s.file) {
+            luaL_error(L, "Failed to open recording: %s", path);
+        }
+
+        if (s.format == Format::Y4M) {
+            fprintf(s.file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n", s.width, s.height, fps);
+        }
+    }
+
+    if (threads == 0) {
+        // converting to YUV is worth a second core, raw frames are bound by the disk
+        unsigned int hardware = std::thread::hardware_concurrency();
+        int spare = hardware > 1 ? static_cast<int>(hardware) - 1 : 1;
+        threads = s.format == Format::PNG ? std::clamp(spare, 1, 4) : s.format == Format::Y4M ? 2 : 1;
+    }
+
+    for (int i = 0; i < threads; ++i) {
+        s.writers.emplace_back(write_frames, std::ref(s));
+    }
+
+    if (s.target) {
+        // keeps the target alive for as long as it is being recorded
+        lua_getfield(L, 2, "target");
+        s.targetRef = lua_ref(L, -1);
+        lua_pop(L, 1);
+    }
+
+    r.active = std::move(session);
+    return 0;
+}
+
+int stop(lua_State* L) {
+    RecorderState& r = state();
+    if (!r.active) {
+        luaL_error(L, "Not recording");
+    }
+
+    std::shared_ptr<Session> session = std::move(r.active);
+    session->stopping = true;
+    session->target = nullptr;
+    if (session->targetRef != LUA_NOREF) {
+        lua_unref(L, session->targetRef);
+        session->targetRef = LUA_NOREF;
+    }
+
+    // resumed by update() once everything queued has been written
+    session->token = scheduler::park(L);
+    r.draining.push_back(std::move(session));
+
+    return lua_yield(L, 0);
+}
+
+int stats(lua_State* L) {
+    RecorderState& r = state();
+    if (!r.active) {
+        lua_pushnil(L);
+        return 1;
+    }
+
+    Session& s = *r.active;
+    std::lock_guard<std::mutex> lock(s.mutex);
+
+    lua_createtable(L, 0, 4);
+    lua_pushnumber(L, static_cast<double>(s.written));
+    lua_setfield(L, -2, "written");
+    lua_pushnumber(L, static_cast<double>(s.dropped));
+    lua_setfield(L, -2, "dropped");
+    lua_pushinteger(L, static_cast<int>(s.queue.size() + s.inflight));
+    lua_setfield(L, -2, "pending");
+    lua_pushboolean(L, s.failed);
+    lua_setfield(L, -2, "failed");
+
+    return 1;
+}
+
+} // namespace recorder
@@ -5,13 +5,27 @@
 #include "adore/window.h"
 #include "adore/colors.h"
 #include "adore/image.h"
+#include "adore/resources.h"
+#include "adore/drawlist.h"
+#include "adore/software.h"
+#include "adore/targetpool.h"
+#include "adore/readback.h"
+#include "adore/scheduler.h"
 #include <memory>
 #include <iostream>
 #include "raylib.h"
 
 namespace rendertexture {
 
-int create_rendertexture_userdata(lua_State* L, const RenderTexture& rendertexture) {
+// this frame's temporaries, returned to the pool by end_frame()
+static const char* kTemporariesRegistryKey = "adore.graphics.temporaries";
+
+static lua_State* GL = nullptr;
+
+// what start() bound, so code that switches targets itself can go back to it
+static RenderTexture current = {};
+
+static int push_userdata(lua_State* L, const RenderTexture& rendertexture) {
     RenderTexture* rtPtr = static_cast<RenderTexture*>(lua_newuserdatatagged(L, sizeof(RenderTexture), kRenderTextureUserdataTag));
     *rtPtr = rendertexture;
     lua_getuserdatametatable(L, kRenderTextureUserdataTag);
@@ -20,29 +34,105 @@ int create_rendertexture_userdata(lua_State* L, const RenderTexture& rendertextu
     return 1;
 }
 
+int create_rendertexture_userdata(lua_State* L, const RenderTexture& rendertexture) {
+    resources::track(resources::Kind::RENDERTEXTURE, resources::rendertexture_bytes(rendertexture));
+    return push_userdata(L, rendertexture);
+}
+
+static int opt_format(lua_State* L, int index) {
+    return lua_isnoneornil(L, index) ? PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 : image::check_format(L, index);
+}
+
 int create(lua_State* L) {
     WINDOW_NOT_INITIALIZED_CHECK();
 
     int width = luaL_checkinteger(L, 1);
     int height = luaL_checkinteger(L, 2);
+    int format = opt_format(L, 3);
 
-    RenderTexture rendertexture = LoadRenderTexture(width, height);
+    RenderTexture rendertexture = targetpool::load(width, height, format);
+    if (rendertexture.id == 0) {
+        luaL_error(L, "Failed to create %dx%d render texture", width, height);
+    }
 
     return create_rendertexture_userdata(L, rendertexture);
 }
 
+int acquire(lua_State* L) {
+    WINDOW_NOT_INITIALIZED_CHECK();
+
+    int width = luaL_checkinteger(L, 1);
+    int height = luaL_checkinteger(L, 2);
+    int format = opt_format(L, 3);
+
+    RenderTexture rendertexture = targetpool::acquire(width, height, format);
+    if (rendertexture.id == 0) {
+        luaL_error(L, "Failed to create %dx%d render texture", width, height);
+    }
+
+    return push_userdata(L, rendertexture);
+}
+
+int temporary(lua_State* L) {
+    acquire(L);
+
+    lua_getfield(L, LUA_REGISTRYINDEX, kTemporariesRegistryKey);
+    if (!lua_istable(L, -1)) {
+        lua_pop(L, 1);
+        lua_newtable(L);
+        lua_pushvalue(L, -1);
+        lua_setfield(L, LUA_REGISTRYINDEX, kTemporariesRegistryKey);
+    }
+
+    lua_pushvalue(L, -2);
+    lua_rawseti(L, -2, lua_objlen(L, -2) + 1);
+    lua_pop(L, 1);
+
+    GL = lua_mainthread(L);
+    return 1;
+}
+
+int poolstats(lua_State* L) {
+    targetpool::Stats stats = targetpool::stats();
+
+    lua_createtable(L, 0, 4);
+    lua_pushinteger(L, static_cast<int>(stats.free));
+    lua_setfield(L, -2, "free");
+    lua_pushinteger(L, static_cast<int>(stats.inuse));
+    lua_setfield(L, -2, "inuse");
+    lua_pushnumber(L, static_cast<double>(stats.created));
+    lua_setfield(L, -2, "created");
+    lua_pushnumber(L, static_cast<double>(stats.reused));
+    lua_setfield(L, -2, "reused");
+
+    return 1;
+}
+
 RenderTexture* check_rendertexture(lua_State* L, int index) {
     void* ud = lua_touserdatatagged(L, index, kRenderTextureUserdataTag);
     if (!ud) {
         luaL_typeerror(L, index, "RenderTexture");
     }
-    return static_cast<RenderTexture*>(ud);
+
+    RenderTexture* rendertexture = static_cast<RenderTexture*>(ud);
+    if (rendertexture->id == 0) {
+        luaL_error(L, "RenderTexture has been released");
+    }
+    return rendertexture;
 }
 
 int index(lua_State* L) {
-    RenderTexture* rendertexture = check_rendertexture(L, 1);
     const char* key = luaL_checkstring(L, 2);
 
+    for (auto& [name, func] : udata) {
+        if (name && strcmp(name, key) == 0) {
+            lua_pushcfunction(L, func, name);
+            return 1;
+        }
+    }
+
+    RenderTexture* rendertexture = check_rendertexture(L, 1);
+
     if (strcmp(key, "width") == 0) {
         lua_pushinteger(L, rendertexture->texture.width);
         return 1;
@@ -53,20 +143,35 @@ int index(lua_State* L) {
         lua_pushinteger(L, rendertexture->id);
         return 1;
     } else if (strcmp(key, "texture") == 0) {
-        return texture::create_texture_userdata(L, rendertexture->texture, false);
+        return texture::push_texture_view(L, 1, rendertexture->texture);
     } else if (strcmp(key, "depth") == 0) {
-        return texture::create_texture_userdata(L, rendertexture->depth, false);
+        return texture::push_texture_view(L, 1, rendertexture->depth);
     }
 
     luaL_error(L, "Attempt to access invalid Texture property: %s", key);
     return 0;
 }
 
+const RenderTexture* active() {
+    return current.id != 0 ? &current : nullptr;
+}
+
 int start(lua_State* L) {
     WINDOW_NOT_INITIALIZED_CHECK();
 
     RenderTexture* rendertexture = check_rendertexture(L, 1);
 
+    if (drawlist::recording()) {
+        luaL_error(L, "Cannot change render target while recording a DrawList");
+    }
+
+    current = *rendertexture;
+
+    if (software::enabled()) {
+        software::begin_target(*rendertexture);
+        return 0;
+    }
+
     BeginTextureMode(*rendertexture);
 
     return 0;
@@ -75,11 +180,130 @@ int start(lua_State* L) {
 int stop(lua_State* L) {
     WINDOW_NOT_INITIALIZED_CHECK();
 
+    if (drawlist::recording()) {
+        luaL_error(L, "Cannot change render target while recording a DrawList");
+    }
+
+    current = RenderTexture{};
+
+    if (software::enabled()) {
+        software::end_target();
+        return 0;
+    }
+
     EndTextureMode();
 
     return 0;
 }
 
+int readasync(lua_State* L) {
+    WINDOW_NOT_INITIALIZED_CHECK();
+
+    RenderTexture* rendertexture = check_rendertexture(L, 1);
+    int width = rendertexture->texture.width;
+    int height = rendertexture->texture.height;
+    size_t bytes = static_cast<size_t>(width) * height * 4;
+
+    if (!readback::supported()) {
+        luaL_error(L, "Asynchronous readback needs OpenGL 3.3 or newer");
+    }
+
+    // the buffer is kept alive by the registry until the pixels have been written or the readback is cancelled
+    unsigned char* destination = nullptr;
+    int bufferRef = LUA_NOREF;
+    if (!lua_isnoneornil(L, 2)) {
+        size_t length;
+        unsigned char* data = static_cast<unsigned char*>(luaL_checkbuffer(L, 2, &length));
+        size_t offset = static_cast<size_t>(luaL_optinteger(L, 3, 0));
+        if (offset > length || length - offset < bytes) {
+            luaL_error(L, "Buffer needs %d bytes after offset %d", static_cast<int>(bytes), static_cast<int>(offset));
+        }
+
+        destination = data + offset;
+        bufferRef = lua_ref(L, 2);
+    }
+
+    // cancelled readbacks have no thread to resume on, they drop the reference through the main one
+    lua_State* mainThread = lua_mainthread(L);
+    scheduler::Token token = scheduler::park(L);
+    readback::request(rendertexture->id, width, height, [token, destination, bufferRef, mainThread](const unsigned char* pixels, int width, int height) {
+        if (!pixels) {
+            if (bufferRef != LUA_NOREF) {
+                lua_unref(mainThread, bufferRef);
+            }
+            token->fail("Readback was cancelled");
+            return;
+        }
+
+        if (destination) {
+            readback::copy_flipped(pixels, width, height, destination);
+            token->complete([bufferRef](lua_State* L) {
+                lua_getref(L, bufferRef);
+                lua_unref(L, bufferRef);
+                return 1;
+            });
+            return;
+        }
+
+        Image image = { MemAlloc(width * height * 4), width, height, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 };
+        readback::copy_flipped(pixels, width, height, static_cast<unsigned char*>(image.data));
+        token->complete([image](lua_State* L) {
+            return image::create_image_userdata(L, image);
+        });
+    });
+
+    return lua_yield(L, 0);
+}
+
+static void release_rendertexture(lua_State* L, RenderTexture* rendertexture) {
+    // pooled targets go back right away, anything drawn into them so far is
+    // flushed before the next owner binds them. Others may still be bound and
+    // are unloaded after the frame so stop() stays valid.
+    if (rendertexture->id != 0 && !targetpool::release(*rendertexture)) {
+        resources::defer(*rendertexture);
+    }
+
+    texture::invalidate_texture_view(L, rendertexture->texture);
+    texture::invalidate_texture_view(L, rendertexture->depth);
+    *rendertexture = RenderTexture{};
+}
+
+int release(lua_State* L) {
+    void* ud = lua_touserdatatagged(L, 1, kRenderTextureUserdataTag);
+    if (!ud) {
+        luaL_typeerror(L, 1, "RenderTexture");
+    }
+
+    release_rendertexture(L, static_cast<RenderTexture*>(ud));
+
+    return 0;
+}
+
+void end_frame() {
+    // a target the script left open is not gone back to in later frames
+    current = RenderTexture{};
+
+    if (!GL) {
+        return;
+    }
+
+    lua_getfield(GL, LUA_REGISTRYINDEX, kTemporariesRegistryKey);
+    if (lua_istable(GL, -1)) {
+        int count = lua_objlen(GL, -1);
+        for (int i = 1; i <= count; ++i) {
+            lua_rawgeti(GL, -1, i);
+            if (void* ud = lua_touserdatatagged(GL, -1, kRenderTextureUserdataTag)) {
+                release_rendertexture(GL, static_cast<RenderTexture*>(ud));
+            }
+            lua_pop(GL, 1);
+        }
+
+        lua_pushnil(GL);
+        lua_setfield(GL, LUA_REGISTRYINDEX, kTemporariesRegistryKey);
+    }
+    lua_pop(GL, 1);
+}
+
 } // namespace rendertexture
 
 
@@ -97,7 +321,9 @@ int adoreregister_rendertexture(lua_State* L)
         [](lua_State* L, void* ud)
         {
             RenderTexture* rendertexture = static_cast<RenderTexture*>(ud);
-            UnloadRenderTexture(*rendertexture);
+            if (rendertexture->id != 0 && !targetpool::release(*rendertexture)) {
+                resources::defer(*rendertexture);
+            }
         }
     );
 
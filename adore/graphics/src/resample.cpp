@@ -0,0 +1,358 @@
+#include "adore/resample.h"
+
+#include "adore/jobs.h"
+#include "adore/pixels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace resample {
+
+constexpr int kBytesPerPixel = 4;
+
+// weights sum to 1 << kPrecision, small enough for pairs of them to go through madd
+constexpr int kPrecision = 14;
+constexpr int kRound = 1 << (kPrecision - 1);
+
+constexpr double kPi = 3.14159265358979323846;
+
+// rows per band, below this the hand-off costs more than it saves
+constexpr size_t kGrain = 32;
+
+static double box(double x) {
+    return x > -0.5 && x <= 0.5 ? 1.0 : 0.0;
+}
+
+static double triangle(double x) {
+    x = std::fabs(x);
+    return x < 1.0 ? 1.0 - x : 0.0;
+}
+
+static double sinc(double x) {
+    if (x == 0.0) {
+        return 1.0;
+    }
+    x *= kPi;
+    return std::sin(x) / x;
+}
+
+static double lanczos(double x) {
+    return x > -3.0 && x < 3.0 ? sinc(x) * sinc(x / 3.0) : 0.0;
+}
+
+struct Kernel {
+    double (*weight)(double);
+    double support;
+};
+
+static Kernel kernel_of(Filter filter) {
+    switch (filter) {
+    case Filter::BOX:
+        return Kernel{ box, 0.5 };
+    case Filter::BILINEAR:
+        return Kernel{ triangle, 1.0 };
+    case Filter::LANCZOS:
+        return Kernel{ lanczos, 3.0 };
+    }
+    return Kernel{ triangle, 1.0 };
+}
+
+// Which source pixels, and with what weight, make up each output pixel
+struct Coefficients {
+    std::vector<int> start;
+    std::vector<int> count;
+    // `stride` weights per output pixel, only the first count[i] are used
+    std::vector<int16_t> weights;
+    int stride = 0;
+};
+
+static Coefficients coefficients(int inSize, int outSize, Filter filter) {
+    Kernel kernel = kernel_of(filter);
+    double scale = static_cast<double>(inSize) / outSize;
+    // widen the filter when shrinking so every source pixel contributes
+    double filterScale = std::max(scale, 1.0);
+    double support = kernel.support * filterScale;
+
+    Coefficients c;
+    c.stride = static_cast<int>(std::ceil(support)) * 2 + 1;
+    c.start.resize(outSize);
+    c.count.resize(outSize);
+    c.weights.assign(static_cast<size_t>(outSize) * c.stride, 0);
+
+    std::vector<double> weights(c.stride);
+    for (int i = 0; i < outSize; ++i) {
+        double center = (i + 0.5) * scale;
+        int first = std::max(static_cast<int>(center - support + 0.5), 0);
+        int last = std::min(static_cast<int>(center + support + 0.5), inSize);
+        int count = std::min(last - first, c.stride);
+
+        double total = 0.0;
+        for (int j = 0; j < count; ++j) {
+            weights[j] = kernel.weight((j + first - center + 0.5) / filterScale);
+            total += weights[j];
+        }
+
+        int16_t* fixed = c.weights.data() + static_cast<size_t>(i) * c.stride;
+        for (int j = 0; j < count; ++j) {
+            double normalized = total != 0.0 ? weights[j] / total : 0.0;
+            fixed[j] = static_cast<int16_t>(std::lround(normalized * (1 << kPrecision)));
+        }
+
+        c.start[i] = first;
+        c.count[i] = count;
+    }
+
+    return c;
+}
+
+static inline unsigned char clamp_channel(int32_t sum) {
+    int32_t value = (sum + kRound) >> kPrecision;
+    return static_cast<unsigned char>(std::clamp(value, 0, 255));
+}
+
+// Horizontal pass, one output pixel at a time
+
+static void horizontal_scalar(const unsigned char* row, unsigned char* out, const Coefficients& c, int from, int to) {
+    for (int x = from; x < to; ++x) {
+        const unsigned char* pixel = row + static_cast<size_t>(c.start[x]) * kBytesPerPixel;
+        const int16_t* weights = c.weights.data() + static_cast<size_t>(x) * c.stride;
+
+        int32_t sums[4] = { 0, 0, 0, 0 };
+        for (int tap = 0; tap < c.count[x]; ++tap) {
+            for (int channel = 0; channel < 4; ++channel) {
+                sums[channel] += weights[tap] * pixel[tap * kBytesPerPixel + channel];
+            }
+        }
+
+        for (int channel = 0; channel < 4; ++channel) {
+            out[x * kBytesPerPixel + channel] = clamp_channel(sums[channel]);
+        }
+    }
+}
+
+#if ADORE_PIXELS_X86
+
+static inline __m128i pair_weights(int16_t first, int16_t second) {
+    return _mm_set1_epi32(static_cast<int32_t>((static_cast<uint32_t>(static_cast<uint16_t>(second)) << 16) | static_cast<uint16_t>(first)));
+}
+
+static void horizontal_sse2(const unsigned char* row, unsigned char* out, const Coefficients& c, int width) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi32(kRound);
+
+    for (int x = 0; x < width; ++x) {
+        const unsigned char* pixel = row + static_cast<size_t>(c.start[x]) * kBytesPerPixel;
+        const int16_t* weights = c.weights.data() + static_cast<size_t>(x) * c.stride;
+        int count = c.count[x];
+
+        __m128i sums = zero;
+        int tap = 0;
+        for (; tap + 2 <= count; tap += 2) {
+            // two neighbouring pixels, channels interleaved so madd pairs them up
+            __m128i pair = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(pixel + tap * kBytesPerPixel)), zero);
+            pair = _mm_unpacklo_epi16(pair, _mm_srli_si128(pair, 8));
+            sums = _mm_add_epi32(sums, _mm_madd_epi16(pair, pair_weights(weights[tap], weights[tap + 1])));
+        }
+        if (tap < count) {
+            int32_t last;
+            memcpy(&last, pixel + tap * kBytesPerPixel, sizeof(last));
+            __m128i single = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(last), zero), zero);
+            sums = _mm_add_epi32(sums, _mm_madd_epi16(single, pair_weights(weights[tap], 0)));
+        }
+
+        sums = _mm_srai_epi32(_mm_add_epi32(sums, round), kPrecision);
+        __m128i packed = _mm_packus_epi16(_mm_packs_epi32(sums, sums), zero);
+        int32_t result = _mm_cvtsi128_si32(packed);
+        memcpy(out + x * kBytesPerPixel, &result, sizeof(result));
+    }
+}
+
+#endif
+
+static void horizontal(const unsigned char* row, unsigned char* out, const Coefficients& c, int width) {
+#if ADORE_PIXELS_X86
+    if (pixels::level() >= pixels::Level::SSE2) {
+        horizontal_sse2(row, out, c, width);
+        return;
+    }
+#endif
+    horizontal_scalar(row, out, c, 0, width);
+}
+
+// Vertical pass, a whole output row at a time
+
+static void vertical_scalar(const unsigned char* const* rows, const int16_t* weights, int count, unsigned char* out, int from, int to) {
+    for (int i = from * kBytesPerPixel; i < to * kBytesPerPixel; ++i) {
+        int32_t sum = 0;
+        for (int tap = 0; tap < count; ++tap) {
+            sum += weights[tap] * rows[tap][i];
+        }
+        out[i] = clamp_channel(sum);
+    }
+}
+
+#if ADORE_PIXELS_X86
+
+static int vertical_sse2(const unsigned char* const* rows, const int16_t* weights, int count, unsigned char* out, int width) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi32(kRound);
+
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        size_t offset = static_cast<size_t>(x) * kBytesPerPixel;
+        __m128i sums[4] = { zero, zero, zero, zero };
+
+        for (int tap = 0; tap < count; tap += 2) {
+            // an odd last tap is paired with itself at weight 0
+            int next = tap + 1 < count ? tap + 1 : tap;
+            __m128i factor = pair_weights(weights[tap], tap + 1 < count ? weights[tap + 1] : 0);
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[tap] + offset));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[next] + offset));
+
+            __m128i aLo = _mm_unpacklo_epi8(a, zero);
+            __m128i bLo = _mm_unpacklo_epi8(b, zero);
+            __m128i aHi = _mm_unpackhi_epi8(a, zero);
+            __m128i bHi = _mm_unpackhi_epi8(b, zero);
+            sums[0] = _mm_add_epi32(sums[0], _mm_madd_epi16(_mm_unpacklo_epi16(aLo, bLo), factor));
+            sums[1] = _mm_add_epi32(sums[1], _mm_madd_epi16(_mm_unpackhi_epi16(aLo, bLo), factor));
+            sums[2] = _mm_add_epi32(sums[2], _mm_madd_epi16(_mm_unpacklo_epi16(aHi, bHi), factor));
+            sums[3] = _mm_add_epi32(sums[3], _mm_madd_epi16(_mm_unpackhi_epi16(aHi, bHi), factor));
+        }
+
+        for (__m128i& sum : sums) {
+            sum = _mm_srai_epi32(_mm_add_epi32(sum, round), kPrecision);
+        }
+        __m128i packed = _mm_packus_epi16(_mm_packs_epi32(sums[0], sums[1]), _mm_packs_epi32(sums[2], sums[3]));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + offset), packed);
+    }
+    return x;
+}
+
+ADORE_TARGET_AVX2 static int vertical_avx2(const unsigned char* const* rows, const int16_t* weights, int count, unsigned char* out, int width) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i round = _mm256_set1_epi32(kRound);
+
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        size_t offset = static_cast<size_t>(x) * kBytesPerPixel;
+        __m256i sums[4] = { zero, zero, zero, zero };
+
+        for (int tap = 0; tap < count; tap += 2) {
+            int next = tap + 1 < count ? tap + 1 : tap;
+            int16_t second = tap + 1 < count ? weights[tap + 1] : 0;
+            __m256i factor = _mm256_set1_epi32(static_cast<int32_t>((static_cast<uint32_t>(static_cast<uint16_t>(second)) << 16) | static_cast<uint16_t>(weights[tap])));
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[tap] + offset));
+            __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[next] + offset));
+
+            __m256i aLo = _mm256_unpacklo_epi8(a, zero);
+            __m256i bLo = _mm256_unpacklo_epi8(b, zero);
+            __m256i aHi = _mm256_unpackhi_epi8(a, zero);
+            __m256i bHi = _mm256_unpackhi_epi8(b, zero);
+            sums[0] = _mm256_add_epi32(sums[0], _mm256_madd_epi16(_mm256_unpacklo_epi16(aLo, bLo), factor));
+            sums[1] = _mm256_add_epi32(sums[1], _mm256_madd_epi16(_mm256_unpackhi_epi16(aLo, bLo), factor));
+            sums[2] = _mm256_add_epi32(sums[2], _mm256_madd_epi16(_mm256_unpacklo_epi16(aHi, bHi), factor));
+            sums[3] = _mm256_add_epi32(sums[3], _mm256_madd_epi16(_mm256_unpackhi_epi16(aHi, bHi), factor));
+        }
+
+        for (__m256i& sum : sums) {
+            sum = _mm256_srai_epi32(_mm256_add_epi32(sum, round), kPrecision);
+        }
+        // the unpacks and packs both stay within lanes, so the pixels come out in order
+        __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(sums[0], sums[1]), _mm256_packs_epi32(sums[2], sums[3]));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + offset), packed);
+    }
+    return x;
+}
+
+#endif
+
+static void vertical(const unsigned char* const* rows, const int16_t* weights, int count, unsigned char* out, int width) {
+    int done = 0;
+#if ADORE_PIXELS_X86
+    if (pixels::level() >= pixels::Level::AVX2) {
+        done = vertical_avx2(rows, weights, count, out, width);
+    } else if (pixels::level() >= pixels::Level::SSE2) {
+        done = vertical_sse2(rows, weights, count, out, width);
+    }
+#endif
+    vertical_scalar(rows, weights, count, out, done, width);
+}
+
+void resize(const unsigned char* source, int sourceWidth, int sourceHeight, unsigned char* destination, int width, int height, Filter filter) {
+    size_t sourceStride = static_cast<size_t>(sourceWidth) * kBytesPerPixel;
+    size_t stride = static_cast<size_t>(width) * kBytesPerPixel;
+
+    // horizontal first, into rows of the final width but the source height
+    const unsigned char* columns = source;
+    std::vector<unsigned char> intermediate;
+    if (width != sourceWidth) {
+        Coefficients c = coefficients(sourceWidth, width, filter);
+        unsigned char* out = destination;
+        if (height != sourceHeight) {
+            intermediate.resize(stride * sourceHeight);
+            out = intermediate.data();
+        }
+
+        jobs::parallel_for(sourceHeight, kGrain, [&](size_t begin, size_t end) {
+            for (size_t y = begin; y < end; ++y) {
+                horizontal(source + sourceStride * y, out + stride * y, c, width);
+            }
+        });
+
+        if (height == sourceHeight) {
+            return;
+        }
+        columns = intermediate.data();
+    } else if (height == sourceHeight) {
+        std::copy(source, source + stride * height, destination);
+        return;
+    }
+
+    Coefficients c = coefficients(sourceHeight, height, filter);
+    jobs::parallel_for(height, kGrain, [&](size_t begin, size_t end) {
+        std::vector<const unsigned char*> rows(c.stride);
+        for (size_t y = begin; y < end; ++y) {
+            int count = c.count[y];
+            for (int tap = 0; tap < count; ++tap) {
+                rows[tap] = columns + stride * (c.start[y] + tap);
+            }
+            vertical(rows.data(), c.weights.data() + y * c.stride, count, destination + stride * y, width);
+        }
+    });
+}
+
+size_t mipmap_size(int width, int height, int* levels) {
+    size_t size = 0;
+    int count = 0;
+    while (true) {
+        size += static_cast<size_t>(width) * height * kBytesPerPixel;
+        count++;
+        if (width == 1 && height == 1) {
+            break;
+        }
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+
+    *levels = count;
+    return size;
+}
+
+void mipmaps(unsigned char* chain, int width, int height, int levels) {
+    unsigned char* level = chain;
+    for (int i = 1; i < levels; ++i) {
+        int nextWidth = std::max(width / 2, 1);
+        int nextHeight = std::max(height / 2, 1);
+        unsigned char* next = level + static_cast<size_t>(width) * height * kBytesPerPixel;
+
+        resize(level, width, height, next, nextWidth, nextHeight, Filter::BOX);
+
+        level = next;
+        width = nextWidth;
+        height = nextHeight;
+    }
+}
+
+} // namespace resample
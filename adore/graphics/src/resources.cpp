@@ -0,0 +1,135 @@
+#include "adore/resources.h"
+
+#include "adore/metrics.h"
+#include "adore/software.h"
+
+#include <deque>
+#include <string>
+#include <variant>
+
+namespace resources {
+
+struct KindMetrics {
+    metrics::Gauge& count;
+    metrics::Gauge& bytes;
+    metrics::Counter& queued;
+    metrics::Counter& released;
+};
+
+static KindMetrics make_metrics(const char* kind) {
+    std::string labels = metrics::label("kind", kind);
+    return KindMetrics{
+        metrics::gauge("adore_graphics_resources", "Live graphics resources owned by userdata", labels),
+        metrics::gauge("adore_graphics_resource_bytes", "Approximate memory held by live graphics resources", labels),
+        metrics::counter("adore_graphics_release_queued_total", "Graphics resources queued for deferred unloading", labels),
+        metrics::counter("adore_graphics_released_total", "Queued graphics resources unloaded after a frame", labels),
+    };
+}
+
+static KindMetrics& metrics_for(Kind kind) {
+    static KindMetrics kinds[] = {
+        make_metrics("texture"),
+        make_metrics("image"),
+        make_metrics("font"),
+        make_metrics("rendertexture"),
+        make_metrics("shader"),
+    };
+    return kinds[static_cast<int>(kind)];
+}
+
+void track(Kind kind, int64_t bytes) {
+    KindMetrics& m = metrics_for(kind);
+    m.count.add();
+    m.bytes.add(bytes);
+}
+
+void untrack(Kind kind, int64_t bytes) {
+    KindMetrics& m = metrics_for(kind);
+    m.count.sub();
+    m.bytes.sub(bytes);
+}
+
+struct PendingRelease {
+    Kind kind;
+    int64_t bytes;
+    std::variant<Texture2D, Font, RenderTexture, Shader> resource;
+};
+
+static std::deque<PendingRelease>& queue() {
+    static std::deque<PendingRelease> instance;
+    return instance;
+}
+
+static void enqueue(Kind kind, int64_t bytes, std::variant<Texture2D, Font, RenderTexture, Shader> resource) {
+    metrics_for(kind).queued.add();
+    queue().push_back(PendingRelease{kind, bytes, resource});
+}
+
+void defer(const Texture2D& texture) {
+    enqueue(Kind::TEXTURE, texture_bytes(texture), texture);
+}
+
+void defer(const Font& font) {
+    enqueue(Kind::FONT, font_bytes(font), font);
+}
+
+void defer(const RenderTexture& rendertexture) {
+    enqueue(Kind::RENDERTEXTURE, rendertexture_bytes(rendertexture), rendertexture);
+}
+
+void defer(const Shader& shader) {
+    enqueue(Kind::SHADER, 0, shader);
+}
+
+size_t drain(size_t budget) {
+    std::deque<PendingRelease>& pendingReleases = queue();
+
+    size_t released = 0;
+    while (!pendingReleases.empty() && (budget == 0 || released < budget)) {
+        PendingRelease entry = pendingReleases.front();
+        pendingReleases.pop_front();
+
+        // GL hands the ids out again, a CPU copy kept under one would be stale
+        if (auto* texture = std::get_if<Texture2D>(&entry.resource)) {
+            software::forget(texture->id);
+            UnloadTexture(*texture);
+        } else if (auto* font = std::get_if<Font>(&entry.resource)) {
+            software::forget(font->texture.id);
+            UnloadFont(*font);
+        } else if (auto* rendertexture = std::get_if<RenderTexture>(&entry.resource)) {
+            software::forget(rendertexture->texture.id);
+            UnloadRenderTexture(*rendertexture);
+        } else if (auto* shader = std::get_if<Shader>(&entry.resource)) {
+            UnloadShader(*shader);
+        }
+
+        untrack(entry.kind, entry.bytes);
+        metrics_for(entry.kind).released.add();
+        released++;
+    }
+
+    return released;
+}
+
+size_t pending() {
+    return queue().size();
+}
+
+int64_t texture_bytes(const Texture2D& texture) {
+    return GetPixelDataSize(texture.width, texture.height, texture.format);
+}
+
+int64_t image_bytes(const Image& image) {
+    return GetPixelDataSize(image.width, image.height, image.format);
+}
+
+int64_t font_bytes(const Font& font) {
+    return texture_bytes(font.texture);
+}
+
+int64_t rendertexture_bytes(const RenderTexture& rendertexture) {
+    // colour attachment plus a 32 bit depth renderbuffer
+    return texture_bytes(rendertexture.texture) + static_cast<int64_t>(rendertexture.depth.width) * rendertexture.depth.height * 4;
+}
+
+} // namespace resources
@@ -0,0 +1,510 @@
+#include "adore/shader.h"
+
+#include "adore/core.h"
+#include "adore/window.h"
+#include "adore/texture.h"
+#include "adore/drawlist.h"
+#include "adore/software.h"
+#include "adore/resources.h"
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include "raylib.h"
+#include "rlgl.h"
+#include "external/glad.h"
+
+namespace shader {
+
+// rlgl binds the batch texture to unit 0 and sampler textures of its own to the
+// next few units, ours start after those and stay bound across batch flushes
+constexpr int kFirstTextureUnit = 1 + RL_DEFAULT_BATCH_MAX_TEXTURE_UNITS;
+
+// shader userdata -> { uniform name -> Texture userdata }, weak keys so the
+// textures live as long as the shader that samples them
+static const char* kSamplersRegistryKey = "adore.graphics.shadersamplers";
+
+struct TypeInfo {
+    GLenum gl;
+    UniformType type;
+    int components;
+    const char* name;
+};
+
+static const TypeInfo types[] = {
+    { GL_FLOAT, UniformType::FLOAT, 1, "float" },
+    { GL_FLOAT_VEC2, UniformType::VEC2, 2, "vec2" },
+    { GL_FLOAT_VEC3, UniformType::VEC3, 3, "vec3" },
+    { GL_FLOAT_VEC4, UniformType::VEC4, 4, "vec4" },
+    { GL_INT, UniformType::INT, 1, "int" },
+    { GL_INT_VEC2, UniformType::IVEC2, 2, "ivec2" },
+    { GL_INT_VEC3, UniformType::IVEC3, 3, "ivec3" },
+    { GL_INT_VEC4, UniformType::IVEC4, 4, "ivec4" },
+    { GL_BOOL, UniformType::INT, 1, "bool" },
+    { GL_FLOAT_MAT4, UniformType::MAT4, 16, "mat4" },
+    { GL_SAMPLER_2D, UniformType::SAMPLER2D, 1, "sampler2D" },
+};
+
+static const TypeInfo& type_info(UniformType type) {
+    static const TypeInfo unsupported = { 0, UniformType::UNSUPPORTED, 0, "unsupported" };
+    for (const TypeInfo& info : types) {
+        if (info.type == type) {
+            return info;
+        }
+    }
+    return unsupported;
+}
+
+// The shader whose pass is open, and whether a pass is open at all. The shader
+// may have been collected mid-pass, the pass is then closed by reset().
+static ShaderRef* current = nullptr;
+static bool passOpen = false;
+
+void ShaderRef::upload(Uniform& uniform) {
+    uniform.dirty = false;
+    uploads++;
+
+    const TypeInfo& info = type_info(uniform.type);
+    switch (uniform.type) {
+    case UniformType::FLOAT:
+    case UniformType::VEC2:
+    case UniformType::VEC3:
+    case UniformType::VEC4:
+        SetShaderValueV(shader, uniform.location, uniform.value.data(), SHADER_UNIFORM_FLOAT + info.components - 1, uniform.count);
+        break;
+    case UniformType::INT:
+    case UniformType::IVEC2:
+    case UniformType::IVEC3:
+    case UniformType::IVEC4: {
+        std::vector<int> values(uniform.value.begin(), uniform.value.end());
+        SetShaderValueV(shader, uniform.location, values.data(), SHADER_UNIFORM_INT + info.components - 1, uniform.count);
+        break;
+    }
+    case UniformType::MAT4: {
+        // column major like GLSL, which is also the order of Matrix's fields
+        const float* v = uniform.value.data();
+        Matrix matrix = { v[0], v[4], v[8], v[12], v[1], v[5], v[9], v[13], v[2], v[6], v[10], v[14], v[3], v[7], v[11], v[15] };
+        SetShaderValueMatrix(shader, uniform.location, matrix);
+        break;
+    }
+    case UniformType::SAMPLER2D:
+        // the unit itself was set when the shader was loaded
+        glActiveTexture(GL_TEXTURE0 + static_cast<int>(uniform.value[0]));
+        glBindTexture(GL_TEXTURE_2D, uniform.texture ? *uniform.texture : 0);
+        glActiveTexture(GL_TEXTURE0);
+        break;
+    case UniformType::UNSUPPORTED:
+        break;
+    }
+}
+
+void ShaderRef::flush() {
+    for (auto& [name, uniform] : uniforms) {
+        // another shader may have bound its own textures to the same units
+        if (uniform.dirty || (uniform.type == UniformType::SAMPLER2D && uniform.texture != nullptr)) {
+            upload(uniform);
+        }
+    }
+}
+
+const Shader* active() {
+    return current ? &current->shader : nullptr;
+}
+
+void reset() {
+    if (passOpen) {
+        EndShaderMode();
+    }
+    passOpen = false;
+    current = nullptr;
+}
+
+// raylib sets the matrices, texture0 and colDiffuse itself for every batch
+static bool managed(const Shader& shader, int location) {
+    for (int i = 0; i < RL_MAX_SHADER_LOCATIONS; ++i) {
+        if (shader.locs[i] == location) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Ask the linked program for its active uniforms, which is all the compiler kept
+static void discover(ShaderRef* ref) {
+    GLuint program = ref->shader.id;
+    GLint count = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+
+    int nextUnit = kFirstTextureUnit;
+    GLint maxUnits = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &maxUnits);
+
+    for (GLint i = 0; i < count; ++i) {
+        char nameBuffer[256];
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum glType = 0;
+        glGetActiveUniform(program, static_cast<GLuint>(i), sizeof(nameBuffer), &length, &size, &glType, nameBuffer);
+
+        // arrays are reported as name[0]
+        std::string name(nameBuffer, length);
+        size_t bracket = name.find('[');
+        if (bracket != std::string::npos) {
+            name.resize(bracket);
+        }
+
+        int location = glGetUniformLocation(program, name.c_str());
+        if (location < 0 || managed(ref->shader, location) || name.compare(0, 3, "gl_") == 0) {
+            continue;
+        }
+
+        Uniform uniform = { location, UniformType::UNSUPPORTED, static_cast<int>(size), {}, nullptr, false };
+        for (const TypeInfo& info : types) {
+            if (info.gl == glType) {
+                uniform.type = info.type;
+            }
+        }
+
+        // a texture unit of its own for every sampler, arrays of them and of matrices are not supported
+        if ((uniform.type == UniformType::SAMPLER2D || uniform.type == UniformType::MAT4) && size != 1) {
+            uniform.type = UniformType::UNSUPPORTED;
+        }
+        if (uniform.type == UniformType::SAMPLER2D) {
+            if (nextUnit >= maxUnits) {
+                uniform.type = UniformType::UNSUPPORTED;
+            } else {
+                int unit = nextUnit++;
+                SetShaderValue(ref->shader, location, &unit, SHADER_UNIFORM_INT);
+                uniform.value.assign(1, static_cast<float>(unit));
+            }
+        } else {
+            // uniforms start out as zero in GL too, so sending zeros is skipped
+            uniform.value.assign(static_cast<size_t>(type_info(uniform.type).components) * uniform.count, 0.0f);
+        }
+
+        ref->uniforms.emplace(std::move(name), std::move(uniform));
+    }
+}
+
+static int push_shader(lua_State* L, const Shader& loaded) {
+    // raylib falls back to its default program when compiling or linking fails
+    if (loaded.id == 0 || loaded.id == rlGetShaderIdDefault()) {
+        luaL_error(L, "Failed to compile shader, the log has the details");
+    }
+
+    void* ud = lua_newuserdatatagged(L, sizeof(ShaderRef), kShaderUserdataTag);
+    ShaderRef* ref = new (ud) ShaderRef();
+    lua_getuserdatametatable(L, kShaderUserdataTag);
+    lua_setmetatable(L, -2);
+
+    ref->shader = loaded;
+    ref->uploads = 0;
+    ref->skipped = 0;
+    discover(ref);
+
+    resources::track(resources::Kind::SHADER, 0);
+
+    return 1;
+}
+
+int load(lua_State* L) {
+    WINDOW_NOT_INITIALIZED_CHECK();
+
+    const char* vertexPath = luaL_optstring(L, 1, nullptr);
+    const char* fragmentPath = luaL_optstring(L, 2, nullptr);
+
+    if (!vertexPath && !fragmentPath) {
+        luaL_error(L, "A shader needs a vertex or a fragment stage");
+    }
+    for (const char* path : { vertexPath, fragmentPath }) {
+        if (path && !FileExists(path)) {
+            luaL_error(L, "Failed to load shader: %s", path);
+        }
+    }
+
+    return push_shader(L, LoadShader(vertexPath, fragmentPath));
+}
+
+int from_string(lua_State* L) {
+    WINDOW_NOT_INITIALIZED_CHECK();
+
+    const char* vertex = luaL_optstring(L, 1, nullptr);
+    const char* fragment = luaL_optstring(L, 2, nullptr);
+
+    if (!vertex && !fragment) {
+        luaL_error(L, "A shader needs a vertex or a fragment stage");
+    }
+
+    return push_shader(L, LoadShaderFromMemory(vertex, fragment));
+}
+
+ShaderRef* check_shader(lua_State* L, int index) {
+    void* ud = lua_touserdatatagged(L, index, kShaderUserdataTag);
+    if (!ud) {
+        luaL_typeerror(L, index, "Shader");
+    }
+
+    ShaderRef* ref = static_cast<ShaderRef*>(ud);
+    if (ref->shader.id == 0) {
+        luaL_error(L, "Shader has been released");
+    }
+    return ref;
+}
+
+int index(lua_State* L) {
+    const char* key = luaL_checkstring(L, 2);
+
+    for (auto& [name, func] : udata) {
+        if (name && strcmp(name, key) == 0) {
+            lua_pushcfunction(L, func, name);
+            return 1;
+        }
+    }
+
+    ShaderRef* ref = check_shader(L, 1);
+
+    if (strcmp(key, "id") == 0) {
+        lua_pushinteger(L, static_cast<int>(ref->shader.id));
+        return 1;
+    }
+
+    luaL_error(L, "Attempt to access invalid Shader property: %s", key);
+    return 0;
+}
+
+// Push the table of textures sampled by the shader at `index`, creating it if needed
+static void push_samplers(lua_State* L, int index) {
+    index = lua_absindex(L, index);
+
+    lua_getfield(L, LUA_REGISTRYINDEX, kSamplersRegistryKey);
+    if (!lua_istable(L, -1)) {
+        lua_pop(L, 1);
+
+        lua_newtable(L);
+        lua_createtable(L, 0, 1);
+        lua_pushstring(L, "k");
+        lua_setfield(L, -2, "__mode");
+        lua_setmetatable(L, -2);
+
+        lua_pushvalue(L, -1);
+        lua_setfield(L, LUA_REGISTRYINDEX, kSamplersRegistryKey);
+    }
+
+    lua_pushvalue(L, index);
+    lua_rawget(L, -2);
+    if (!lua_istable(L, -1)) {
+        lua_pop(L, 1);
+        lua_newtable(L);
+        lua_pushvalue(L, index);
+        lua_pushvalue(L, -2);
+        lua_rawset(L, -4);
+    }
+    lua_remove(L, -2);
+}
+
+// Read a number, a vector or a flat table of numbers into `values`
+static void check_value(lua_State* L, int index, const char* name, const Uniform& uniform, std::vector<float>& values) {
+    size_t expected = uniform.value.size();
+    values.resize(expected);
+
+    if (expected == 1 && lua_isboolean(L, index)) {
+        values[0] = lua_toboolean(L, index) ? 1.0f : 0.0f;
+    } else if (expected == 1 && lua_isnumber(L, index)) {
+        values[0] = static_cast<float>(lua_tonumber(L, index));
+    } else if (expected <= 4 && lua_isvector(L, index)) {
+        const float* vec = lua_tovector(L, index);
+        std::copy(vec, vec + expected, values.begin());
+    } else if (lua_istable(L, index)) {
+        if (static_cast<size_t>(lua_objlen(L, index)) != expected) {
+            luaL_error(L, "Uniform %s takes %d numbers", name, static_cast<int>(expected));
+        }
+        for (size_t i = 0; i < expected; ++i) {
+            lua_rawgeti(L, index, static_cast<int>(i) + 1);
+            values[i] = static_cast<float>(luaL_checknumber(L, -1));
+            lua_pop(L, 1);
+        }
+    } else {
+        luaL_error(L, "Invalid value for %s uniform %s", type_info(uniform.type).name, name);
+    }
+}
+
+int send(lua_State* L) {
+    ShaderRef* ref = check_shader(L, 1);
+    const char* name = luaL_checkstring(L, 2);
+
+    // uniforms the compiler removed are not an error, the shader may be half written
+    auto it = ref->uniforms.find(name);
+    if (it == ref->uniforms.end()) {
+        lua_pushboolean(L, false);
+        return 1;
+    }
+
+    Uniform& uniform = it->second;
+    if (uniform.type == UniformType::UNSUPPORTED) {
+        luaL_error(L, "Uniform %s has a type that cannot be sent", name);
+    }
+
+    bool changed;
+    if (uniform.type == UniformType::SAMPLER2D) {
+        const unsigned int* id = &texture::check_texture(L, 3)->texture.id;
+        changed = id != uniform.texture;
+        uniform.texture = id;
+
+        // the texture stays alive until another one is sent to this sampler
+        push_samplers(L, 1);
+        lua_pushvalue(L, 3);
+        lua_setfield(L, -2, name);
+        lua_pop(L, 1);
+    } else {
+        static std::vector<float> values;
+        check_value(L, 3, name, uniform, values);
+        changed = values != uniform.value;
+        if (changed) {
+            uniform.value.swap(values);
+        }
+    }
+
+    if (!changed) {
+        ref->skipped++;
+        lua_pushboolean(L, true);
+        return 1;
+    }
+
+    uniform.dirty = true;
+    if (ref == current) {
+        // what was drawn so far in this pass still uses the old value
+        rlDrawRenderBatchActive();
+        ref->upload(uniform);
+    }
+
+    lua_pushboolean(L, true);
+    return 1;
+}
+
+int begin(lua_State* L) {
+    WINDOW_NOT_INITIALIZED_CHECK();
+
+    ShaderRef* ref = check_shader(L, 1);
+
+    if (drawlist::recording()) {
+        luaL_error(L, "Shaders cannot be used while recording a draw list");
+    }
+    SOFTWARE_UNSUPPORTED_CHECK("Shaders");
+    if (current) {
+        luaL_error(L, "Another shader is active, finish it first");
+    }
+
+    // flushes what was drawn before with the previous shader
+    BeginShaderMode(ref->shader);
+    ref->flush();
+
+    current = ref;
+    passOpen = true;
+
+    return 0;
+}
+
+int finish(lua_State* L) {
+    ShaderRef* ref = check_shader(L, 1);
+
+    if (ref != current) {
+        luaL_error(L, "Shader is not active");
+    }
+
+    reset();
+
+    return 0;
+}
+
+int uniforms(lua_State* L) {
+    ShaderRef* ref = check_shader(L, 1);
+
+    lua_createtable(L, 0, static_cast<int>(ref->uniforms.size()));
+    for (const auto& [name, uniform] : ref->uniforms) {
+        lua_pushstring(L, type_info(uniform.type).name);
+        lua_setfield(L, -2, name.c_str());
+    }
+
+    return 1;
+}
+
+int stats(lua_State* L) {
+    ShaderRef* ref = check_shader(L, 1);
+
+    lua_createtable(L, 0, 3);
+    lua_pushinteger(L, static_cast<int>(ref->uniforms.size()));
+    lua_setfield(L, -2, "uniforms");
+    lua_pushnumber(L, static_cast<double>(ref->uploads));
+    lua_setfield(L, -2, "uploads");
+    lua_pushnumber(L, static_cast<double>(ref->skipped));
+    lua_setfield(L, -2, "skipped");
+
+    return 1;
+}
+
+static void release_shader(ShaderRef* ref) {
+    if (ref->shader.id == 0) {
+        return;
+    }
+
+    // the pass stays open until finish() or the end of the frame, the program
+    // itself is only unloaded after the frame
+    if (ref == current) {
+        current = nullptr;
+    }
+
+    resources::defer(ref->shader);
+    ref->shader.id = 0;
+    ref->uniforms.clear();
+}
+
+int release(lua_State* L) {
+    void* ud = lua_touserdatatagged(L, 1, kShaderUserdataTag);
+    if (!ud) {
+        luaL_typeerror(L, 1, "Shader");
+    }
+
+    release_shader(static_cast<ShaderRef*>(ud));
+
+    // let go of the sampled textures now rather than when the shader is collected
+    lua_getfield(L, LUA_REGISTRYINDEX, kSamplersRegistryKey);
+    if (lua_istable(L, -1)) {
+        lua_pushvalue(L, 1);
+        lua_pushnil(L);
+        lua_rawset(L, -3);
+    }
+    lua_pop(L, 1);
+
+    return 0;
+}
+
+} // namespace shader
+
+
+int adoreregister_shader(lua_State* L)
+{
+    luaL_newmetatable(L, "Shader");
+    lua_pushvalue(L, -1);
+    lua_setuserdatametatable(L, kShaderUserdataTag);
+
+    lua_pushcfunction(L, shader::index, nullptr);
+    lua_setfield(L, -2, "__index");
+
+    lua_setreadonly(L, -1, true);
+
+    lua_setuserdatadtor(L, kShaderUserdataTag,
+        [](lua_State* L, void* ud)
+        {
+            shader::ShaderRef* ref = static_cast<shader::ShaderRef*>(ud);
+            shader::release_shader(ref);
+            ref->~ShaderRef();
+        }
+    );
+
+    lua_pop(L, 1);
+
+    lua_createtable(L, 0, std::size(shader::lib));
+    luaL_register(L, nullptr, shader::lib); //
+    lua_setreadonly(L, -1, true);
+
+    return 1;
+}
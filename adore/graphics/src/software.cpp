@@ -0,0 +1,736 @@
+#include "adore/software.h"
+
+#include "adore/jobs.h"
+#include "adore/metrics.h"
+#include "adore/pixels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+#include "raylib.h"
+#include "rlgl.h"
+#include "external/glad.h"
+
+namespace software {
+
+constexpr int kTileSize = 64;
+
+// tiles per band handed to a worker
+constexpr size_t kGrain = 2;
+
+// R8G8B8A8, one little endian word per pixel
+struct Surface {
+    std::vector<uint32_t> pixels;
+    int width = 0;
+    int height = 0;
+    // render targets are rasterized top down but GL samples them bottom row first
+    bool flipped = false;
+
+    void resize(int w, int h) {
+        width = w;
+        height = h;
+        pixels.assign(static_cast<size_t>(w) * h, 0);
+    }
+};
+
+struct Target {
+    Surface surface;
+    drawlist::DrawList commands{ {}, {}, LUA_NOREF };
+    // id is 0 for the screen
+    RenderTexture rendertexture{};
+};
+
+enum class Kind {
+    TRIANGLE,
+    LINE,
+    CLEAR,
+};
+
+struct Primitive {
+    Kind kind;
+    // vertices in the target's list, in draw order
+    uint32_t v[3];
+    // nullptr for raylib's default texture, which is a single white pixel
+    const Surface* texture;
+    // sampled with GL_LINEAR instead of GL_NEAREST
+    bool linear;
+    // pixels the primitive may touch, max exclusive
+    int minX, minY, maxX, maxY;
+};
+
+struct State {
+    bool enabled = false;
+
+    Target screen;
+    // render textures drawn into, by colour texture id
+    std::unordered_map<unsigned int, Target> targets;
+    Target* current = nullptr;
+
+    // CPU copies of GPU textures, read back the first time they are sampled
+    std::unordered_map<unsigned int, Surface> textures;
+    Texture2D presented{};
+
+    // the target being flushed as it was before a draw that samples it
+    Surface snapshot;
+
+    // rebuilt by every flush, kept for their capacity
+    std::vector<Primitive> primitives;
+    std::unordered_map<unsigned int, bool> filters;
+    std::vector<std::vector<uint32_t>> bins;
+    std::vector<uint32_t> upload;
+
+    metrics::Counter& primitiveCounter = metrics::counter("adore_software_primitives_total", "Primitives rasterized by the software renderer");
+    metrics::Counter& tileCounter = metrics::counter("adore_software_tiles_total", "Screen tiles rasterized by the software renderer");
+    metrics::Counter& readbackCounter = metrics::counter("adore_software_texture_readbacks_total", "GPU textures copied back to be sampled by the software renderer");
+};
+
+static State& state() {
+    static State instance;
+    return instance;
+}
+
+// x / 255 rounded, exact for every product of two bytes
+static inline uint32_t div255(uint32_t x) {
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+static inline uint32_t pack(Color color) {
+    return static_cast<uint32_t>(color.r) | static_cast<uint32_t>(color.g) << 8 | static_cast<uint32_t>(color.b) << 16 | static_cast<uint32_t>(color.a) << 24;
+}
+
+static inline uint32_t channel(uint32_t pixel, int index) {
+    return (pixel >> (index * 8)) & 0xFF;
+}
+
+// BLEND_ALPHA: glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA) on all four channels
+static inline uint32_t blend(uint32_t dst, uint32_t src) {
+    uint32_t sa = src >> 24;
+    if (sa == 255) {
+        return src;
+    }
+    if (sa == 0) {
+        return dst;
+    }
+
+    uint32_t ia = 255 - sa;
+    uint32_t result = 0;
+    for (int i = 0; i < 4; ++i) {
+        uint32_t s = i == 3 ? sa : channel(src, i);
+        result |= div255(s * sa + channel(dst, i) * ia) << (i * 8);
+    }
+    return result;
+}
+
+// What the default fragment shader does, vertex colour times texel
+static inline uint32_t modulate(uint32_t color, uint32_t texel) {
+    uint32_t result = 0;
+    for (int i = 0; i < 4; ++i) {
+        result |= div255(channel(color, i) * channel(texel, i)) << (i * 8);
+    }
+    return result;
+}
+
+// Blend one colour over a run of pixels, four at a time with SSE2. Matches blend() exactly.
+static void fill_span(uint32_t* row, int count, uint32_t color) {
+    uint32_t sa = color >> 24;
+    if (sa == 0 || count <= 0) {
+        return;
+    }
+    if (sa == 255) {
+        std::fill(row, row + count, color);
+        return;
+    }
+
+    uint32_t ia = 255 - sa;
+    int i = 0;
+
+#if ADORE_PIXELS_X86
+    // source terms per channel, alpha is multiplied by itself like the colour
+    const __m128i source = _mm_setr_epi16(
+        static_cast<short>(channel(color, 0) * sa), static_cast<short>(channel(color, 1) * sa),
+        static_cast<short>(channel(color, 2) * sa), static_cast<short>(sa * sa),
+        static_cast<short>(channel(color, 0) * sa), static_cast<short>(channel(color, 1) * sa),
+        static_cast<short>(channel(color, 2) * sa), static_cast<short>(sa * sa));
+    const __m128i inverse = _mm_set1_epi16(static_cast<short>(ia));
+    const __m128i half = _mm_set1_epi16(128);
+    const __m128i zero = _mm_setzero_si128();
+
+    // products stay below 65536, so plain 16 bit lanes hold them
+    auto mix = [&](__m128i dst) {
+        __m128i x = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(dst, inverse), source), half);
+        return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+    };
+
+    for (; i + 4 <= count; i += 4) {
+        __m128i dst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+        __m128i low = mix(_mm_unpacklo_epi8(dst, zero));
+        __m128i high = mix(_mm_unpackhi_epi8(dst, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(row + i), _mm_packus_epi16(low, high));
+    }
+#endif
+
+    for (; i < count; ++i) {
+        row[i] = blend(row[i], color);
+    }
+}
+
+// GL_REPEAT, raylib's default
+static inline int wrap(int coordinate, int size) {
+    coordinate %= size;
+    return coordinate + (coordinate < 0 ? size : 0);
+}
+
+static inline uint32_t texel(const Surface& texture, int x, int y) {
+    if (texture.flipped) {
+        y = texture.height - 1 - y;
+    }
+    return texture.pixels[static_cast<size_t>(y) * texture.width + x];
+}
+
+// GL_NEAREST
+static inline uint32_t sample(const Surface& texture, float u, float v) {
+    int x = wrap(static_cast<int>(std::floor(u * texture.width)), texture.width);
+    int y = wrap(static_cast<int>(std::floor(v * texture.height)), texture.height);
+    return texel(texture, x, y);
+}
+
+// GL_LINEAR, the four texels around the sample point weighted in 8 bit fixed point
+// like GPUs do. Mip levels are not read back, so minified textures are filtered
+// from the full size level.
+static inline uint32_t sample_linear(const Surface& texture, float u, float v) {
+    float x = u * texture.width - 0.5f;
+    float y = v * texture.height - 0.5f;
+    float left = std::floor(x);
+    float top = std::floor(y);
+    uint32_t wx = static_cast<uint32_t>((x - left) * 256.0f + 0.5f);
+    uint32_t wy = static_cast<uint32_t>((y - top) * 256.0f + 0.5f);
+
+    int x0 = wrap(static_cast<int>(left), texture.width);
+    int y0 = wrap(static_cast<int>(top), texture.height);
+    int x1 = x0 + 1 == texture.width ? 0 : x0 + 1;
+    int y1 = y0 + 1 == texture.height ? 0 : y0 + 1;
+
+    uint32_t t00 = texel(texture, x0, y0);
+    uint32_t t10 = texel(texture, x1, y0);
+    uint32_t t01 = texel(texture, x0, y1);
+    uint32_t t11 = texel(texture, x1, y1);
+
+    uint32_t result = 0;
+    for (int i = 0; i < 4; ++i) {
+        uint32_t upper = channel(t00, i) * (256 - wx) + channel(t10, i) * wx;
+        uint32_t lower = channel(t01, i) * (256 - wx) + channel(t11, i) * wx;
+        result |= ((upper * (256 - wy) + lower * wy + 32768) >> 16) << (i * 8);
+    }
+    return result;
+}
+
+struct Edge {
+    float a, b, c;
+    // pixels exactly on the edge belong to the triangle only on top and left edges
+    bool topLeft;
+
+    float at(float x, float y) const { return a * x + b * y + c; }
+    bool inside(float w) const { return w > 0.0f || (w == 0.0f && topLeft); }
+};
+
+static Edge edge(const drawlist::Vertex& from, const drawlist::Vertex& to) {
+    Edge e;
+    e.a = from.y - to.y;
+    e.b = to.x - from.x;
+    e.c = -(e.a * from.x + e.b * from.y);
+    e.topLeft = e.a > 0.0f || (e.a == 0.0f && e.b > 0.0f);
+    return e;
+}
+
+// Narrow [start, end) to the pixels of row py on the inner side of the edge.
+// The crossing is estimated in floats, then settled with the exact test.
+static void clip_row(const Edge& e, float py, int& start, int& end) {
+    float k = e.b * py + e.c;
+    if (e.a == 0.0f) {
+        if (!e.inside(k)) {
+            end = start;
+        }
+        return;
+    }
+
+    float cross = std::clamp(-k / e.a - 0.5f, static_cast<float>(start - 2), static_cast<float>(end + 2));
+    if (e.a > 0.0f) {
+        int first = std::max(start, static_cast<int>(std::ceil(cross)) - 1);
+        while (first < end && !e.inside(e.at(first + 0.5f, py))) {
+            first++;
+        }
+        start = first;
+    } else {
+        int last = std::min(end, static_cast<int>(std::floor(cross)) + 2);
+        while (last > start && !e.inside(e.at(last - 0.5f, py))) {
+            last--;
+        }
+        end = last;
+    }
+}
+
+// Rasterize the part of a triangle inside [x0, x1) x [y0, y1), sampled at pixel centers
+static void triangle(Surface& surface, const drawlist::Vertex* p0, const drawlist::Vertex* p1, const drawlist::Vertex* p2, const Surface* texture, bool linear, int x0, int y0, int x1, int y1) {
+    float area = (p1->x - p0->x) * (p2->y - p0->y) - (p1->y - p0->y) * (p2->x - p0->x);
+    if (area == 0.0f) {
+        return;
+    }
+    if (area < 0.0f) {
+        std::swap(p1, p2);
+        area = -area;
+    }
+
+    Edge e0 = edge(*p1, *p2);
+    Edge e1 = edge(*p2, *p0);
+    Edge e2 = edge(*p0, *p1);
+
+    uint32_t c0 = pack(p0->color);
+    uint32_t c1 = pack(p1->color);
+    uint32_t c2 = pack(p2->color);
+    bool uniform = c0 == c1 && c1 == c2;
+    float scale = 1.0f / area;
+
+    for (int y = y0; y < y1; ++y) {
+        float py = y + 0.5f;
+
+        // convex, so the covered pixels of a row are one run
+        int start = x0;
+        int end = x1;
+        clip_row(e0, py, start, end);
+        clip_row(e1, py, start, end);
+        clip_row(e2, py, start, end);
+        if (start >= end) {
+            continue;
+        }
+
+        uint32_t* row = surface.pixels.data() + static_cast<size_t>(y) * surface.width;
+        if (uniform && !texture) {
+            fill_span(row + start, end - start, c0);
+            continue;
+        }
+
+        for (int x = start; x < end; ++x) {
+            float px = x + 0.5f;
+            float l0 = e0.at(px, py) * scale;
+            float l1 = e1.at(px, py) * scale;
+            float l2 = e2.at(px, py) * scale;
+
+            uint32_t color = c0;
+            if (!uniform) {
+                color = 0;
+                for (int i = 0; i < 4; ++i) {
+                    float value = l0 * channel(c0, i) + l1 * channel(c1, i) + l2 * channel(c2, i);
+                    color |= static_cast<uint32_t>(std::clamp(value + 0.5f, 0.0f, 255.0f)) << (i * 8);
+                }
+            }
+
+            if (texture) {
+                float u = l0 * p0->u + l1 * p1->u + l2 * p2->u;
+                float v = l0 * p0->v + l1 * p1->v + l2 * p2->v;
+                color = modulate(color, linear ? sample_linear(*texture, u, v) : sample(*texture, u, v));
+            }
+
+            row[x] = blend(row[x], color);
+        }
+    }
+}
+
+// One pixel per step along the major axis, the last pixel is left out like GL does
+static void line(Surface& surface, const drawlist::Vertex& a, const drawlist::Vertex& b, int x0, int y0, int x1, int y1) {
+    float dx = b.x - a.x;
+    float dy = b.y - a.y;
+    uint32_t color = pack(a.color);
+
+    if (std::fabs(dx) >= std::fabs(dy)) {
+        if (dx == 0.0f) {
+            return;
+        }
+        float slope = dy / dx;
+        int first = std::max(x0, static_cast<int>(std::ceil(std::min(a.x, b.x) - 0.5f)));
+        int last = std::min(x1, static_cast<int>(std::ceil(std::max(a.x, b.x) - 0.5f)));
+        for (int x = first; x < last; ++x) {
+            int y = static_cast<int>(std::floor(a.y + (x + 0.5f - a.x) * slope));
+            if (y >= y0 && y < y1) {
+                uint32_t* pixel = surface.pixels.data() + static_cast<size_t>(y) * surface.width + x;
+                *pixel = blend(*pixel, color);
+            }
+        }
+    } else {
+        float slope = dx / dy;
+        int first = std::max(y0, static_cast<int>(std::ceil(std::min(a.y, b.y) - 0.5f)));
+        int last = std::min(y1, static_cast<int>(std::ceil(std::max(a.y, b.y) - 0.5f)));
+        for (int y = first; y < last; ++y) {
+            int x = static_cast<int>(std::floor(a.x + (y + 0.5f - a.y) * slope));
+            if (x >= x0 && x < x1) {
+                uint32_t* pixel = surface.pixels.data() + static_cast<size_t>(y) * surface.width + x;
+                *pixel = blend(*pixel, color);
+            }
+        }
+    }
+}
+
+// Copy a texture back from the GPU once, it is sampled from memory after that
+static const Surface* read_texture(State& s, unsigned int id) {
+    auto cached = s.textures.find(id);
+    if (cached != s.textures.end()) {
+        return cached->second.width > 0 ? &cached->second : nullptr;
+    }
+
+    Surface& surface = s.textures[id];
+
+    int width = 0;
+    int height = 0;
+    glBindTexture(GL_TEXTURE_2D, id);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    if (width <= 0 || height <= 0) {
+        return nullptr;
+    }
+
+    void* pixels = rlReadTexturePixels(id, width, height, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+    if (!pixels) {
+        return nullptr;
+    }
+
+    surface.resize(width, height);
+    memcpy(surface.pixels.data(), pixels, surface.pixels.size() * sizeof(uint32_t));
+    MemFree(pixels);
+    s.readbackCounter.add();
+
+    return &surface;
+}
+
+// `self` is the target being flushed, which tiles write while others read the texture
+static const Surface* resolve_texture(State& s, unsigned int id, unsigned int self) {
+    if (id == rlGetTextureIdDefault()) {
+        return nullptr;
+    }
+
+    // a target sampled while it is drawn into gives what it held before the draw,
+    // GL leaves that case undefined
+    if (id == self) {
+        return &s.snapshot;
+    }
+
+    auto target = s.targets.find(id);
+    if (target != s.targets.end()) {
+        return &target->second.surface;
+    }
+
+    return read_texture(s, id);
+}
+
+// Whether the texture is magnified with GL_LINEAR, which bilinear, trilinear and
+// anisotropic filters all use. Asked once per texture and flush, setfilter only
+// changes GL state.
+static bool linear_filter(State& s, unsigned int id) {
+    auto cached = s.filters.find(id);
+    if (cached != s.filters.end()) {
+        return cached->second;
+    }
+
+    GLint filter = GL_NEAREST;
+    glBindTexture(GL_TEXTURE_2D, id);
+    glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, &filter);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    bool linear = filter == GL_LINEAR;
+    s.filters.emplace(id, linear);
+    return linear;
+}
+
+static bool samples(const drawlist::Span& span, unsigned int id) {
+    return id != 0 && span.mode != drawlist::kClear && span.mode != RL_LINES && span.texture == id;
+}
+
+static void bounds(Primitive& primitive, const drawlist::Vertex* vertices, int count, const Surface& surface) {
+    float minX = vertices[primitive.v[0]].x;
+    float maxX = minX;
+    float minY = vertices[primitive.v[0]].y;
+    float maxY = minY;
+    for (int i = 1; i < count; ++i) {
+        const drawlist::Vertex& vertex = vertices[primitive.v[i]];
+        minX = std::min(minX, vertex.x);
+        maxX = std::max(maxX, vertex.x);
+        minY = std::min(minY, vertex.y);
+        maxY = std::max(maxY, vertex.y);
+    }
+
+    primitive.minX = std::max(0, static_cast<int>(std::floor(minX)) - 1);
+    primitive.minY = std::max(0, static_cast<int>(std::floor(minY)) - 1);
+    primitive.maxX = std::min(surface.width, static_cast<int>(std::ceil(maxX)) + 1);
+    primitive.maxY = std::min(surface.height, static_cast<int>(std::ceil(maxY)) + 1);
+}
+
+// Primitives of spans [firstSpan, endSpan) of the list drawn into target `self`
+static void build_primitives(State& s, const drawlist::DrawList& list, size_t firstSpan, size_t endSpan, const Surface& surface, unsigned int self) {
+    s.primitives.clear();
+    const drawlist::Vertex* vertices = list.vertices.data();
+
+    auto add = [&](Kind kind, uint32_t a, uint32_t b, uint32_t c, const Surface* texture, bool linear) {
+        Primitive primitive{ kind, { a, b, c }, texture, linear, 0, 0, surface.width, surface.height };
+        if (kind != Kind::CLEAR) {
+            bounds(primitive, vertices, kind == Kind::LINE ? 2 : 3, surface);
+            if (primitive.minX >= primitive.maxX || primitive.minY >= primitive.maxY) {
+                return;
+            }
+        }
+        s.primitives.push_back(primitive);
+    };
+
+    for (size_t index = firstSpan; index < endSpan; ++index) {
+        const drawlist::Span& span = list.spans[index];
+        uint32_t first = static_cast<uint32_t>(span.first);
+        uint32_t end = static_cast<uint32_t>(span.first + span.count);
+
+        if (span.mode == drawlist::kClear) {
+            add(Kind::CLEAR, first, first, first, nullptr, false);
+            continue;
+        }
+
+        if (span.mode == RL_LINES) {
+            for (uint32_t i = first; i + 2 <= end; i += 2) {
+                add(Kind::LINE, i, i + 1, i + 1, nullptr, false);
+            }
+            continue;
+        }
+
+        const Surface* texture = resolve_texture(s, span.texture, self);
+        bool linear = texture && linear_filter(s, span.texture);
+
+        if (span.mode == RL_TRIANGLES) {
+            for (uint32_t i = first; i + 3 <= end; i += 3) {
+                add(Kind::TRIANGLE, i, i + 1, i + 2, texture, linear);
+            }
+        } else {
+            for (uint32_t i = first; i + 4 <= end; i += 4) {
+                add(Kind::TRIANGLE, i, i + 1, i + 2, texture, linear);
+                add(Kind::TRIANGLE, i, i + 2, i + 3, texture, linear);
+            }
+        }
+    }
+}
+
+// Bin the built primitives into tiles and rasterize them on the job workers
+static void rasterize(State& s, Surface& surface, const drawlist::Vertex* vertices) {
+    int columns = (surface.width + kTileSize - 1) / kTileSize;
+    int rows = (surface.height + kTileSize - 1) / kTileSize;
+    size_t tiles = static_cast<size_t>(columns) * rows;
+    if (s.bins.size() < tiles) {
+        s.bins.resize(tiles);
+    }
+    for (size_t i = 0; i < tiles; ++i) {
+        s.bins[i].clear();
+    }
+
+    // binned in draw order, so every tile replays its primitives in that order too
+    for (uint32_t index = 0; index < s.primitives.size(); ++index) {
+        const Primitive& primitive = s.primitives[index];
+        int firstColumn = primitive.minX / kTileSize;
+        int lastColumn = (primitive.maxX - 1) / kTileSize;
+        int firstRow = primitive.minY / kTileSize;
+        int lastRow = (primitive.maxY - 1) / kTileSize;
+        for (int row = firstRow; row <= lastRow; ++row) {
+            for (int column = firstColumn; column <= lastColumn; ++column) {
+                s.bins[static_cast<size_t>(row) * columns + column].push_back(index);
+            }
+        }
+    }
+
+    jobs::parallel_for(tiles, kGrain, [&](size_t begin, size_t end) {
+        for (size_t tile = begin; tile < end; ++tile) {
+            int tileX = static_cast<int>(tile % columns) * kTileSize;
+            int tileY = static_cast<int>(tile / columns) * kTileSize;
+            int tileRight = std::min(tileX + kTileSize, surface.width);
+            int tileBottom = std::min(tileY + kTileSize, surface.height);
+
+            for (uint32_t index : s.bins[tile]) {
+                const Primitive& primitive = s.primitives[index];
+                int x0 = std::max(tileX, primitive.minX);
+                int y0 = std::max(tileY, primitive.minY);
+                int x1 = std::min(tileRight, primitive.maxX);
+                int y1 = std::min(tileBottom, primitive.maxY);
+
+                switch (primitive.kind) {
+                case Kind::CLEAR: {
+                    uint32_t color = pack(vertices[primitive.v[0]].color);
+                    for (int y = y0; y < y1; ++y) {
+                        uint32_t* row = surface.pixels.data() + static_cast<size_t>(y) * surface.width;
+                        std::fill(row + x0, row + x1, color);
+                    }
+                    break;
+                }
+                case Kind::LINE:
+                    line(surface, vertices[primitive.v[0]], vertices[primitive.v[1]], x0, y0, x1, y1);
+                    break;
+                case Kind::TRIANGLE:
+                    triangle(surface, &vertices[primitive.v[0]], &vertices[primitive.v[1]], &vertices[primitive.v[2]], primitive.texture, primitive.linear, x0, y0, x1, y1);
+                    break;
+                }
+            }
+        }
+    });
+
+    s.primitiveCounter.add(s.primitives.size());
+    s.tileCounter.add(tiles);
+}
+
+// Rasterize and empty the target's list, then hand the pixels to its GPU texture
+static void flush(State& s, Target& target) {
+    drawlist::DrawList& list = target.commands;
+    Surface& surface = target.surface;
+
+    if (target.rendertexture.id == 0) {
+        int width = GetScreenWidth();
+        int height = GetScreenHeight();
+        if (surface.width != width || surface.height != height) {
+            surface.resize(width, height);
+        }
+    }
+
+    if (list.spans.empty() || surface.width == 0 || surface.height == 0) {
+        return;
+    }
+
+    // A draw sampling the target itself starts a pass of its own that reads a
+    // snapshot, tiles of one pass never read pixels another tile writes
+    unsigned int self = target.rendertexture.texture.id;
+    s.filters.clear();
+    for (size_t first = 0; first < list.spans.size();) {
+        size_t end = first + 1;
+        while (end < list.spans.size() && !samples(list.spans[end], self)) {
+            end++;
+        }
+
+        if (samples(list.spans[first], self)) {
+            s.snapshot = surface;
+        }
+
+        build_primitives(s, list, first, end, surface, self);
+        rasterize(s, surface, list.vertices.data());
+        first = end;
+    }
+
+    list.vertices.clear();
+    list.spans.clear();
+
+    // keep the GPU copy in step for readbacks, images made from the target and
+    // anything else that reads it through GL
+    const RenderTexture& rendertexture = target.rendertexture;
+    if (rendertexture.id != 0 && rendertexture.texture.format == PIXELFORMAT_UNCOMPRESSED_R8G8B8A8) {
+        s.upload.resize(surface.pixels.size());
+        for (int y = 0; y < surface.height; ++y) {
+            const uint32_t* source = surface.pixels.data() + static_cast<size_t>(surface.height - 1 - y) * surface.width;
+            std::copy(source, source + surface.width, s.upload.data() + static_cast<size_t>(y) * surface.width);
+        }
+        UpdateTexture(rendertexture.texture, s.upload.data());
+    }
+}
+
+void enable() {
+    State& s = state();
+    s.enabled = true;
+    s.current = &s.screen;
+}
+
+bool enabled() {
+    return state().enabled;
+}
+
+drawlist::DrawList* commands() {
+    State& s = state();
+    return s.enabled ? &s.current->commands : nullptr;
+}
+
+void begin_target(const RenderTexture& rendertexture) {
+    State& s = state();
+
+    // like a batch flush in rlgl, what was drawn so far lands before the switch
+    flush(s, *s.current);
+
+    Target& target = s.targets[rendertexture.texture.id];
+    if (target.surface.width != rendertexture.texture.width || target.surface.height != rendertexture.texture.height) {
+        target.surface.resize(rendertexture.texture.width, rendertexture.texture.height);
+        target.surface.flipped = true;
+    }
+    target.rendertexture = rendertexture;
+    s.current = &target;
+}
+
+void end_target() {
+    State& s = state();
+    flush(s, *s.current);
+    s.current = &s.screen;
+}
+
+void present() {
+    State& s = state();
+    if (!s.enabled) {
+        return;
+    }
+
+    // a target left open ends with the frame
+    if (s.current != &s.screen) {
+        end_target();
+    }
+    flush(s, s.screen);
+
+    const Surface& surface = s.screen.surface;
+    if (surface.width == 0 || surface.height == 0) {
+        return;
+    }
+
+    if (s.presented.width != surface.width || s.presented.height != surface.height) {
+        if (s.presented.id != 0) {
+            rlUnloadTexture(s.presented.id);
+        }
+        s.presented.id = rlLoadTexture(nullptr, surface.width, surface.height, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8, 1);
+        s.presented.width = surface.width;
+        s.presented.height = surface.height;
+        s.presented.mipmaps = 1;
+        s.presented.format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8;
+    }
+
+    UpdateTexture(s.presented, surface.pixels.data());
+
+    // a straight copy, alpha included, so readbacks see what the CPU drew
+    rlDrawRenderBatchActive();
+    rlDisableColorBlend();
+    DrawTexture(s.presented, 0, 0, WHITE);
+    rlDrawRenderBatchActive();
+    rlEnableColorBlend();
+}
+
+void forget(unsigned int textureId) {
+    State& s = state();
+    if (!s.enabled) {
+        return;
+    }
+
+    // what was drawn so far samples the old pixels, as rlgl's batch flush would
+    flush(s, *s.current);
+    s.textures.erase(textureId);
+
+    auto target = s.targets.find(textureId);
+    if (target != s.targets.end() && &target->second != s.current) {
+        s.targets.erase(target);
+    }
+}
+
+void shutdown() {
+    State& s = state();
+    if (s.presented.id != 0) {
+        rlUnloadTexture(s.presented.id);
+        s.presented = Texture2D{};
+    }
+
+    s.current = &s.screen;
+    s.targets.clear();
+    s.textures.clear();
+}
+
+} // namespace software
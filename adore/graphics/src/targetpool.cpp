@@ -0,0 +1,149 @@
+#include "adore/targetpool.h"
+
+#include "adore/resources.h"
+#include "adore/metrics.h"
+#include <unordered_map>
+#include <vector>
+#include "raylib.h"
+#include "rlgl.h"
+
+namespace targetpool {
+
+// Free targets unused for this many frames are unloaded, about five seconds at 60 fps
+constexpr uint64_t kIdleFrames = 300;
+
+struct FreeTarget {
+    RenderTexture target;
+    uint64_t frame;
+};
+
+struct PoolState {
+    std::unordered_map<uint64_t, std::vector<FreeTarget>> free;
+    std::unordered_map<unsigned int, RenderTexture> inuse;
+    size_t freeCount = 0;
+    // set by shutdown(), which has unloaded the targets still handed out
+    bool closed = false;
+    uint64_t frame = 0;
+    uint64_t created = 0;
+    uint64_t reused = 0;
+
+    metrics::Counter& hits = metrics::counter("adore_graphics_target_pool_total", "Render texture pool acquisitions", metrics::label("result", "reused"));
+    metrics::Counter& misses = metrics::counter("adore_graphics_target_pool_total", "Render texture pool acquisitions", metrics::label("result", "created"));
+};
+
+static PoolState& state() {
+    static PoolState instance;
+    return instance;
+}
+
+static uint64_t key_of(int width, int height, int format) {
+    return (static_cast<uint64_t>(width) << 40) | (static_cast<uint64_t>(height) << 16) | static_cast<uint64_t>(format);
+}
+
+// LoadRenderTexture with the color attachment swapped for the requested format
+RenderTexture load(int width, int height, int format) {
+    RenderTexture target = LoadRenderTexture(width, height);
+    if (target.id == 0 || format == PIXELFORMAT_UNCOMPRESSED_R8G8B8A8) {
+        return target;
+    }
+
+    rlUnloadTexture(target.texture.id);
+    target.texture.id = rlLoadTexture(nullptr, width, height, format, 1);
+    target.texture.format = format;
+    rlFramebufferAttach(target.id, target.texture.id, RL_ATTACHMENT_COLOR_CHANNEL0, RL_ATTACHMENT_TEXTURE2D, 0);
+
+    if (target.texture.id == 0 || !rlFramebufferComplete(target.id)) {
+        UnloadRenderTexture(target);
+        return RenderTexture{};
+    }
+
+    return target;
+}
+
+RenderTexture acquire(int width, int height, int format) {
+    PoolState& s = state();
+
+    auto it = s.free.find(key_of(width, height, format));
+    if (it != s.free.end() && !it->second.empty()) {
+        // the most recently returned target is the most likely to still be resident
+        RenderTexture target = it->second.back().target;
+        it->second.pop_back();
+        s.freeCount--;
+        s.reused++;
+        s.hits.add();
+
+        s.inuse.emplace(target.id, target);
+        return target;
+    }
+
+    RenderTexture target = load(width, height, format);
+    if (target.id == 0) {
+        return target;
+    }
+
+    s.created++;
+    s.misses.add();
+    resources::track(resources::Kind::RENDERTEXTURE, resources::rendertexture_bytes(target));
+
+    s.inuse.emplace(target.id, target);
+    return target;
+}
+
+bool release(const RenderTexture& rendertexture) {
+    PoolState& s = state();
+    if (s.inuse.erase(rendertexture.id) == 0) {
+        return false;
+    }
+
+    // released by a finalizer after shutdown, the target is already gone
+    if (s.closed) {
+        return true;
+    }
+
+    s.free[key_of(rendertexture.texture.width, rendertexture.texture.height, rendertexture.texture.format)].push_back(FreeTarget{rendertexture, s.frame});
+    s.freeCount++;
+    return true;
+}
+
+void end_frame() {
+    PoolState& s = state();
+    s.frame++;
+
+    for (auto& [key, targets] : s.free) {
+        size_t kept = 0;
+        for (FreeTarget& entry : targets) {
+            if (s.frame - entry.frame > kIdleFrames) {
+                resources::defer(entry.target);
+                s.freeCount--;
+            } else {
+                targets[kept++] = entry;
+            }
+        }
+        targets.resize(kept);
+    }
+}
+
+void shutdown() {
+    PoolState& s = state();
+    for (auto& [key, targets] : s.free) {
+        for (FreeTarget& entry : targets) {
+            resources::defer(entry.target);
+        }
+    }
+
+    // their handles are only collected when the state closes, after the window is gone
+    for (auto& [id, target] : s.inuse) {
+        resources::defer(target);
+    }
+
+    s.free.clear();
+    s.freeCount = 0;
+    s.closed = true;
+}
+
+Stats stats() {
+    PoolState& s = state();
+    return Stats{s.freeCount, s.inuse.size(), s.created, s.reused};
+}
+
+} // namespace targetpool
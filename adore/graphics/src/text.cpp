@@ -0,0 +1,470 @@
+#include "adore/text.h"
+
+#include "adore/core.h"
+#include "adore/window.h"
+#include "adore/colors.h"
+#include "adore/font.h"
+#include "adore/drawlist.h"
+#include "adore/software.h"
+#include "adore/shader.h"
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include "raylib.h"
+#include "rlgl.h"
+
+namespace text {
+
+// text -> font it was laid out with, weak so the text can be collected
+static const char* kFontsRegistryKey = "adore.graphics.textfonts";
+
+// raylib's default spacing between lines of text
+constexpr float kLineSpacing = 2.0f;
+constexpr float kDefaultSize = 20.0f;
+
+constexpr size_t kNoBreak = static_cast<size_t>(-1);
+
+static const std::pair<const char*, Align> alignModes[] = {
+    { "left", Align::LEFT },
+    { "center", Align::CENTER },
+    { "right", Align::RIGHT },
+};
+
+const Font& Text::source() const {
+    static Font fallback = {};
+    if (font) {
+        return *font;
+    }
+
+    fallback = GetFontDefault();
+    return fallback;
+}
+
+void Text::layout(size_t from) {
+    const Font& fontSource = source();
+
+    size_t cursor = 0;
+    if (from < lines.size()) {
+        cursor = lines[from].start;
+        glyphs.resize(lines[from].firstGlyph);
+        lines.resize(from);
+    } else {
+        glyphs.clear();
+        lines.clear();
+    }
+
+    float lineHeight = size + kLineSpacing;
+    float scale = fontSource.baseSize > 0 ? size / fontSource.baseSize : 1.0f;
+    float padding = static_cast<float>(fontSource.glyphPadding);
+
+    lines.push_back(Line{glyphs.size(), cursor, 0.0f});
+    float penX = 0.0f;
+
+    // where the current line may be wrapped, just after its last space
+    size_t breakGlyph = kNoBreak;
+    size_t breakStart = 0;
+    float breakX = 0.0f;
+    float breakWidth = 0.0f;
+
+    auto new_line = [&](size_t firstGlyph, size_t start, float width) {
+        lines.back().width = width;
+        lines.push_back(Line{firstGlyph, start, 0.0f});
+        breakGlyph = kNoBreak;
+    };
+
+    const char* data = string.c_str();
+    while (cursor < string.size()) {
+        int length = 0;
+        int codepoint = GetCodepointNext(data + cursor, &length);
+        cursor += length > 0 ? length : 1;
+
+        if (codepoint == '\n') {
+            new_line(glyphs.size(), cursor, penX > 0.0f ? penX - spacing : 0.0f);
+            penX = 0.0f;
+            continue;
+        }
+
+        if (fontSource.glyphs == nullptr) {
+            continue;
+        }
+
+        int glyphIndex = GetGlyphIndex(fontSource, codepoint);
+        const Rectangle& rec = fontSource.recs[glyphIndex];
+        const GlyphInfo& info = fontSource.glyphs[glyphIndex];
+        float advance = (info.advanceX == 0 ? rec.width : info.advanceX) * scale;
+
+        if (codepoint == ' ' || codepoint == '\t') {
+            breakGlyph = glyphs.size();
+            breakStart = cursor;
+            breakWidth = penX > 0.0f ? penX - spacing : 0.0f;
+            penX += advance + spacing;
+            breakX = penX;
+            continue;
+        }
+
+        if (wrap > 0.0f && penX > 0.0f && penX + rec.width * scale > wrap) {
+            int line = static_cast<int>(lines.size());
+            if (breakGlyph != kNoBreak) {
+                // move the word being written onto the next line
+                for (size_t i = breakGlyph; i < glyphs.size(); ++i) {
+                    glyphs[i].line = line;
+                    glyphs[i].dest.x -= breakX;
+                    glyphs[i].dest.y += lineHeight;
+                }
+                new_line(breakGlyph, breakStart, breakWidth);
+                penX -= breakX;
+            } else {
+                // a single word longer than the line
+                new_line(glyphs.size(), cursor - (length > 0 ? length : 1), penX - spacing);
+                penX = 0.0f;
+            }
+        }
+
+        int line = static_cast<int>(lines.size()) - 1;
+        Rectangle source = { rec.x - padding, rec.y - padding, rec.width + 2.0f * padding, rec.height + 2.0f * padding };
+        Rectangle dest = {
+            penX + info.offsetX * scale - padding * scale,
+            line * lineHeight + info.offsetY * scale - padding * scale,
+            source.width * scale,
+            source.height * scale,
+        };
+        glyphs.push_back(Glyph{line, source, dest});
+
+        penX += advance + spacing;
+    }
+
+    lines.back().width = penX > 0.0f ? penX - spacing : 0.0f;
+
+    width = 0.0f;
+    for (const Line& line : lines) {
+        width = std::max(width, line.width);
+    }
+    height = lines.size() * size + (lines.size() - 1) * kLineSpacing;
+}
+
+void Text::set(const char* value, size_t length) {
+    size_t common = 0;
+    size_t limit = std::min(length, string.size());
+    while (common < limit && string[common] == value[common]) {
+        common++;
+    }
+
+    if (common == string.size() && common == length) {
+        return;
+    }
+
+    string.assign(value, length);
+
+    // the line holding the first change, lines before it are unaffected
+    size_t from = 0;
+    while (from + 1 < lines.size() && lines[from + 1].start <= common) {
+        from++;
+    }
+
+    // a shorter first word may now fit on the line before
+    if (wrap > 0.0f && from > 0) {
+        from--;
+    }
+
+    layout(from);
+}
+
+static void push_fonts_table(lua_State* L) {
+    lua_getfield(L, LUA_REGISTRYINDEX, kFontsRegistryKey);
+    if (lua_istable(L, -1)) {
+        return;
+    }
+    lua_pop(L, 1);
+
+    lua_newtable(L);
+    lua_createtable(L, 0, 1);
+    lua_pushstring(L, "k");
+    lua_setfield(L, -2, "__mode");
+    lua_setmetatable(L, -2);
+
+    lua_pushvalue(L, -1);
+    lua_setfield(L, LUA_REGISTRYINDEX, kFontsRegistryKey);
+}
+
+static Align check_align(lua_State* L, int index) {
+    const char* name = luaL_checkstring(L, index);
+    for (const auto& [key, align] : alignModes) {
+        if (strcmp(key, name) == 0) {
+            return align;
+        }
+    }
+
+    luaL_error(L, "Invalid text alignment: %s", name);
+    return Align::LEFT;
+}
+
+int create(lua_State* L) {
+    WINDOW_NOT_INITIALIZED_CHECK();
+
+    size_t length;
+    const char* string = luaL_checklstring(L, 1, &length);
+    bool hasOptions = !lua_isnoneornil(L, 2);
+    if (hasOptions) {
+        luaL_checktype(L, 2, LUA_TTABLE);
+    }
+
+    Font* font = nullptr;
+    float size = kDefaultSize;
+    float spacing = -1.0f;
+    float wrap = 0.0f;
+    Align align = Align::LEFT;
+
+    if (hasOptions) {
+        lua_getfield(L, 2, "font");
+        if (!lua_isnil(L, -1)) {
+            font = font::check_font(L, -1);
+        }
+        lua_pop(L, 1);
+
+        lua_getfield(L, 2, "size");
+        size = lua_isnil(L, -1) ? size : static_cast<float>(luaL_checknumber(L, -1));
+        lua_pop(L, 1);
+
+        lua_getfield(L, 2, "spacing");
+        spacing = lua_isnil(L, -1) ? spacing : static_cast<float>(luaL_checknumber(L, -1));
+        lua_pop(L, 1);
+
+        lua_getfield(L, 2, "wrap");
+        wrap = lua_isnil(L, -1) ? wrap : static_cast<float>(luaL_checknumber(L, -1));
+        lua_pop(L, 1);
+
+        lua_getfield(L, 2, "align");
+        align = lua_isnil(L, -1) ? align : check_align(L, -1);
+        lua_pop(L, 1);
+    }
+
+    if (spacing < 0.0f) {
+        // same defaults as DrawText for the default font and font.draw otherwise
+        spacing = font ? 1.0f : static_cast<float>(static_cast<int>(size) / 10);
+    }
+
+    void* ud = lua_newuserdatatagged(L, sizeof(Text), kTextUserdataTag);
+    Text* text = new (ud) Text();
+    lua_getuserdatametatable(L, kTextUserdataTag);
+    lua_setmetatable(L, -2);
+
+    text->string.assign(string, length);
+    text->font = font;
+    text->size = size;
+    text->spacing = spacing;
+    text->wrap = wrap;
+    text->align = align;
+    text->layout(0);
+
+    if (font) {
+        push_fonts_table(L);
+        lua_pushvalue(L, -2);
+        lua_getfield(L, 2, "font");
+        lua_rawset(L, -3);
+        lua_pop(L, 1);
+    }
+
+    return 1;
+}
+
+Text* check_text(lua_State* L, int index) {
+    void* ud = lua_touserdatatagged(L, index, kTextUserdataTag);
+    if (!ud) {
+        luaL_typeerror(L, index, "Text");
+    }
+    return static_cast<Text*>(ud);
+}
+
+int index(lua_State* L) {
+    const char* key = luaL_checkstring(L, 2);
+
+    for (auto& [name, func] : udata) {
+        if (name && strcmp(name, key) == 0) {
+            lua_pushcfunction(L, func, name);
+            return 1;
+        }
+    }
+
+    Text* text = check_text(L, 1);
+
+    if (strcmp(key, "text") == 0) {
+        lua_pushlstring(L, text->string.data(), text->string.size());
+        return 1;
+    } else if (strcmp(key, "width") == 0) {
+        lua_pushnumber(L, text->width);
+        return 1;
+    } else if (strcmp(key, "height") == 0) {
+        lua_pushnumber(L, text->height);
+        return 1;
+    } else if (strcmp(key, "lines") == 0) {
+        lua_pushinteger(L, static_cast<int>(text->lines.size()));
+        return 1;
+    } else if (strcmp(key, "size") == 0) {
+        lua_pushnumber(L, text->size);
+        return 1;
+    }
+
+    luaL_error(L, "Attempt to access invalid Text property: %s", key);
+    return 0;
+}
+
+int draw(lua_State* L) {
+    WINDOW_NOT_INITIALIZED_CHECK();
+
+    Text* text = check_text(L, 1);
+    float x = static_cast<float>(luaL_checknumber(L, 2));
+    float y = static_cast<float>(luaL_checknumber(L, 3));
+    Color tint = lua_isnoneornil(L, 4) ? WHITE : color::check_color(L, 4);
+
+    if (text->font && text->font->texture.id == 0) {
+        luaL_error(L, "Font has been released");
+    }
+
+    const Texture2D& texture = text->source().texture;
+    if (texture.id == 0 || text->glyphs.empty()) {
+        return 0;
+    }
+
+    // alignment only shifts whole lines, it never needs a new layout
+    float box = text->wrap > 0.0f ? text->wrap : text->width;
+    float factor = text->align == Align::CENTER ? 0.5f : text->align == Align::RIGHT ? 1.0f : 0.0f;
+    std::vector<float> offsets(text->lines.size());
+    for (size_t i = 0; i < text->lines.size(); ++i) {
+        offsets[i] = x + (box - text->lines[i].width) * factor;
+    }
+
+    bool sdf = font::is_sdf(text->source());
+    if (sdf && drawlist::recording()) {
+        luaL_error(L, "SDF fonts cannot be drawn while recording a DrawList");
+    }
+    if (sdf) {
+        SOFTWARE_UNSUPPORTED_CHECK("SDF fonts");
+    }
+
+    if (drawlist::DrawList* list = drawlist::capture()) {
+        // the text keeps its font alive, the default font lives as long as the window
+        drawlist::anchor(L, 1);
+        const unsigned int* owner = text->font ? &text->font->texture.id : nullptr;
+        for (const Glyph& glyph : text->glyphs) {
+            Rectangle dest = glyph.dest;
+            dest.x += offsets[glyph.line];
+            dest.y += y;
+            list->texture(texture, glyph.source, dest, { 0.0f, 0.0f }, 0.0f, tint, owner);
+        }
+        return 0;
+    }
+
+    float width = static_cast<float>(texture.width);
+    float height = static_cast<float>(texture.height);
+
+    if (sdf) {
+        BeginShaderMode(font::sdf_shader());
+    }
+
+    rlSetTexture(texture.id);
+    rlBegin(RL_QUADS);
+    rlColor4ub(tint.r, tint.g, tint.b, tint.a);
+    rlNormal3f(0.0f, 0.0f, 1.0f);
+
+    for (const Glyph& glyph : text->glyphs) {
+        // flushes the batch when it is full and keeps our texture and mode
+        rlCheckRenderBatchLimit(4);
+
+        float left = glyph.dest.x + offsets[glyph.line];
+        float top = glyph.dest.y + y;
+        float right = left + glyph.dest.width;
+        float bottom = top + glyph.dest.height;
+
+        float u0 = glyph.source.x / width;
+        float v0 = glyph.source.y / height;
+        float u1 = (glyph.source.x + glyph.source.width) / width;
+        float v1 = (glyph.source.y + glyph.source.height) / height;
+
+        rlTexCoord2f(u0, v0);
+        rlVertex2f(left, top);
+        rlTexCoord2f(u0, v1);
+        rlVertex2f(left, bottom);
+        rlTexCoord2f(u1, v1);
+        rlVertex2f(right, bottom);
+        rlTexCoord2f(u1, v0);
+        rlVertex2f(right, top);
+    }
+
+    rlEnd();
+    rlSetTexture(0);
+
+    if (sdf) {
+        EndShaderMode();
+
+        // back to the script's shader pass if the text was drawn inside one
+        if (const Shader* active = shader::active()) {
+            BeginShaderMode(*active);
+        }
+    }
+
+    return 0;
+}
+
+int set(lua_State* L) {
+    Text* text = check_text(L, 1);
+    size_t length;
+    const char* string = luaL_checklstring(L, 2, &length);
+
+    if (text->font && text->font->texture.id == 0) {
+        luaL_error(L, "Font has been released");
+    }
+
+    text->set(string, length);
+    return 0;
+}
+
+int setwrap(lua_State* L) {
+    Text* text = check_text(L, 1);
+    float wrap = static_cast<float>(luaL_checknumber(L, 2));
+
+    if (text->font && text->font->texture.id == 0) {
+        luaL_error(L, "Font has been released");
+    }
+
+    if (wrap != text->wrap) {
+        text->wrap = wrap;
+        text->layout(0);
+    }
+    return 0;
+}
+
+int setalign(lua_State* L) {
+    Text* text = check_text(L, 1);
+    text->align = check_align(L, 2);
+    return 0;
+}
+
+} // namespace text
+
+
+int adoreregister_text(lua_State* L)
+{
+    luaL_newmetatable(L, "Text");
+    lua_pushvalue(L, -1);
+    lua_setuserdatametatable(L, kTextUserdataTag);
+
+    lua_pushcfunction(L, text::index, nullptr);
+    lua_setfield(L, -2, "__index");
+
+    lua_setreadonly(L, -1, true);
+
+    lua_setuserdatadtor(L, kTextUserdataTag,
+        [](lua_State* L, void* ud)
+        {
+            static_cast<text::Text*>(ud)->~Text();
+        }
+    );
+
+    lua_pop(L, 1);
+
+    lua_createtable(L, 0, std::size(text::lib));
+    luaL_register(L, nullptr, text::lib); //
+    lua_setreadonly(L, -1, true);
+
+    return 1;
+}
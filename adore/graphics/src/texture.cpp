@@ -4,9 +4,18 @@
 #include "adore/window.h"
 #include "adore/colors.h"
 #include "adore/image.h"
+#include "adore/resources.h"
+#include "adore/views.h"
+#include "adore/drawlist.h"
+#include "adore/software.h"
+#include "adore/loader.h"
+#include "adore/assets.h"
+#include <cmath>
 #include <memory>
 #include <iostream>
 #include "raylib.h"
+#include "rlgl.h"
+#include "external/glad.h"
 
 namespace texture {
 
@@ -14,6 +23,11 @@ int create_texture_userdata(lua_State* L, const Texture2D& texture, bool owned)
     TextureRef* texPtr = static_cast<TextureRef*>(lua_newuserdatatagged(L, sizeof(TextureRef), kTextureUserdataTag));
     texPtr->texture = texture;
     texPtr->owned = owned;
+    texPtr->region = { 0, 0, static_cast<float>(texture.width), static_cast<float>(texture.height) };
+
+    if (owned) {
+        resources::track(resources::Kind::TEXTURE, resources::texture_bytes(texture));
+    }
 
     lua_getuserdatametatable(L, kTextureUserdataTag);
     lua_setmetatable(L, -2);
@@ -21,17 +35,64 @@ int create_texture_userdata(lua_State* L, const Texture2D& texture, bool owned)
     return 1;
 }
 
+int create_texture_region_userdata(lua_State* L, const Texture2D& texture, const Rectangle& region) {
+    create_texture_userdata(L, texture, false);
+
+    TextureRef* textureRef = static_cast<TextureRef*>(lua_touserdatatagged(L, -1, kTextureUserdataTag));
+    textureRef->region = region;
+
+    return 1;
+}
+
+int push_texture_view(lua_State* L, int ownerIndex, const Texture2D& texture) {
+    if (views::push(L, &texture)) {
+        return 1;
+    }
+
+    create_texture_userdata(L, texture, false);
+    views::cache(L, ownerIndex, &texture);
+
+    return 1;
+}
+
+void invalidate_texture_view(lua_State* L, const Texture2D& texture) {
+    if (!views::push(L, &texture)) {
+        return;
+    }
+
+    TextureRef* textureRef = static_cast<TextureRef*>(lua_touserdatatagged(L, -1, kTextureUserdataTag));
+    if (textureRef) {
+        textureRef->texture.id = 0;
+    }
+    lua_pop(L, 1);
+}
+
 int load_texture_from_path(lua_State* L) {
     WINDOW_NOT_INITIALIZED_CHECK();
 
     const char* path = luaL_checkstring(L, 1);
 
+    assets::Key key = assets::key(resources::Kind::TEXTURE, path);
+    if (assets::push(L, key)) {
+        return 1;
+    }
+
     Texture2D texture = LoadTexture(path);
     if (texture.id == 0) {
         luaL_error(L, "Failed to load texture: %s", path);
     }
 
-    return create_texture_userdata(L, texture, true);
+    create_texture_userdata(L, texture, true);
+    assets::store(L, -1, key, texture.id);
+    return 1;
+}
+
+int load_texture_async(lua_State* L) {
+    WINDOW_NOT_INITIALIZED_CHECK();
+
+    const char* path = luaL_checkstring(L, 1);
+
+    return loader::load_async(L, path, loader::Target::TEXTURE);
 }
 
 int load_texture_from_image(lua_State* L) {
@@ -52,18 +113,31 @@ TextureRef* check_texture(lua_State* L, int index) {
     if (!ud) {
         luaL_typeerror(L, index, "Texture");
     }
-    return static_cast<TextureRef*>(ud);
+
+    TextureRef* textureRef = static_cast<TextureRef*>(ud);
+    if (textureRef->texture.id == 0) {
+        luaL_error(L, "Texture has been released");
+    }
+    return textureRef;
 }
 
 int index(lua_State* L) {
-    TextureRef* textureRef = check_texture(L, 1);
     const char* key = luaL_checkstring(L, 2);
 
+    for (auto& [name, func] : udata) {
+        if (name && strcmp(name, key) == 0) {
+            lua_pushcfunction(L, func, name);
+            return 1;
+        }
+    }
+
+    TextureRef* textureRef = check_texture(L, 1);
+
     if (strcmp(key, "width") == 0) {
-        lua_pushinteger(L, textureRef->texture.width);
+        lua_pushinteger(L, static_cast<int>(textureRef->region.width));
         return 1;
     } else if (strcmp(key, "height") == 0) {
-        lua_pushinteger(L, textureRef->texture.height);
+        lua_pushinteger(L, static_cast<int>(textureRef->region.height));
         return 1;
     } else if (strcmp(key, "id") == 0) {
         lua_pushinteger(L, textureRef->texture.id);
@@ -80,6 +154,18 @@ int index(lua_State* L) {
     return 0;
 }
 
+// Capture the draw into the DrawList being recorded or the software renderer, returns false when drawing with the GPU
+static bool record_texture(lua_State* L, const TextureRef* textureRef, Rectangle source, Rectangle dest, Vector2 origin, float rotation, Color tint) {
+    drawlist::DrawList* list = drawlist::capture();
+    if (!list) {
+        return false;
+    }
+
+    drawlist::anchor(L, 1);
+    list->texture(textureRef->texture, source, dest, origin, rotation, tint, &textureRef->texture.id);
+    return true;
+}
+
 int draw_texture(lua_State* L) {
     int numargs = lua_gettop(L);
     if (numargs < 3) {
@@ -129,6 +215,14 @@ int draw_texture(lua_State* L) {
         destRect.height = static_cast<float>(luaL_checknumber(L, -1));
         lua_pop(L, 1);
 
+        // source rectangles are relative to the region of atlas sub-textures
+        sourceRect.x += textureRef->region.x;
+        sourceRect.y += textureRef->region.y;
+
+        if (record_texture(L, textureRef, sourceRect, destRect, {0, 0}, 0, color)) {
+            return 0;
+        }
+
         DrawTexturePro(textureRef->texture, sourceRect, destRect, {0, 0}, 0, color);
         return 0;
     }
@@ -136,17 +230,17 @@ int draw_texture(lua_State* L) {
     int x = luaL_checkinteger(L, 2);
     int y = luaL_checkinteger(L, 3);
 
-    if (numargs == 6) {
-        float rotation = static_cast<float>(luaL_checknumber(L, 4));
-        float scale = static_cast<float>(luaL_checknumber(L, 5));
-
-        Vector2 position = { static_cast<float>(x), static_cast<float>(y) };
-        DrawTextureEx(textureRef->texture, position, rotation, scale, color);
+    // what DrawTextureEx does, but limited to the texture's region
+    const Rectangle& region = textureRef->region;
+    float rotation = numargs == 6 ? static_cast<float>(luaL_checknumber(L, 4)) : 0.0f;
+    float scale = numargs == 6 ? static_cast<float>(luaL_checknumber(L, 5)) : 1.0f;
+    Rectangle destRect = { static_cast<float>(x), static_cast<float>(y), region.width * scale, region.height * scale };
+    if (record_texture(L, textureRef, region, destRect, {0, 0}, rotation, color)) {
         return 0;
-    } else {
-        DrawTexture(textureRef->texture, x, y, color);
     }
 
+    DrawTexturePro(textureRef->texture, region, destRect, {0, 0}, rotation, color);
+
     return 0;
 }
 
@@ -161,9 +255,7 @@ int draw_texture_flipped(lua_State* L) {
     int y = luaL_checkinteger(L, 3);
     const char* axis = luaL_checkstring(L, 4);
 
-    Rectangle srcRect = {
-        0, 0, textureRef->texture.width, textureRef->texture.height
-    };
+    Rectangle srcRect = textureRef->region;
 
     if (strcmp(axis, "x") == 0) {
         srcRect.width = -srcRect.width;
@@ -176,24 +268,164 @@ int draw_texture_flipped(lua_State* L) {
         luaL_error(L, "Invalid axis value for drawflipped. Expected 'x', 'y', or 'xy'.");
     }
 
-    DrawTextureRec(textureRef->texture, 
-        srcRect,
-        { static_cast<float>(x), static_cast<float>(y) },
-        WHITE
-    );
+    Rectangle destRect = { static_cast<float>(x), static_cast<float>(y), fabsf(srcRect.width), fabsf(srcRect.height) };
+    if (record_texture(L, textureRef, srcRect, destRect, {0, 0}, 0, WHITE)) {
+        return 0;
+    }
+
+    DrawTexturePro(textureRef->texture, srcRect, destRect, {0, 0}, 0, WHITE);
 
     return 0;
 }
 
+// Copy the texels and sampling state of a texture through a framebuffer, GL 3.3
+// has no glCopyImageSubData. Returns a texture with id 0 on failure.
+static Texture2D copy_texture(const Texture2D& source) {
+    Texture2D copy = { rlLoadTexture(nullptr, source.width, source.height, source.format, 1), source.width, source.height, 1, source.format };
+    if (copy.id == 0) {
+        return copy;
+    }
+
+    GLint previousFramebuffer = 0;
+    GLint previousTexture = 0;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousFramebuffer);
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture);
+
+    GLuint framebuffer = 0;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, source.id, 0);
+    bool complete = glCheckFramebufferStatus(GL_READ_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+    if (complete) {
+        static const GLenum parameters[] = { GL_TEXTURE_MIN_FILTER, GL_TEXTURE_MAG_FILTER, GL_TEXTURE_WRAP_S, GL_TEXTURE_WRAP_T };
+        GLint values[std::size(parameters)];
+        glBindTexture(GL_TEXTURE_2D, source.id);
+        for (size_t i = 0; i < std::size(parameters); ++i) {
+            glGetTexParameteriv(GL_TEXTURE_2D, parameters[i], &values[i]);
+        }
+
+        glBindTexture(GL_TEXTURE_2D, copy.id);
+        glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, source.width, source.height);
+        for (size_t i = 0; i < std::size(parameters); ++i) {
+            glTexParameteri(GL_TEXTURE_2D, parameters[i], values[i]);
+        }
+    }
+
+    glBindTexture(GL_TEXTURE_2D, previousTexture);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, previousFramebuffer);
+    glDeleteFramebuffers(1, &framebuffer);
+
+    if (!complete) {
+        rlUnloadTexture(copy.id);
+        return Texture2D{};
+    }
+
+    if (source.mipmaps > 1) {
+        rlGenTextureMipmaps(copy.id, copy.width, copy.height, copy.format, &copy.mipmaps);
+    }
+    return copy;
+}
+
+// The handle is about to change its texture. Loads of the same file share it,
+// so a shared one is copied first and the other handles keep drawing the
+// original. Textures borrowed from atlases, fonts and render textures change
+// their owner.
+static void make_private(lua_State* L, TextureRef* textureRef) {
+    if (!textureRef->owned) {
+        return;
+    }
+
+    if (!assets::shared(resources::Kind::TEXTURE, textureRef->texture.id)) {
+        // later loads of the file must not get the changed texture
+        assets::forget(resources::Kind::TEXTURE, textureRef->texture.id);
+        return;
+    }
+
+    if (textureRef->texture.format >= PIXELFORMAT_COMPRESSED_DXT1_RGB) {
+        luaL_error(L, "Compressed textures loaded more than once cannot be changed");
+    }
+
+    Texture2D copy = copy_texture(textureRef->texture);
+    if (copy.id == 0) {
+        luaL_error(L, "Failed to copy the texture before changing it");
+    }
+
+    assets::drop(resources::Kind::TEXTURE, textureRef->texture.id);
+    textureRef->texture = copy;
+    resources::track(resources::Kind::TEXTURE, resources::texture_bytes(copy));
+}
+
 int set_filter(lua_State* L) {
     TextureRef* textureRef = check_texture(L, 1);
     int filter = luaL_checkinteger(L, 2);
 
+    make_private(L, textureRef);
     SetTextureFilter(textureRef->texture, filter);
 
     return 0;
 }
 
+int update(lua_State* L) {
+    TextureRef* textureRef = check_texture(L, 1);
+    size_t length;
+    const void* data = luaL_checkbuffer(L, 2, &length);
+
+    // relative to the region of atlas sub-textures, the whole region by default
+    const Rectangle& region = textureRef->region;
+    Rectangle rect = { 0, 0, region.width, region.height };
+    if (!lua_isnoneornil(L, 3)) {
+        luaL_checktype(L, 3, LUA_TTABLE);
+        float* fields[] = { &rect.x, &rect.y, &rect.width, &rect.height };
+        for (int i = 0; i < 4; ++i) {
+            lua_rawgeti(L, 3, i + 1);
+            *fields[i] = static_cast<float>(luaL_checkinteger(L, -1));
+            lua_pop(L, 1);
+        }
+    }
+
+    if (rect.x < 0 || rect.y < 0 || rect.width <= 0 || rect.height <= 0 || rect.x + rect.width > region.width || rect.y + rect.height > region.height) {
+        luaL_error(L, "Update rectangle is outside the texture");
+    }
+
+    int size = GetPixelDataSize(static_cast<int>(rect.width), static_cast<int>(rect.height), textureRef->texture.format);
+    if (static_cast<size_t>(size) > length) {
+        luaL_error(L, "Buffer holds %d bytes, the update needs %d", static_cast<int>(length), size);
+    }
+
+    rect.x += region.x;
+    rect.y += region.y;
+
+    // the contents are no longer what was loaded from the file
+    make_private(L, textureRef);
+
+    // sprites drawn earlier this frame may still be waiting in the batch with the old texels
+    rlDrawRenderBatchActive();
+    software::forget(textureRef->texture.id);
+    UpdateTextureRec(textureRef->texture, rect, data);
+
+    return 0;
+}
+
+int release(lua_State* L) {
+    void* ud = lua_touserdatatagged(L, 1, kTextureUserdataTag);
+    if (!ud) {
+        luaL_typeerror(L, 1, "Texture");
+    }
+
+    // textures borrowed from fonts and render textures are released with their owner
+    TextureRef* textureRef = static_cast<TextureRef*>(ud);
+    // other loads of the same file keep drawing it
+    if (textureRef->owned && textureRef->texture.id != 0 && !assets::drop(resources::Kind::TEXTURE, textureRef->texture.id)) {
+        resources::defer(textureRef->texture);
+    }
+
+    textureRef->texture.id = 0;
+    textureRef->owned = false;
+
+    return 0;
+}
+
 static const std::pair<const char*, TextureFilter> filterModes[] = {
     { "point", TextureFilter::TEXTURE_FILTER_POINT },
     { "bilinear", TextureFilter::TEXTURE_FILTER_BILINEAR },
@@ -221,8 +453,8 @@ int adoreregister_texture(lua_State* L)
         [](lua_State* L, void* ud)
         {
             texture::TextureRef* textureRef = static_cast<texture::TextureRef*>(ud);
-            if (textureRef->owned) {
-                UnloadTexture(textureRef->texture);
+            if (textureRef->owned && !assets::retain(resources::Kind::TEXTURE, textureRef->texture.id, textureRef->texture)) {
+                resources::defer(textureRef->texture);
             }
         }
     );
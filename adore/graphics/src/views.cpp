@@ -0,0 +1,58 @@
+#include "adore/views.h"
+
+namespace views {
+
+// field address -> view, weak so unused views can still be collected
+static const char* kViewsRegistryKey = "adore.graphics.views";
+// view -> owner, weak keyed so the owner lives exactly as long as its views
+static const char* kAnchorsRegistryKey = "adore.graphics.viewanchors";
+
+static void push_weak_table(lua_State* L, const char* key, const char* mode) {
+    lua_getfield(L, LUA_REGISTRYINDEX, key);
+    if (lua_istable(L, -1)) {
+        return;
+    }
+    lua_pop(L, 1);
+
+    lua_newtable(L);
+    lua_createtable(L, 0, 1);
+    lua_pushstring(L, mode);
+    lua_setfield(L, -2, "__mode");
+    lua_setmetatable(L, -2);
+
+    lua_pushvalue(L, -1);
+    lua_setfield(L, LUA_REGISTRYINDEX, key);
+}
+
+bool push(lua_State* L, const void* field) {
+    push_weak_table(L, kViewsRegistryKey, "v");
+    lua_pushlightuserdata(L, const_cast<void*>(field));
+    lua_rawget(L, -2);
+    lua_remove(L, -2);
+
+    if (lua_isnil(L, -1)) {
+        lua_pop(L, 1);
+        return false;
+    }
+
+    return true;
+}
+
+void cache(lua_State* L, int ownerIndex, const void* field) {
+    ownerIndex = lua_absindex(L, ownerIndex);
+    int view = lua_gettop(L);
+
+    push_weak_table(L, kViewsRegistryKey, "v");
+    lua_pushlightuserdata(L, const_cast<void*>(field));
+    lua_pushvalue(L, view);
+    lua_rawset(L, -3);
+    lua_pop(L, 1);
+
+    push_weak_table(L, kAnchorsRegistryKey, "k");
+    lua_pushvalue(L, view);
+    lua_pushvalue(L, ownerIndex);
+    lua_rawset(L, -3);
+    lua_pop(L, 1);
+}
+
+} // namespace views
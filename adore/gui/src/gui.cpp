@@ -1,6 +1,7 @@
 #include "adore/gui.h"
 
 #include "adore/rect.h"
+#include "adore/software.h"
 #include <memory>
 #include <vector>
 #include <iostream>
@@ -13,6 +14,8 @@ namespace gui {
 
 int button(lua_State* L)
 {
+    // raygui draws straight through rlgl
+    SOFTWARE_UNSUPPORTED_CHECK("GUI controls");
     Rectangle rect;
     int end = rect::check_rect(L, 1, &rect);
     const char* text = luaL_checkstring(L, end);
@@ -27,6 +30,7 @@ int button(lua_State* L)
 
 int windowbox(lua_State* L)
 {
+    SOFTWARE_UNSUPPORTED_CHECK("GUI controls");
     Rectangle rect;
     int end = rect::check_rect(L, 1, &rect);
     const char* text = luaL_checkstring(L, end);
@@ -41,6 +45,7 @@ int windowbox(lua_State* L)
 
 int label(lua_State* L)
 {
+    SOFTWARE_UNSUPPORTED_CHECK("GUI controls");
     Rectangle rect;
     int end = rect::check_rect(L, 1, &rect);
     const char* text = luaL_checkstring(L, end);
@@ -50,6 +55,7 @@ int label(lua_State* L)
 
 int title(lua_State* L)
 {
+    SOFTWARE_UNSUPPORTED_CHECK("GUI controls");
     Rectangle rect;
     int end = rect::check_rect(L, 1, &rect);
     const char* text = luaL_checkstring(L, end);
@@ -65,6 +71,7 @@ int title(lua_State* L)
 
 int sliderbar(lua_State* L)
 {
+    SOFTWARE_UNSUPPORTED_CHECK("GUI controls");
     Rectangle rect;
     int end = rect::check_rect(L, 1, &rect);
     const char* textLeft = luaL_optlstring(L, end, NULL, NULL);
@@ -93,6 +100,7 @@ int sliderbar(lua_State* L)
 
 int panel(lua_State* L)
 {
+    SOFTWARE_UNSUPPORTED_CHECK("GUI controls");
     Rectangle rect;
     int end = rect::check_rect(L, 1, &rect);
     const char* text = nullptr;
@@ -169,6 +177,7 @@ static int AdoreGuiComboBox(Rectangle bounds, std::vector<const char*> items, in
 }
 
 int combobox(lua_State* L) {
+    SOFTWARE_UNSUPPORTED_CHECK("GUI controls");
     Rectangle rect;
     int end = rect::check_rect(L, 1, &rect);
     luaL_checktype(L, end, LUA_TTABLE);
@@ -221,6 +230,7 @@ int combobox(lua_State* L) {
 
 int textbox(lua_State* L)
 {
+    SOFTWARE_UNSUPPORTED_CHECK("GUI controls");
     Rectangle rect;
     int end = rect::check_rect(L, 1, &rect);
     size_t buflen;
@@ -238,6 +248,7 @@ int textbox(lua_State* L)
 }
 
 int list(lua_State* L) {
+    SOFTWARE_UNSUPPORTED_CHECK("GUI controls");
     Rectangle bounds;
     int end = rect::check_rect(L, 1, &bounds);
     int count = luaL_checknumber(L, end);
@@ -360,6 +371,7 @@ int list(lua_State* L) {
 
 int valuebox(lua_State* L)
 {
+    SOFTWARE_UNSUPPORTED_CHECK("GUI controls");
     Rectangle rect;
     int end = rect::check_rect(L, 1, &rect);
     int value = static_cast<int>(luaL_checknumber(L, end));
@@ -383,6 +395,7 @@ int valuebox(lua_State* L)
 }
 
 int spinner(lua_State* L) {
+    SOFTWARE_UNSUPPORTED_CHECK("GUI controls");
     Rectangle rect;
     int end = rect::check_rect(L, 1, &rect);
     int value = static_cast<int>(luaL_checknumber(L, end));
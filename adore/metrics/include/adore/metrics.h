@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Process wide metrics in the Prometheus text exposition format.
+//
+// Registering a series takes a lock, so callers look their series up once
+// (typically into a function-local static) and afterwards only touch atomics.
+// Scraping reads the same atomics and never blocks the render thread.
+namespace metrics
+{
+
+struct Counter {
+    std::atomic<uint64_t> value{0};
+
+    void add(uint64_t n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+};
+
+struct Gauge {
+    std::atomic<int64_t> value{0};
+
+    void set(int64_t v) { value.store(v, std::memory_order_relaxed); }
+    void add(int64_t n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+    void sub(int64_t n = 1) { value.fetch_sub(n, std::memory_order_relaxed); }
+};
+
+// Cumulative histogram over fixed upper bounds given in seconds.
+// Observations are accumulated in microseconds so every cell is an integer atomic.
+struct Histogram {
+    std::vector<double> bounds;
+    std::unique_ptr<std::atomic<uint64_t>[]> buckets; // bounds.size() + 1, the last one is +Inf
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sumMicros{0};
+
+    explicit Histogram(const std::vector<double>& bounds);
+
+    void observe(double seconds);
+};
+
+// Default bounds for frame sized durations (1ms .. 1s)
+extern const std::vector<double> kFrameBounds;
+// Default bounds for network round trips (1ms .. 5s)
+extern const std::vector<double> kLatencyBounds;
+
+// Formats a single `key="value"` label pair with the value escaped.
+std::string label(const char* key, const std::string& value);
+
+// Find or create a series. `labels` is a preformatted, comma separated label list (see label()).
+// The returned references stay valid for the lifetime of the process.
+Counter& counter(const char* name, const char* help, const std::string& labels = "");
+Gauge& gauge(const char* name, const char* help, const std::string& labels = "");
+Histogram& histogram(const char* name, const char* help, const std::vector<double>& bounds, const std::string& labels = "");
+
+// Render every registered series as a text exposition page.
+std::string render();
+
+// Serve render() over HTTP on the default libuv loop. Returns false and fills `error` on failure.
+bool serve(const char* host, int port, std::string& error);
+void stop();
+
+} // namespace metrics
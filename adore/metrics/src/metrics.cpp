@@ -0,0 +1,199 @@
+#include "adore/metrics.h"
+
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <variant>
+
+namespace metrics {
+
+const std::vector<double> kFrameBounds = {
+    0.001, 0.004, 0.008, 0.0167, 0.020, 0.0333, 0.050, 0.100, 0.250, 1.0
+};
+
+const std::vector<double> kLatencyBounds = {
+    0.001, 0.005, 0.010, 0.025, 0.050, 0.100, 0.250, 0.500, 1.0, 5.0
+};
+
+Histogram::Histogram(const std::vector<double>& bounds)
+    : bounds(bounds)
+    , buckets(new std::atomic<uint64_t>[bounds.size() + 1])
+{
+    for (size_t i = 0; i <= bounds.size(); ++i) {
+        buckets[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void Histogram::observe(double seconds) {
+    size_t i = 0;
+    while (i < bounds.size() && seconds > bounds[i]) {
+        ++i;
+    }
+
+    buckets[i].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    sumMicros.fetch_add(static_cast<uint64_t>(seconds > 0 ? seconds * 1e6 : 0), std::memory_order_relaxed);
+}
+
+enum class MetricType {
+    COUNTER,
+    GAUGE,
+    HISTOGRAM,
+};
+
+static const char* kMetricTypeNames[] = {
+    "counter",
+    "gauge",
+    "histogram",
+};
+
+struct Series {
+    std::string labels;
+    std::variant<std::unique_ptr<Counter>, std::unique_ptr<Gauge>, std::unique_ptr<Histogram>> metric;
+};
+
+struct Family {
+    std::string help;
+    MetricType type;
+    std::vector<Series> series;
+};
+
+struct Registry {
+    std::mutex mutex;
+    // ordered so the exposition page is stable between scrapes
+    std::map<std::string, Family> families;
+};
+
+static Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+static Series& find_or_add(const char* name, const char* help, MetricType type, const std::string& labels) {
+    Registry& reg = registry();
+
+    auto [it, inserted] = reg.families.try_emplace(name);
+    Family& family = it->second;
+    if (inserted) {
+        family.help = help;
+        family.type = type;
+    }
+
+    for (Series& series : family.series) {
+        if (series.labels == labels) {
+            return series;
+        }
+    }
+
+    Series& series = family.series.emplace_back();
+    series.labels = labels;
+    return series;
+}
+
+std::string label(const char* key, const std::string& value) {
+    std::string result = key;
+    result += "=\"";
+    for (char c : value) {
+        switch (c) {
+            case '\\': result += "\\\\"; break;
+            case '"': result += "\\\""; break;
+            case '\n': result += "\\n"; break;
+            default: result += c; break;
+        }
+    }
+    result += '"';
+    return result;
+}
+
+Counter& counter(const char* name, const char* help, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    Series& series = find_or_add(name, help, MetricType::COUNTER, labels);
+    if (!std::holds_alternative<std::unique_ptr<Counter>>(series.metric) || !std::get<std::unique_ptr<Counter>>(series.metric)) {
+        series.metric = std::make_unique<Counter>();
+    }
+    return *std::get<std::unique_ptr<Counter>>(series.metric);
+}
+
+Gauge& gauge(const char* name, const char* help, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    Series& series = find_or_add(name, help, MetricType::GAUGE, labels);
+    if (!std::holds_alternative<std::unique_ptr<Gauge>>(series.metric) || !std::get<std::unique_ptr<Gauge>>(series.metric)) {
+        series.metric = std::make_unique<Gauge>();
+    }
+    return *std::get<std::unique_ptr<Gauge>>(series.metric);
+}
+
+Histogram& histogram(const char* name, const char* help, const std::vector<double>& bounds, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    Series& series = find_or_add(name, help, MetricType::HISTOGRAM, labels);
+    if (!std::holds_alternative<std::unique_ptr<Histogram>>(series.metric) || !std::get<std::unique_ptr<Histogram>>(series.metric)) {
+        series.metric = std::make_unique<Histogram>(bounds);
+    }
+    return *std::get<std::unique_ptr<Histogram>>(series.metric);
+}
+
+static void append_sample(std::string& out, const std::string& name, const char* suffix, const std::string& labels, const std::string& extra, const char* value) {
+    out += name;
+    out += suffix;
+    if (!labels.empty() || !extra.empty()) {
+        out += '{';
+        out += labels;
+        if (!labels.empty() && !extra.empty()) {
+            out += ',';
+        }
+        out += extra;
+        out += '}';
+    }
+    out += ' ';
+    out += value;
+    out += '\n';
+}
+
+std::string render() {
+    std::string out;
+    out.reserve(4096);
+
+    char value[64];
+
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    for (const auto& [name, family] : registry().families) {
+        out += "# HELP " + name + " " + family.help + "\n";
+        out += "# TYPE " + name + " " + kMetricTypeNames[static_cast<int>(family.type)] + "\n";
+
+        for (const Series& series : family.series) {
+            if (auto* c = std::get_if<std::unique_ptr<Counter>>(&series.metric)) {
+                snprintf(value, sizeof(value), "%llu", static_cast<unsigned long long>((*c)->value.load(std::memory_order_relaxed)));
+                append_sample(out, name, "", series.labels, "", value);
+            } else if (auto* g = std::get_if<std::unique_ptr<Gauge>>(&series.metric)) {
+                snprintf(value, sizeof(value), "%lld", static_cast<long long>((*g)->value.load(std::memory_order_relaxed)));
+                append_sample(out, name, "", series.labels, "", value);
+            } else if (auto* h = std::get_if<std::unique_ptr<Histogram>>(&series.metric)) {
+                const Histogram& histogram = **h;
+
+                uint64_t cumulative = 0;
+                for (size_t i = 0; i <= histogram.bounds.size(); ++i) {
+                    cumulative += histogram.buckets[i].load(std::memory_order_relaxed);
+
+                    char le[48];
+                    if (i < histogram.bounds.size()) {
+                        snprintf(le, sizeof(le), "le=\"%g\"", histogram.bounds[i]);
+                    } else {
+                        snprintf(le, sizeof(le), "le=\"+Inf\"");
+                    }
+
+                    snprintf(value, sizeof(value), "%llu", static_cast<unsigned long long>(cumulative));
+                    append_sample(out, name, "_bucket", series.labels, le, value);
+                }
+
+                snprintf(value, sizeof(value), "%.6f", histogram.sumMicros.load(std::memory_order_relaxed) / 1e6);
+                append_sample(out, name, "_sum", series.labels, "", value);
+                snprintf(value, sizeof(value), "%llu", static_cast<unsigned long long>(histogram.count.load(std::memory_order_relaxed)));
+                append_sample(out, name, "_count", series.labels, "", value);
+            }
+        }
+    }
+
+    return out;
+}
+
+} // namespace metrics
@@ -0,0 +1,153 @@
+#include "adore/metrics.h"
+
+#include <cstring>
+#include <string>
+
+#include <uv.h>
+
+namespace metrics {
+
+// Requests larger than this are not scrapes, drop them
+constexpr size_t kMaxRequestSize = 8192;
+
+struct Connection {
+    uv_tcp_t tcp;
+    std::string request;
+    std::string response;
+    uv_write_t write_req;
+};
+
+static uv_tcp_t* server = nullptr;
+
+static void close_connection(Connection* connection) {
+    uv_read_stop((uv_stream_t*)&connection->tcp);
+    uv_close((uv_handle_t*)&connection->tcp, [](uv_handle_t* handle) {
+        delete static_cast<Connection*>(handle->data);
+    });
+}
+
+static std::string build_response(const std::string& request) {
+    // "GET /metrics HTTP/1.1"
+    size_t pathStart = request.find(' ');
+    size_t pathEnd = pathStart == std::string::npos ? std::string::npos : request.find(' ', pathStart + 1);
+    std::string method = request.substr(0, pathStart);
+    std::string path = pathEnd == std::string::npos ? "" : request.substr(pathStart + 1, pathEnd - pathStart - 1);
+
+    std::string status = "200 OK";
+    std::string body;
+    if (method != "GET") {
+        status = "405 Method Not Allowed";
+    } else if (path == "/metrics" || path == "/") {
+        body = render();
+    } else {
+        status = "404 Not Found";
+    }
+
+    std::string response = "HTTP/1.1 " + status + "\r\n";
+    response += "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n";
+    response += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+    response += "Connection: close\r\n\r\n";
+    response += body;
+    return response;
+}
+
+static void on_alloc(uv_handle_t* handle, size_t suggested_size, uv_buf_t* buf) {
+    buf->base = new char[suggested_size];
+    buf->len = suggested_size;
+}
+
+static void on_read(uv_stream_t* stream, ssize_t nread, const uv_buf_t* buf) {
+    Connection* connection = static_cast<Connection*>(stream->data);
+
+    if (nread > 0) {
+        connection->request.append(buf->base, nread);
+    }
+    delete[] buf->base;
+
+    if (nread < 0 || connection->request.size() > kMaxRequestSize) {
+        close_connection(connection);
+        return;
+    }
+
+    if (connection->request.find("\r\n\r\n") == std::string::npos) {
+        // headers not complete yet
+        return;
+    }
+
+    uv_read_stop(stream);
+    connection->response = build_response(connection->request);
+
+    uv_buf_t out;
+    out.base = connection->response.data();
+    out.len = connection->response.size();
+    connection->write_req.data = connection;
+
+    uv_write(&connection->write_req, stream, &out, 1, [](uv_write_t* req, int status) {
+        close_connection(static_cast<Connection*>(req->data));
+    });
+}
+
+static void on_connection(uv_stream_t* listener, int status) {
+    if (status < 0) {
+        return;
+    }
+
+    Connection* connection = new Connection();
+    uv_tcp_init(listener->loop, &connection->tcp);
+    connection->tcp.data = connection;
+
+    if (uv_accept(listener, (uv_stream_t*)&connection->tcp) != 0) {
+        uv_close((uv_handle_t*)&connection->tcp, [](uv_handle_t* handle) {
+            delete static_cast<Connection*>(handle->data);
+        });
+        return;
+    }
+
+    uv_read_start((uv_stream_t*)&connection->tcp, on_alloc, on_read);
+}
+
+bool serve(const char* host, int port, std::string& error) {
+    if (server) {
+        error = "Metrics server already running";
+        return false;
+    }
+
+    sockaddr_in addr;
+    int r = uv_ip4_addr(host, port, &addr);
+    if (r < 0) {
+        error = std::string("Invalid metrics address: ") + uv_strerror(r);
+        return false;
+    }
+
+    server = new uv_tcp_t();
+    uv_tcp_init(uv_default_loop(), server);
+
+    r = uv_tcp_bind(server, (const struct sockaddr*)&addr, 0);
+    if (r == 0) {
+        r = uv_listen((uv_stream_t*)server, 16, on_connection);
+    }
+
+    if (r < 0) {
+        error = std::string("Failed to listen for metrics: ") + uv_strerror(r);
+        stop();
+        return false;
+    }
+
+    // A scrape endpoint on its own should not keep the runtime alive
+    uv_unref((uv_handle_t*)server);
+
+    return true;
+}
+
+void stop() {
+    if (!server) {
+        return;
+    }
+
+    uv_close((uv_handle_t*)server, [](uv_handle_t* handle) {
+        delete reinterpret_cast<uv_tcp_t*>(handle);
+    });
+    server = nullptr;
+}
+
+} // namespace metrics
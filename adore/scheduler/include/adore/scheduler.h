@@ -0,0 +1,88 @@
+#pragma once
+
+#include "lua.h"
+#include "lualib.h"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+
+// open the library as a table on top of the stack
+int adoreopen_scheduler(lua_State* L);
+
+// Priority classes for Luau threads. Threads spawned or yielded through this module
+// are queued here, and so are threads parked on one of Adore's asynchronous calls
+// through park(). Threads parked on a lute ResumeToken (task.wait and the rest of
+// lute's own library) are resumed by the runtime's queue, regardless of their class.
+namespace scheduler
+{
+
+enum class Priority {
+    CRITICAL,
+    FRAME,
+    BACKGROUND,
+};
+
+using Clock = std::chrono::steady_clock;
+using ErrorHandler = std::function<void(lua_State*)>;
+
+// Resume queued threads of the given class until the queue is empty or `deadline` passes.
+// Threads that yield back into the same class during the call wait for the next call.
+void run(Priority priority, Clock::time_point deadline, const ErrorHandler& onError);
+void run(Priority priority, const ErrorHandler& onError);
+
+bool has_work();
+
+// A thread parked on an asynchronous call. Completing it queues the thread in the
+// priority class it has when the call completes, with the values `results` pushes
+// onto its stack; failing it resumes the thread with `message` as an error. Main
+// thread only, like the rest of the scheduler.
+struct Continuation {
+    Continuation(lua_State* thread, int ref);
+    ~Continuation();
+
+    void complete(std::function<int(lua_State*)> results);
+    void fail(const std::string& message);
+
+private:
+    void wake(std::function<int(lua_State*)> results, bool failed);
+
+    lua_State* thread;
+    int ref;
+    bool done = false;
+};
+
+using Token = std::shared_ptr<Continuation>;
+
+// Take a reference to the running thread, which then yields with lua_yield(L, 0)
+// until the returned token completes
+Token park(lua_State* L);
+
+// Threads parked on a token that has not completed yet
+bool has_parked();
+
+// Whether a parked thread was woken since the last call
+bool take_woken();
+
+// Minimum time background work gets per frame, even when the frame has no time left
+Clock::duration background_slice();
+
+int spawn(lua_State* L);
+int yield(lua_State* L);
+int setpriority(lua_State* L);
+int getpriority(lua_State* L);
+int setbackgroundslice(lua_State* L);
+int stats(lua_State* L);
+
+static const luaL_Reg lib[] = {
+    {"spawn", spawn},
+    {"yield", yield},
+    {"setpriority", setpriority},
+    {"getpriority", getpriority},
+    {"setbackgroundslice", setbackgroundslice},
+    {"stats", stats},
+    {nullptr, nullptr},
+};
+
+} // namespace scheduler
@@ -0,0 +1,366 @@
+#include "adore/scheduler.h"
+
+#include "adore/metrics.h"
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string>
+
+namespace scheduler {
+
+static const char* kPriorityRegistryKey = "adore.scheduler.priority";
+
+static const std::pair<const char*, Priority> kPriorityMap[] = {
+    {"critical", Priority::CRITICAL},
+    {"frame", Priority::FRAME},
+    {"background", Priority::BACKGROUND},
+};
+
+struct Entry {
+    lua_State* thread;
+    int ref;
+    int nargs;
+    Clock::time_point enqueued;
+
+    // set for a parked thread whose call completed, pushes the call's results
+    std::function<int(lua_State*)> results;
+    bool failed = false;
+};
+
+struct PriorityClass {
+    std::deque<Entry> queue;
+
+    uint64_t resumed = 0;
+    double totalLatency = 0.0;
+    double maxLatency = 0.0;
+
+    metrics::Histogram& latency;
+    metrics::Gauge& queued;
+};
+
+static PriorityClass make_class(const char* name) {
+    std::string labels = metrics::label("class", name);
+    return PriorityClass{
+        {}, 0, 0.0, 0.0,
+        metrics::histogram("adore_scheduler_queue_seconds", "Time threads spend queued before they are resumed", metrics::kFrameBounds, labels),
+        metrics::gauge("adore_scheduler_queued", "Threads waiting in a scheduler priority class", labels),
+    };
+}
+
+static PriorityClass& get_class(Priority priority) {
+    static PriorityClass classes[] = {
+        make_class("critical"),
+        make_class("frame"),
+        make_class("background"),
+    };
+    return classes[static_cast<int>(priority)];
+}
+
+// thread currently resumed by run(), and where it asked to go when it yields
+static lua_State* current = nullptr;
+static std::optional<Priority> requeue;
+
+static Clock::duration backgroundSlice = std::chrono::milliseconds(2);
+
+static size_t parked = 0;
+static bool woken = false;
+
+static Priority check_priority(lua_State* L, int index) {
+    const char* name = luaL_checkstring(L, index);
+    for (const auto& [key, priority] : kPriorityMap) {
+        if (strcmp(key, name) == 0) {
+            return priority;
+        }
+    }
+
+    luaL_error(L, "Invalid priority class: %s", name);
+    return Priority::FRAME;
+}
+
+static void set_thread_priority(lua_State* L, int threadIndex, Priority priority) {
+    threadIndex = lua_absindex(L, threadIndex);
+    lua_getfield(L, LUA_REGISTRYINDEX, kPriorityRegistryKey);
+    lua_pushvalue(L, threadIndex);
+    lua_pushinteger(L, static_cast<int>(priority));
+    lua_rawset(L, -3);
+    lua_pop(L, 1);
+}
+
+static Priority get_thread_priority(lua_State* L, int threadIndex) {
+    threadIndex = lua_absindex(L, threadIndex);
+    lua_getfield(L, LUA_REGISTRYINDEX, kPriorityRegistryKey);
+    lua_pushvalue(L, threadIndex);
+    lua_rawget(L, -2);
+    Priority priority = lua_isnumber(L, -1) ? static_cast<Priority>(lua_tointeger(L, -1)) : Priority::FRAME;
+    lua_pop(L, 2);
+    return priority;
+}
+
+static void enqueue(Priority priority, const Entry& entry) {
+    PriorityClass& cls = get_class(priority);
+    cls.queue.push_back(entry);
+    cls.queued.add();
+}
+
+void run(Priority priority, Clock::time_point deadline, const ErrorHandler& onError) {
+    PriorityClass& cls = get_class(priority);
+
+    // only run what was queued before we started, threads yielding back go next time
+    size_t count = cls.queue.size();
+    while (count-- > 0 && !cls.queue.empty()) {
+        Clock::time_point now = Clock::now();
+        if (now >= deadline) {
+            break;
+        }
+
+        Entry entry = cls.queue.front();
+        cls.queue.pop_front();
+        cls.queued.sub();
+
+        double latency = std::chrono::duration<double>(now - entry.enqueued).count();
+        cls.latency.observe(latency);
+        cls.resumed++;
+        cls.totalLatency += latency;
+        cls.maxLatency = latency > cls.maxLatency ? latency : cls.maxLatency;
+
+        current = entry.thread;
+        requeue.reset();
+
+        int status;
+        if (entry.results) {
+            int nresults = entry.results(entry.thread);
+            status = entry.failed ? lua_resumeerror(entry.thread, nullptr) : lua_resume(entry.thread, nullptr, nresults);
+        } else {
+            status = lua_resume(entry.thread, nullptr, entry.nargs);
+        }
+
+        current = nullptr;
+
+        if (status == LUA_YIELD && requeue) {
+            // yielded through scheduler.yield, keep our reference
+            enqueue(*requeue, Entry{entry.thread, entry.ref, 0, Clock::now()});
+            continue;
+        }
+
+        if (status != LUA_OK && status != LUA_YIELD) {
+            onError(entry.thread);
+        }
+
+        // finished, or parked on a token that holds its own reference
+        lua_unref(entry.thread, entry.ref);
+    }
+}
+
+void run(Priority priority, const ErrorHandler& onError) {
+    run(priority, Clock::time_point::max(), onError);
+}
+
+bool has_work() {
+    for (const auto& [name, priority] : kPriorityMap) {
+        if (!get_class(priority).queue.empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+Continuation::Continuation(lua_State* thread, int ref)
+    : thread(thread), ref(ref) {
+    parked++;
+}
+
+Continuation::~Continuation() {
+    // dropped without completing, e.g. by a device closed mid call. The state may
+    // already be gone, so the thread's reference is left alone.
+    if (!done) {
+        parked--;
+    }
+}
+
+void Continuation::complete(std::function<int(lua_State*)> results) {
+    wake(std::move(results), false);
+}
+
+void Continuation::fail(const std::string& message) {
+    wake([message](lua_State* L) {
+        lua_pushlstring(L, message.data(), message.size());
+        return 1;
+    }, true);
+}
+
+void Continuation::wake(std::function<int(lua_State*)> results, bool failed) {
+    if (done) {
+        return;
+    }
+    done = true;
+    parked--;
+    woken = true;
+
+    lua_pushthread(thread);
+    Priority priority = get_thread_priority(thread, -1);
+    lua_pop(thread, 1);
+
+    Entry entry{thread, ref, 0, Clock::now()};
+    entry.results = std::move(results);
+    entry.failed = failed;
+    enqueue(priority, entry);
+}
+
+Token park(lua_State* L) {
+    lua_pushthread(L);
+    int ref = lua_ref(L, -1);
+    lua_pop(L, 1);
+    return std::make_shared<Continuation>(L, ref);
+}
+
+bool has_parked() {
+    return parked > 0;
+}
+
+bool take_woken() {
+    bool result = woken;
+    woken = false;
+    return result;
+}
+
+Clock::duration background_slice() {
+    return backgroundSlice;
+}
+
+int spawn(lua_State* L) {
+    Priority priority = check_priority(L, 1);
+    luaL_checktype(L, 2, LUA_TFUNCTION);
+    int nargs = lua_gettop(L) - 2;
+
+    lua_State* thread = lua_newthread(L);
+    lua_checkstack(thread, nargs + 1);
+
+    lua_pushvalue(L, 2);
+    lua_xmove(L, thread, 1);
+    for (int i = 0; i < nargs; ++i) {
+        lua_pushvalue(L, 3 + i);
+        lua_xmove(L, thread, 1);
+    }
+
+    set_thread_priority(L, -1, priority);
+
+    lua_pushvalue(L, -1);
+    int ref = lua_ref(L, -1);
+    lua_pop(L, 1);
+
+    enqueue(priority, Entry{thread, ref, nargs, Clock::now()});
+
+    return 1;
+}
+
+int yield(lua_State* L) {
+    Priority priority;
+    if (lua_isnoneornil(L, 1)) {
+        lua_pushthread(L);
+        priority = get_thread_priority(L, -1);
+        lua_pop(L, 1);
+    } else {
+        priority = check_priority(L, 1);
+    }
+
+    if (L == current) {
+        requeue = priority;
+    } else {
+        // not resumed by us (e.g. the main chunk), take a reference so it stays alive in the queue
+        lua_pushthread(L);
+        int ref = lua_ref(L, -1);
+        lua_pop(L, 1);
+        enqueue(priority, Entry{L, ref, 0, Clock::now()});
+    }
+
+    return lua_yield(L, 0);
+}
+
+int setpriority(lua_State* L) {
+    luaL_checktype(L, 1, LUA_TTHREAD);
+    Priority priority = check_priority(L, 2);
+    set_thread_priority(L, 1, priority);
+    return 0;
+}
+
+int getpriority(lua_State* L) {
+    if (lua_isnoneornil(L, 1)) {
+        lua_pushthread(L);
+    } else {
+        luaL_checktype(L, 1, LUA_TTHREAD);
+        lua_pushvalue(L, 1);
+    }
+
+    Priority priority = get_thread_priority(L, -1);
+    for (const auto& [name, value] : kPriorityMap) {
+        if (value == priority) {
+            lua_pushstring(L, name);
+            return 1;
+        }
+    }
+
+    lua_pushnil(L);
+    return 1;
+}
+
+int setbackgroundslice(lua_State* L) {
+    double seconds = luaL_checknumber(L, 1);
+    if (seconds < 0.0) {
+        luaL_error(L, "Background slice must not be negative");
+    }
+
+    backgroundSlice = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    return 0;
+}
+
+int stats(lua_State* L) {
+    lua_createtable(L, 0, std::size(kPriorityMap));
+
+    for (const auto& [name, priority] : kPriorityMap) {
+        const PriorityClass& cls = get_class(priority);
+
+        lua_createtable(L, 0, 4);
+        lua_pushinteger(L, static_cast<int>(cls.queue.size()));
+        lua_setfield(L, -2, "queued");
+        lua_pushnumber(L, static_cast<double>(cls.resumed));
+        lua_setfield(L, -2, "resumed");
+        lua_pushnumber(L, cls.resumed > 0 ? cls.totalLatency / cls.resumed : 0.0);
+        lua_setfield(L, -2, "meanlatency");
+        lua_pushnumber(L, cls.maxLatency);
+        lua_setfield(L, -2, "maxlatency");
+
+        lua_setfield(L, -2, name);
+    }
+
+    return 1;
+}
+
+} // namespace scheduler
+
+
+int adoreopen_scheduler(lua_State* L)
+{
+    // thread -> priority class, weak so finished threads can be collected
+    lua_newtable(L);
+    lua_createtable(L, 0, 1);
+    lua_pushstring(L, "k");
+    lua_setfield(L, -2, "__mode");
+    lua_setmetatable(L, -2);
+    lua_setfield(L, LUA_REGISTRYINDEX, scheduler::kPriorityRegistryKey);
+
+    lua_createtable(L, 0, std::size(scheduler::lib));
+
+    for (auto& [name, func] : scheduler::lib)
+    {
+        if (!name || !func)
+            break;
+
+        lua_pushcfunction(L, func, name);
+        lua_setfield(L, -2, name);
+    }
+
+    lua_setreadonly(L, -1, true);
+
+    return 1;
+}
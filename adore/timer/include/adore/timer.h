@@ -0,0 +1,48 @@
+#pragma once
+
+#include "lua.h"
+#include "lualib.h"
+
+#include <cstdint>
+#include <functional>
+
+// open the library as a table on top of the stack
+int adoreopen_timer(lua_State* L);
+
+namespace timer
+{
+
+using ErrorHandler = std::function<void(lua_State*)>;
+
+// Fire every timer that is due. The libuv loop drives this too, the frame loop
+// calls it for sub-millisecond accuracy while it is spinning anyway.
+void poll();
+bool has_pending();
+// Where failed callbacks go, called with the thread holding the error.
+// Without one they are printed to stderr.
+void set_error_handler(ErrorHandler handler);
+// Microseconds until the next timer is due, false when none is pending
+bool next_due(uint64_t& micros);
+
+int now(lua_State* L);
+int after(lua_State* L);
+int every(lua_State* L);
+int batch(lua_State* L);
+int cancel(lua_State* L);
+int cancelbatch(lua_State* L);
+int pending(lua_State* L);
+int stats(lua_State* L);
+
+static const luaL_Reg lib[] = {
+    {"now", now},
+    {"after", after},
+    {"every", every},
+    {"batch", batch},
+    {"cancel", cancel},
+    {"cancelbatch", cancelbatch},
+    {"pending", pending},
+    {"stats", stats},
+    {nullptr, nullptr},
+};
+
+} // namespace timer
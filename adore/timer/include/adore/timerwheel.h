@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace timer
+{
+
+// Hierarchical timer wheel over 64 bit tick timestamps (microseconds in practice).
+//
+// Every level has 64 slots and an occupancy bitmap. A timer lives on the level of
+// the highest 6 bit group in which its deadline differs from the wheel's current
+// time, so insert and cancel are O(1) and advancing only visits occupied slots.
+// Timers on higher levels are cascaded down when the wheel reaches their slot.
+class TimerWheel
+{
+public:
+    // index in the low 32 bits, a 20 bit generation above it (fits a Luau number exactly)
+    using Handle = uint64_t;
+
+    static constexpr Handle kInvalidHandle = 0;
+
+    struct Expired {
+        Handle handle;
+        uint64_t deadline;
+        uint64_t data;
+        bool periodic;
+    };
+
+    explicit TimerWheel(uint64_t now = 0);
+
+    // Deadlines in the past fire on the next advance. A non zero period makes the timer periodic.
+    Handle insert(uint64_t deadline, uint64_t period, uint64_t data);
+    // Returns false if the timer already fired or was cancelled, otherwise writes its data to `data`
+    bool cancel(Handle handle, uint64_t* data = nullptr);
+    bool contains(Handle handle) const;
+
+    // Move time forward to `target`, appending every timer that expired to `expired` in deadline order.
+    // Periodic timers are rescheduled before they are reported.
+    void advance(uint64_t target, std::vector<Expired>& expired);
+
+    // Earliest time at which advance() has work to do
+    bool next_event(uint64_t& time) const;
+
+    uint64_t now() const { return current; }
+    size_t size() const { return count; }
+
+private:
+    static constexpr int kBits = 6;
+    static constexpr int kSlots = 1 << kBits;
+    static constexpr uint64_t kMask = kSlots - 1;
+    static constexpr int kLevels = (64 + kBits - 1) / kBits;
+    static constexpr uint32_t kNil = 0xFFFFFFFFu;
+    static constexpr uint32_t kGenerationMask = 0xFFFFFu;
+
+    struct Node {
+        uint64_t deadline = 0;
+        uint64_t period = 0;
+        uint64_t data = 0;
+        uint32_t prev = kNil;
+        uint32_t next = kNil;
+        uint32_t generation = 1;
+        uint8_t level = 0;
+        uint8_t slot = 0;
+        bool active = false;
+    };
+
+    Node* resolve(Handle handle);
+    const Node* resolve(Handle handle) const;
+    Handle handle_of(uint32_t index) const;
+
+    void link(uint32_t index);
+    void unlink(uint32_t index);
+    void release(uint32_t index);
+
+    uint64_t current;
+    size_t count = 0;
+
+    std::vector<Node> nodes;
+    uint32_t freeList = kNil;
+
+    uint32_t heads[kLevels][kSlots];
+    uint64_t occupied[kLevels] = {};
+};
+
+} // namespace timer
@@ -0,0 +1,438 @@
+#include "adore/timer.h"
+
+#include "adore/timerwheel.h"
+#include "adore/metrics.h"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+#include <uv.h>
+
+namespace timer {
+
+// Timers firing later than this count as late in stats()
+constexpr uint64_t kLateThresholdMicros = 1000;
+
+// Batch timers carry their group id and index instead of a callback reference
+constexpr uint64_t kBatchFlag = 1ull << 63;
+
+static const std::vector<double> kLateBounds = {
+    0.0001, 0.0005, 0.001, 0.002, 0.005, 0.010, 0.0167, 0.050, 0.100
+};
+
+static uint64_t now_micros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+}
+
+struct Group {
+    int ref;
+    uint32_t remaining;
+    std::vector<TimerWheel::Handle> handles;
+};
+
+struct TimerState {
+    lua_State* GL = nullptr;
+    TimerWheel wheel{now_micros()};
+    ErrorHandler onError;
+
+    uv_timer_t* uvTimer = nullptr;
+    uint64_t armedFor = UINT64_MAX;
+
+    std::unordered_map<uint32_t, Group> groups;
+    uint32_t nextGroup = 1;
+
+    std::vector<TimerWheel::Expired> expired;
+    bool firing = false;
+
+    // the entries poll() is firing and the next one due, callbacks may cancel those
+    // that have not had their turn yet
+    std::vector<TimerWheel::Expired>* batch = nullptr;
+    size_t batchNext = 0;
+
+    uint64_t fired = 0;
+    uint64_t late = 0;
+    uint64_t totalLateMicros = 0;
+    uint64_t maxLateMicros = 0;
+
+    metrics::Histogram& lateness = metrics::histogram("adore_timer_late_seconds", "How late timers fire after their deadline", kLateBounds);
+    metrics::Gauge& pendingGauge = metrics::gauge("adore_timer_pending", "Timers waiting to fire");
+};
+
+static TimerState& state() {
+    static TimerState instance;
+    return instance;
+}
+
+static void on_uv_timer(uv_timer_t* handle) {
+    state().armedFor = UINT64_MAX;
+    poll();
+}
+
+// Make sure libuv wakes us up for the next wheel event
+static void arm() {
+    TimerState& s = state();
+    s.pendingGauge.set(static_cast<int64_t>(s.wheel.size()));
+
+    if (!s.uvTimer) {
+        return;
+    }
+
+    uint64_t next;
+    if (!s.wheel.next_event(next)) {
+        uv_timer_stop(s.uvTimer);
+        s.armedFor = UINT64_MAX;
+        return;
+    }
+
+    if (next == s.armedFor) {
+        return;
+    }
+
+    uint64_t now = now_micros();
+    uint64_t delayMs = next > now ? (next - now + 999) / 1000 : 0;
+    uv_update_time(uv_default_loop());
+    uv_timer_start(s.uvTimer, on_uv_timer, delayMs, 0);
+    s.armedFor = next;
+}
+
+static void release_group_timer(TimerState& s, uint32_t groupId) {
+    auto it = s.groups.find(groupId);
+    if (it == s.groups.end()) {
+        return;
+    }
+
+    if (--it->second.remaining == 0) {
+        lua_unref(s.GL, it->second.ref);
+        s.groups.erase(it);
+    }
+}
+
+static void fire(TimerState& s, const TimerWheel::Expired& entry, uint64_t now) {
+    uint64_t lateMicros = now > entry.deadline ? now - entry.deadline : 0;
+    s.fired++;
+    s.totalLateMicros += lateMicros;
+    s.maxLateMicros = lateMicros > s.maxLateMicros ? lateMicros : s.maxLateMicros;
+    if (lateMicros > kLateThresholdMicros) {
+        s.late++;
+    }
+    s.lateness.observe(lateMicros / 1e6);
+
+    int ref;
+    double argument;
+    uint32_t groupId = 0;
+    if (entry.data & kBatchFlag) {
+        groupId = static_cast<uint32_t>((entry.data >> 32) & 0x7FFFFFFFu);
+        auto it = s.groups.find(groupId);
+        if (it == s.groups.end()) {
+            return;
+        }
+        ref = it->second.ref;
+        argument = static_cast<double>((entry.data & 0xFFFFFFFFu) + 1);
+    } else {
+        ref = static_cast<int>(entry.data);
+        argument = static_cast<double>(entry.handle);
+    }
+
+    // run the callback in its own thread so it may yield
+    lua_State* L = lua_newthread(s.GL);
+    lua_getref(L, ref);
+    lua_pushnumber(L, argument);
+    lua_pushnumber(L, lateMicros / 1e6);
+
+    int status = lua_resume(L, nullptr, 2);
+    if (status != LUA_OK && status != LUA_YIELD) {
+        if (s.onError) {
+            s.onError(L);
+        } else {
+            const char* message = lua_tostring(L, -1);
+            std::cerr << "Timer callback failed: " << (message ? message : "unknown error") << "\n" << lua_debugtrace(L) << std::endl;
+        }
+    }
+
+    lua_pop(s.GL, 1);
+
+    if (!entry.periodic) {
+        if (groupId != 0) {
+            release_group_timer(s, groupId);
+        } else {
+            lua_unref(s.GL, ref);
+        }
+    }
+}
+
+void poll() {
+    TimerState& s = state();
+    if (s.firing || !s.GL) {
+        return;
+    }
+
+    s.firing = true;
+
+    uint64_t now = now_micros();
+    s.expired.clear();
+    s.wheel.advance(now, s.expired);
+
+    // callbacks may schedule more timers, which land in the wheel rather than this list
+    std::vector<TimerWheel::Expired> expired;
+    expired.swap(s.expired);
+    s.batch = &expired;
+    for (s.batchNext = 0; s.batchNext < expired.size();) {
+        TimerWheel::Expired entry = expired[s.batchNext++];
+        // cancelled by an earlier callback of this batch
+        if (entry.handle != TimerWheel::kInvalidHandle) {
+            fire(s, entry, now);
+        }
+    }
+    s.batch = nullptr;
+    expired.clear();
+    s.expired.swap(expired);
+
+    s.firing = false;
+
+    arm();
+}
+
+bool has_pending() {
+    return state().wheel.size() > 0;
+}
+
+void set_error_handler(ErrorHandler handler) {
+    state().onError = std::move(handler);
+}
+
+bool next_due(uint64_t& micros) {
+    uint64_t next;
+    if (!state().wheel.next_event(next)) {
+        return false;
+    }
+
+    uint64_t now = now_micros();
+    micros = next > now ? next - now : 0;
+    return true;
+}
+
+static uint64_t check_delay(lua_State* L, int index) {
+    double seconds = luaL_checknumber(L, index);
+    if (seconds < 0.0) {
+        seconds = 0.0;
+    }
+    return static_cast<uint64_t>(seconds * 1e6);
+}
+
+int now(lua_State* L) {
+    lua_pushnumber(L, static_cast<double>(now_micros()));
+    return 1;
+}
+
+int after(lua_State* L) {
+    uint64_t delay = check_delay(L, 1);
+    luaL_checktype(L, 2, LUA_TFUNCTION);
+
+    int ref = lua_ref(L, 2);
+    TimerWheel::Handle handle = state().wheel.insert(now_micros() + delay, 0, static_cast<uint64_t>(ref));
+    arm();
+
+    lua_pushnumber(L, static_cast<double>(handle));
+    return 1;
+}
+
+int every(lua_State* L) {
+    uint64_t period = check_delay(L, 1);
+    luaL_checktype(L, 2, LUA_TFUNCTION);
+    uint64_t initial = lua_isnoneornil(L, 3) ? period : check_delay(L, 3);
+
+    if (period == 0) {
+        luaL_error(L, "Timer period must be positive");
+    }
+
+    int ref = lua_ref(L, 2);
+    TimerWheel::Handle handle = state().wheel.insert(now_micros() + initial, period, static_cast<uint64_t>(ref));
+    arm();
+
+    lua_pushnumber(L, static_cast<double>(handle));
+    return 1;
+}
+
+int batch(lua_State* L) {
+    size_t length;
+    const char* data = static_cast<const char*>(luaL_checkbuffer(L, 1, &length));
+    luaL_checktype(L, 2, LUA_TFUNCTION);
+    size_t offset = static_cast<size_t>(luaL_optinteger(L, 4, 0));
+    if (offset > length) {
+        luaL_error(L, "Offset %d is outside the buffer", static_cast<int>(offset));
+    }
+    size_t available = (length - offset) / sizeof(double);
+    int requested = luaL_optinteger(L, 3, static_cast<int>(available));
+    if (requested < 0) {
+        luaL_error(L, "Count must not be negative");
+    }
+
+    size_t count = static_cast<size_t>(requested);
+    if (count > available) {
+        luaL_error(L, "Buffer holds less than %d deadlines", requested);
+    }
+
+    TimerState& s = state();
+    uint32_t groupId = s.nextGroup++ & 0x7FFFFFFFu;
+    if (groupId == 0) {
+        groupId = s.nextGroup++;
+    }
+
+    Group& group = s.groups[groupId];
+    group.ref = lua_ref(L, 2);
+    group.remaining = static_cast<uint32_t>(count);
+    group.handles.reserve(count);
+
+    uint64_t now = now_micros();
+    for (size_t i = 0; i < count; ++i) {
+        double seconds;
+        memcpy(&seconds, data + offset + i * sizeof(double), sizeof(double));
+        uint64_t delay = seconds > 0.0 ? static_cast<uint64_t>(seconds * 1e6) : 0;
+
+        uint64_t payload = kBatchFlag | (static_cast<uint64_t>(groupId) << 32) | static_cast<uint64_t>(i);
+        group.handles.push_back(s.wheel.insert(now + delay, 0, payload));
+    }
+
+    if (count == 0) {
+        lua_unref(L, group.ref);
+        s.groups.erase(groupId);
+    }
+
+    arm();
+
+    lua_pushnumber(L, static_cast<double>(groupId));
+    return 1;
+}
+
+// Take a timer out of the batch being fired before its turn comes. advance() has
+// already removed one-shot timers from the wheel, periodic ones are back in it too.
+static bool cancel_pending(TimerState& s, TimerWheel::Handle handle, uint64_t* data) {
+    // cancelled entries are marked with the invalid handle
+    if (!s.batch || handle == TimerWheel::kInvalidHandle) {
+        return false;
+    }
+
+    for (size_t i = s.batchNext; i < s.batch->size(); ++i) {
+        TimerWheel::Expired& entry = (*s.batch)[i];
+        if (entry.handle == handle) {
+            *data = entry.data;
+            entry.handle = TimerWheel::kInvalidHandle;
+            return true;
+        }
+    }
+    return false;
+}
+
+int cancel(lua_State* L) {
+    TimerWheel::Handle handle = static_cast<TimerWheel::Handle>(luaL_checknumber(L, 1));
+
+    TimerState& s = state();
+    uint64_t data;
+    uint64_t pendingData;
+    bool scheduled = s.wheel.cancel(handle, &data);
+    bool pending = cancel_pending(s, handle, &pendingData);
+    if (!scheduled && !pending) {
+        lua_pushboolean(L, false);
+        return 1;
+    }
+
+    // both for a periodic timer, whose reference is still only dropped once
+    if (!scheduled) {
+        data = pendingData;
+    }
+
+    if (data & kBatchFlag) {
+        release_group_timer(s, static_cast<uint32_t>((data >> 32) & 0x7FFFFFFFu));
+    } else {
+        lua_unref(L, static_cast<int>(data));
+    }
+
+    arm();
+
+    lua_pushboolean(L, true);
+    return 1;
+}
+
+int cancelbatch(lua_State* L) {
+    uint32_t groupId = static_cast<uint32_t>(luaL_checkinteger(L, 1));
+
+    TimerState& s = state();
+    auto it = s.groups.find(groupId);
+    if (it == s.groups.end()) {
+        lua_pushinteger(L, 0);
+        return 1;
+    }
+
+    int cancelled = 0;
+    for (TimerWheel::Handle handle : it->second.handles) {
+        if (s.wheel.cancel(handle)) {
+            cancelled++;
+        }
+    }
+
+    lua_unref(L, it->second.ref);
+    s.groups.erase(it);
+
+    arm();
+
+    lua_pushinteger(L, cancelled);
+    return 1;
+}
+
+int pending(lua_State* L) {
+    lua_pushinteger(L, static_cast<int>(state().wheel.size()));
+    return 1;
+}
+
+int stats(lua_State* L) {
+    TimerState& s = state();
+
+    lua_createtable(L, 0, 5);
+    lua_pushinteger(L, static_cast<int>(s.wheel.size()));
+    lua_setfield(L, -2, "pending");
+    lua_pushnumber(L, static_cast<double>(s.fired));
+    lua_setfield(L, -2, "fired");
+    lua_pushnumber(L, static_cast<double>(s.late));
+    lua_setfield(L, -2, "late");
+    lua_pushnumber(L, s.fired > 0 ? (s.totalLateMicros / 1e6) / s.fired : 0.0);
+    lua_setfield(L, -2, "meanlate");
+    lua_pushnumber(L, s.maxLateMicros / 1e6);
+    lua_setfield(L, -2, "maxlate");
+
+    return 1;
+}
+
+} // namespace timer
+
+
+int adoreopen_timer(lua_State* L)
+{
+    timer::TimerState& s = timer::state();
+    s.GL = lua_mainthread(L);
+    if (!s.uvTimer) {
+        s.uvTimer = new uv_timer_t();
+        uv_timer_init(uv_default_loop(), s.uvTimer);
+
+        // the frame loop checks has_pending() itself
+        uv_unref((uv_handle_t*)s.uvTimer);
+    }
+
+    lua_createtable(L, 0, std::size(timer::lib));
+
+    for (auto& [name, func] : timer::lib)
+    {
+        if (!name || !func)
+            break;
+
+        lua_pushcfunction(L, func, name);
+        lua_setfield(L, -2, name);
+    }
+
+    lua_setreadonly(L, -1, true);
+
+    return 1;
+}
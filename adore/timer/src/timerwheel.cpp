@@ -0,0 +1,246 @@
+#include "adore/timerwheel.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace timer {
+
+static inline int highest_bit(uint64_t value) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return static_cast<int>(index);
+#else
+    return 63 - __builtin_clzll(value);
+#endif
+}
+
+static inline int lowest_bit(uint64_t value) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(value);
+#endif
+}
+
+TimerWheel::TimerWheel(uint64_t now)
+    : current(now)
+{
+    for (auto& level : heads) {
+        for (auto& head : level) {
+            head = kNil;
+        }
+    }
+}
+
+TimerWheel::Handle TimerWheel::handle_of(uint32_t index) const {
+    return (static_cast<uint64_t>(nodes[index].generation) << 32) | index;
+}
+
+TimerWheel::Node* TimerWheel::resolve(Handle handle) {
+    uint32_t index = static_cast<uint32_t>(handle & 0xFFFFFFFFu);
+    uint32_t generation = static_cast<uint32_t>(handle >> 32);
+    if (index >= nodes.size() || !nodes[index].active || nodes[index].generation != generation) {
+        return nullptr;
+    }
+    return &nodes[index];
+}
+
+const TimerWheel::Node* TimerWheel::resolve(Handle handle) const {
+    return const_cast<TimerWheel*>(this)->resolve(handle);
+}
+
+void TimerWheel::link(uint32_t index) {
+    Node& node = nodes[index];
+
+    uint64_t deadline = node.deadline < current ? current : node.deadline;
+    uint64_t diff = deadline ^ current;
+    int level = diff == 0 ? 0 : highest_bit(diff) / kBits;
+    int slot = static_cast<int>((deadline >> (level * kBits)) & kMask);
+
+    node.level = static_cast<uint8_t>(level);
+    node.slot = static_cast<uint8_t>(slot);
+    node.prev = kNil;
+    node.next = heads[level][slot];
+    if (node.next != kNil) {
+        nodes[node.next].prev = index;
+    }
+    heads[level][slot] = index;
+    occupied[level] |= 1ull << slot;
+}
+
+void TimerWheel::unlink(uint32_t index) {
+    Node& node = nodes[index];
+
+    if (node.prev != kNil) {
+        nodes[node.prev].next = node.next;
+    } else {
+        heads[node.level][node.slot] = node.next;
+        if (node.next == kNil) {
+            occupied[node.level] &= ~(1ull << node.slot);
+        }
+    }
+
+    if (node.next != kNil) {
+        nodes[node.next].prev = node.prev;
+    }
+
+    node.prev = kNil;
+    node.next = kNil;
+}
+
+void TimerWheel::release(uint32_t index) {
+    Node& node = nodes[index];
+    node.active = false;
+    node.generation = (node.generation + 1) & kGenerationMask;
+    if (node.generation == 0) {
+        node.generation = 1;
+    }
+    node.next = freeList;
+    freeList = index;
+    count--;
+}
+
+TimerWheel::Handle TimerWheel::insert(uint64_t deadline, uint64_t period, uint64_t data) {
+    uint32_t index;
+    if (freeList != kNil) {
+        index = freeList;
+        freeList = nodes[index].next;
+    } else {
+        index = static_cast<uint32_t>(nodes.size());
+        nodes.emplace_back();
+    }
+
+    Node& node = nodes[index];
+    node.deadline = deadline;
+    node.period = period;
+    node.data = data;
+    node.active = true;
+    count++;
+
+    link(index);
+
+    return handle_of(index);
+}
+
+bool TimerWheel::cancel(Handle handle, uint64_t* data) {
+    Node* node = resolve(handle);
+    if (!node) {
+        return false;
+    }
+
+    uint32_t index = static_cast<uint32_t>(handle & 0xFFFFFFFFu);
+    if (data) {
+        *data = node->data;
+    }
+
+    unlink(index);
+    release(index);
+    return true;
+}
+
+bool TimerWheel::contains(Handle handle) const {
+    return resolve(handle) != nullptr;
+}
+
+bool TimerWheel::next_event(uint64_t& time) const {
+    bool found = false;
+
+    for (int level = 0; level < kLevels; ++level) {
+        uint64_t bits = occupied[level];
+        if (bits == 0) {
+            continue;
+        }
+
+        int shift = level * kBits;
+        int index = static_cast<int>((current >> shift) & kMask);
+
+        // level 0 may hold timers due right now, higher levels only hold slots ahead of us
+        if (level == 0) {
+            bits &= ~0ull << index;
+        } else {
+            bits &= index == kSlots - 1 ? 0 : ~0ull << (index + 1);
+        }
+
+        if (bits == 0) {
+            continue;
+        }
+
+        int slot = lowest_bit(bits);
+        int upper = shift + kBits;
+        uint64_t base = upper >= 64 ? 0 : (current >> upper) << upper;
+        uint64_t candidate = base | (static_cast<uint64_t>(slot) << shift);
+
+        if (!found || candidate < time) {
+            time = candidate;
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+void TimerWheel::advance(uint64_t target, std::vector<Expired>& expired) {
+    uint64_t time;
+    while (next_event(time) && time <= target) {
+        current = time;
+
+        // cascade from the top so timers landing on level 0 fire in this same step
+        for (int level = kLevels - 1; level > 0; --level) {
+            int slot = static_cast<int>((current >> (level * kBits)) & kMask);
+            if (!(occupied[level] & (1ull << slot))) {
+                continue;
+            }
+
+            uint32_t index = heads[level][slot];
+            heads[level][slot] = kNil;
+            occupied[level] &= ~(1ull << slot);
+
+            while (index != kNil) {
+                uint32_t next = nodes[index].next;
+                link(index);
+                index = next;
+            }
+        }
+
+        int slot = static_cast<int>(current & kMask);
+        if (!(occupied[0] & (1ull << slot))) {
+            continue;
+        }
+
+        uint32_t index = heads[0][slot];
+        heads[0][slot] = kNil;
+        occupied[0] &= ~(1ull << slot);
+
+        while (index != kNil) {
+            Node& node = nodes[index];
+            uint32_t next = node.next;
+
+            Expired entry{handle_of(index), node.deadline, node.data, node.period != 0};
+
+            if (node.period != 0) {
+                // skip periods we slept through instead of firing them back to back
+                do {
+                    node.deadline += node.period;
+                } while (node.deadline <= target);
+                link(index);
+            } else {
+                node.prev = kNil;
+                node.next = kNil;
+                release(index);
+            }
+
+            expired.push_back(entry);
+            index = next;
+        }
+    }
+
+    if (target > current) {
+        current = target;
+    }
+}
+
+} // namespace timer
@@ -15,6 +15,18 @@ namespace window
 {
 
 bool is_window_initialized();
+// target set through setfps, 0 when uncapped
+int get_target_fps();
+
+// When on demand, the frame loop only draws after a redraw was requested or
+// input arrived, and presents nothing in between.
+bool is_on_demand();
+void set_on_demand(bool enabled);
+void request_redraw();
+// Whether a redraw was requested since the last call, and clear the request
+bool take_redraw_request();
+// Process window events without drawing, true when any of them was input
+bool poll_input();
 
 int init(lua_State* L);
 int setfps(lua_State* L);
@@ -29,10 +41,17 @@ int getmonitorsize(lua_State* L);
 int setsize(lua_State* L);
 int setposition(lua_State* L);
 int setstate(lua_State* L);
+int invalidate(lua_State* L);
+int setondemand(lua_State* L);
+int isondemand(lua_State* L);
 
 
 int noop(lua_State* L);
 
+// Add functions implemented by modules that depend on window, like frame
+// recording in graphics. Call before the library is opened.
+void extend(const luaL_Reg* functions);
+
 static const luaL_Reg lib[] = {
     {"init", init},
     {"setfps", setfps},
@@ -49,6 +68,9 @@ static const luaL_Reg lib[] = {
     {"setsize", setsize},
     {"setposition", setposition},
     {"setstate", setstate},
+    {"invalidate", invalidate},
+    {"setondemand", setondemand},
+    {"isondemand", isondemand},
     {nullptr, nullptr}
 };
 
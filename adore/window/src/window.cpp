@@ -1,16 +1,72 @@
 #include "adore/window.h"
 #include <memory>
+#include <vector>
 #include "raylib.h"
 #include <iostream>
 
 namespace window {
 
 static bool initialized = false;
+static int targetFps = 0;
+static bool onDemand = false;
+// start with a frame, there is nothing on screen yet
+static bool redrawRequested = true;
+static bool wasFocused = true;
+static std::vector<const luaL_Reg*> extensions;
 
 bool is_window_initialized() {
     return initialized;
 }
 
+int get_target_fps() {
+    return targetFps;
+}
+
+bool is_on_demand() {
+    return onDemand;
+}
+
+void set_on_demand(bool enabled) {
+    onDemand = enabled;
+    redrawRequested = true;
+}
+
+void request_redraw() {
+    redrawRequested = true;
+}
+
+bool take_redraw_request() {
+    bool requested = redrawRequested;
+    redrawRequested = false;
+    return requested;
+}
+
+bool poll_input() {
+    PollInputEvents();
+
+    bool input = IsWindowResized() || IsFileDropped();
+
+    Vector2 delta = GetMouseDelta();
+    Vector2 wheel = GetMouseWheelMoveV();
+    input = input || delta.x != 0.0f || delta.y != 0.0f || wheel.x != 0.0f || wheel.y != 0.0f;
+
+    for (int button = MOUSE_BUTTON_LEFT; !input && button <= MOUSE_BUTTON_BACK; ++button) {
+        input = IsMouseButtonDown(button) || IsMouseButtonReleased(button);
+    }
+
+    // held keys keep frames coming, scripts poll isdown() in update
+    for (int key = KEY_SPACE; !input && key <= KEY_KB_MENU; ++key) {
+        input = IsKeyDown(key) || IsKeyReleased(key);
+    }
+
+    // the window content may need to follow focus changes
+    bool focused = IsWindowFocused();
+    input = input || focused != wasFocused;
+    wasFocused = focused;
+
+    return input;
+}
+
 int init(lua_State* L) {
     if (initialized) { \
         luaL_errorL(L, "Window already initialized"); \
@@ -28,6 +84,7 @@ int setfps(lua_State* L) {
     WINDOW_NOT_INITIALIZED_CHECK();
     int fps = luaL_checkinteger(L, 1);
     SetTargetFPS(fps);
+    targetFps = fps > 0 ? fps : 0;
     return 0;
 }
 
@@ -144,6 +201,21 @@ int setstate(lua_State* L) {
     return 0;
 }
 
+int invalidate(lua_State* L) {
+    request_redraw();
+    return 0;
+}
+
+int setondemand(lua_State* L) {
+    set_on_demand(luaL_optboolean(L, 1, true));
+    return 0;
+}
+
+int isondemand(lua_State* L) {
+    lua_pushboolean(L, onDemand);
+    return 1;
+}
+
 static const std::pair<const char*, ConfigFlags> windowStates[] = {
     { "vsync_hint", FLAG_VSYNC_HINT },
     { "fullscreen_mode", FLAG_FULLSCREEN_MODE },
@@ -168,6 +240,10 @@ int noop(lua_State* L) {
     return 0;
 }
 
+void extend(const luaL_Reg* functions) {
+    extensions.push_back(functions);
+}
+
 } // namespace window
 
 
@@ -198,6 +274,13 @@ int adoreopen_window(lua_State* L)
         lua_setfield(L, -2, name);
     }
 
+    for (const luaL_Reg* functions : window::extensions) {
+        for (const luaL_Reg* entry = functions; entry->name; ++entry) {
+            lua_pushcfunction(L, entry->func, entry->name);
+            lua_setfield(L, -2, entry->name);
+        }
+    }
+
     lua_createtable(L, 0, std::size(window::windowStates));
     for (const auto& [name, flag] : window::windowStates) {
         lua_pushinteger(L, static_cast<lua_Integer>(flag));